@@ -12,7 +12,12 @@
 #include <queue>
 #include <mutex>
 #include "..\Utility.hpp"
+#include "..\BitStream.hpp"
 #include <set>
+
+//Defined in Client.cpp, used by Player_Session to wake the sending thread.
+extern Datagram_IO socket_io;
+
 /*
 	Represents a player session, where communications with the server is controlled through this.
 	Note: addrDest needs to be set before this struct can be used for sending/receiving.
@@ -27,65 +32,82 @@ public:
 	Player_Session() = default;
 
 	/*
-		Splits a message into COMMAND_COMPLETE and COMMAND_INCOMPLETE messages, based on whether they fit within MAX_PAYLOAD_SIZE.
+		Splits a message into fragments that fit within MAX_PAYLOAD_SIZE, each tagged with the message ID, its index and the fragment count.
+		The player ID is added in front of every fragment.
 	*/
 	void SendLongMessage(const std::string& message)
 	{
-		if (message.empty()) return;
-		std::string long_message = message;
 		char player_identification[2]{};
 		uint16_t network_id = htons((uint16_t)player_ID);
 		memcpy_s(player_identification, 2, &network_id, 2);
 		std::string player_id_string(player_identification, player_identification + 2);
-		while (true)
+		FragmentMessage(message, player_id_string, next_message_id++, messages_to_send);
+		socket_io.WakeSender();
+	}
+	/*
+		Sends the message on the sequenced channel, replacing any sequenced message that hasn't been sent yet.
+		Only for state where the latest copy is all that matters, as it isn't resent if lost.
+		Messages too large for one packet are sent reliably instead.
+	*/
+	void SendSequencedMessage(const std::string& message)
+	{
+		if (message.empty()) return;
+		//Player ID is added in front as well.
+		if (message.size() > MAX_PAYLOAD_SIZE - SEQUENCED_MESSAGE_HEADER_SIZE - 2)
 		{
-			//The last part of the message, add COMMAND_COMPLETE to indicate it is complete.
-			if (long_message.size() <= MAX_PAYLOAD_SIZE - 3)
-			{
-				long_message = (char)(COMMAND_COMPLETE)+player_id_string +long_message;
-				//String length is less than or equal to max payload size, so just push it all as one packet.
-				messages_to_send.push(long_message);
-				reliable_transfer.toSend = true;
-				return; //All parts of the message have been sent.
-			}
-			else
-			{
-				//Add incomplete, to show that there are more packets on the way.
-				long_message = (char)(COMMAND_INCOMPLETE)+player_id_string+long_message;
-				//Can only send MAX_PAYLOAD_SIZE for each packet, as 6 extra bytes are left for seq number and checksum.
-				messages_to_send.push(long_message.substr(0, MAX_PAYLOAD_SIZE));
-				//Move to the next chunk of the message.
-				long_message = long_message.substr(MAX_PAYLOAD_SIZE);
-			}
+			SendLongMessage(message);
+			return;
 		}
+		sequenced_message_to_send = message;
+		socket_io.WakeSender();
 	}
+	/*
+		Current round trip time estimates to the server, in ticks.
+		Smoothed RTT is -1 until the server has ACK'd a packet.
+	*/
+	Ticks GetSmoothedRTT() const { return reliable_transfer.smoothed_rtt; }
+	Ticks GetRTTVariance() const { return reliable_transfer.rtt_variance; }
+	Ticks GetRetransmissionTimeout() const { return reliable_transfer.retransmission_timeout; }
+
 	//Used to control reliable data transfer.
 	Reliable_Transfer reliable_transfer{};
+	//Used to control sequenced (unreliable) data transfer, for player transforms.
+	Sequenced_Transfer sequenced_transfer{};
+	//Puts the fragments of long messages from the server back together.
+	Message_Reassembler reassembler{};
+	//ID to give the next long message sent, so the server can tell which fragments belong together.
+	uint16_t next_message_id{ 0 };
 
 	//Used to indicate how to send. Need to set when recvfrom is called.
 	sockaddr_storage addrDest{};
 
 	/*
 		Indicates if the message stored in recv_buffer is complete.
-		Set to false at the start of the frame, and if the packets received from the server come with "COMMAND_INCOMPLETE".
-		Set to true when the last command packet from the server "COMMAND_COMPLETE" is received.
+		Set to false at the start of the frame.
+		Set to true when every fragment of a message from the server is received.
 	*/
 	bool is_recv_message_complete = false;
 	//Stores messages received from server, cleared at the end of each frame.
-	//Only stores "COMMAND" type messages, so it doesn't store ACK or JOIN_RESPONSE messages.
+	//Only stores "COMMAND" type messages after they are reassembled, so it doesn't store ACK or JOIN_RESPONSE messages.
 	std::string recv_buffer{};
 
 	/*
 		Each string in the vector signifies a packet to send.
-		Packets are sent in order (FCFS).
-		Only one packet is sent at a time. The next packet can only be sent when the first packet has been ACK'd.
+		Packets enter the send window in order (FCFS), up to SEND_WINDOW_SIZE packets can be in flight at once.
+		Until the JOIN_REQUEST is answered, only that packet is in flight.
 		Don't include checksum or seq number as they will be automatically added.
 
-		Each string contains [GeneralCommandID] as the first byte, indicating the type of packet it is (Either COMMAND_INCOMPLETE or COMMAND_COMPLETE or JOIN_REQUEST).
+		Each string contains [GeneralCommandID] as the first byte, indicating the type of packet it is (Either COMMAND_INCOMPLETE or COMMAND_COMPLETE or JOIN_REQUEST),
+		followed by the player ID and fragment header for commands.
 		ACK aren't sent this way, as they only need to be sent once without needing to be ACK'd.
 		Ensure packets confirm to MAX_PAYLOAD_SIZE (not MAX_PACKET_SIZE).
 	*/
 	std::queue<std::string> messages_to_send{};
+	/*
+		Latest message to send on the sequenced channel, sent once then cleared.
+		Excludes [COMMAND_SEQUENCED], player ID and the sequence number, as they will be automatically added.
+	*/
+	std::string sequenced_message_to_send{};
 
 	int player_ID{ -1 };
 };
@@ -128,13 +150,6 @@ struct Asteroids{
 	float time_of_creation;
 };//add new asteroid to the map 
 
-// Add Asteroid event into a map so that you only read from the map, not create message every individual frame
-struct CollisionEvent {
-    uint32_t object_ID;         // 0 is player, anything after is bullet, offset by 1 ***
-    uint32_t asteroid_ID;
-    float timestamp;
-};
-
 extern unsigned int bullet_ID; //start from 0
 
 extern std::vector<unsigned int> new_players;
@@ -147,7 +162,6 @@ extern std::map<unsigned int, Player> players; //not used yet
 extern std::map<unsigned int, std::map<unsigned int, Bullet>> all_bullets; //all the bullets
 extern std::map<unsigned int, Asteroids> Asteroid_map;
 
-extern std::vector<CollisionEvent> all_collisions;
 extern std::vector<std::pair<unsigned int, unsigned int>> bullet_destruction;
 extern std::vector<std::pair<unsigned int, int>> asteroid_destruction;
 extern std::set<unsigned int> player_hit;
@@ -155,38 +169,46 @@ extern std::vector<int> highscores;
 extern std::vector<std::tuple<int, std::string, float>> prevHS;
 extern std::vector<int> pLives;
 
+/*
+	Messages are bit-packed with Bit_Writer, each command starting on a byte with its command ID.
+	The Read_ functions read one command's fields after its command ID, up to the start of the next command.
+	They return false if the message ended in the middle of the command.
+*/
 std::string Write_PlayerTransform(Player player);
-int Read_PlayersTransform(std::string buffer, std::map<unsigned int, Player>& player_map, std::vector<unsigned int>& players_to_create);
+bool Read_PlayersTransform(Bit_Reader& input, std::map<unsigned int, Player>& player_map, std::vector<unsigned int>& players_to_create);
 
 std::string Write_NewBullet(unsigned int session_ID,std::map<unsigned int, Bullet>& new_bullets);
-int Read_New_Bullets(std::string buffer, std::map<unsigned int, std::map<unsigned int, Bullet>>&, std::map<unsigned int, Player> player_map, std::vector<std::pair<unsigned int, unsigned int>>&);
+bool Read_New_Bullets(Bit_Reader& input, std::map<unsigned int, std::map<unsigned int, Bullet>>&, std::map<unsigned int, Player> player_map, std::vector<std::pair<unsigned int, unsigned int>>&);
 
-std::string Write_AsteroidCollision(unsigned int session_ID, std::vector<CollisionEvent>& all_collisions);
-int Read_AsteroidCreations(const std::string& buffer, std::map<unsigned int, Asteroids>& Asteroid_map, std::vector<std::pair<unsigned int, Asteroids>>& new_asteroids);
-int Read_AsteroidDestruction(const std::string& buffer, std::map<unsigned int, std::map<unsigned int, Bullet>>&, std::map<unsigned int, Asteroids>& Asteroid_map, std::vector<std::pair<unsigned int, unsigned int>>& bullet_destruction, std::vector<std::pair<unsigned int, int>>& asteroid_destruction);
+bool Read_AsteroidCreations(Bit_Reader& input, std::map<unsigned int, Asteroids>& Asteroid_map, std::vector<std::pair<unsigned int, Asteroids>>& new_asteroids);
+bool Read_AsteroidDestruction(Bit_Reader& input, std::map<unsigned int, std::map<unsigned int, Bullet>>&, std::map<unsigned int, Asteroids>& Asteroid_map, std::vector<std::pair<unsigned int, unsigned int>>& bullet_destruction, std::vector<std::pair<unsigned int, int>>& asteroid_destruction);
 //Thread-Safe printing of console message.
 void PrintString(const std::string& message);
+//Seconds since the program started. Bullet timestamps are taken on this clock, and the server synchronizes with it.
+float get_TimeStamp();
 /*
 	UDP functions
 */
 extern Player_Session this_player;
 extern std::mutex this_player_lock;
 extern SOCKET udp_socket;
-extern std::mutex socket_lock;
 
 /*
-		It should be called in a separate thread.
-		Will continually read messages from the udp socket, adding them to the packet queue for another function to handle.
-		Will write messages to socket as needed (for messages that require ACK) based on toSend and timeout.
+		It should be called in a separate thread, the only thread that writes to the socket.
+		Will write messages to socket as needed (for messages that require ACK) based on the send window and timeout.
+		Sleeps until the nearest retransmission or ACK deadline, or until woken because there is something new to send.
 
 		Note:
-		- Only messages that require an ACK should be sent in this method. Otherwise, just write as per normal (note need to use mutex lock)
-		- To Send: Set the send buffer to the message (excluding checksum and sequence number). Set toSend to be true.
-		- Packet data in the queue has their checksum and sequence number stripped away. They are all confirmed to be uncorrupted,
-		and the number is a separate variable from the data.
-		- Only access the queue through a mutex.
+		- Only messages that require an ACK should be sent in this method. Otherwise, queue them with socket_io.QueueSend().
+		- To Send: Add the message (excluding header) to messages_to_send.
+		- ACKs for received packets are carried in the header of the packets sent, or sent on their own after ACK_DELAY.
+	*/
+void SendMessages();
+/*
+		It should be called in a separate thread, the only thread that reads from the socket.
+		Will continually read messages from the udp socket, handling them.
 	*/
-void ReceiveSendMessages();
+void ReceiveMessages();
 int InitializeUDP();
 void FreeUDP();
 #endif
@@ -3,16 +3,10 @@
 #include "Main.h"
 //#include "GameState_Asteroids.cpp"
 
-//Player transform(YT)
-
-//[0x1][4 bytes, X position][4 bytes, Y position]
-// [4 bytes, Rotation in radian][4 bytes, X velocity][4 bytes, Y velocity]
-// [4 bytes, X Acceleration][4 bytes, Y Acceleration]
-
 Player_Session this_player;
 std::mutex this_player_lock{};
 SOCKET udp_socket;
-std::mutex socket_lock{};
+Datagram_IO socket_io{};
 
 /*
 	Thread-safe atomic writing to console.
@@ -27,201 +21,55 @@ void PrintString(const std::string& message_to_print)
 }
 
 
+/*
+	[0x1][16 bits, X position][16 bits, Y position][2 x 12 bits, velocity][2 x 12 bits, acceleration][10 bits, rotation]
+	All fixed point, as set in Utility.hpp (POSITION_QUANTIZATION and so on).
+*/
 std::string Write_PlayerTransform(Player player) {
 
-	//uint16_t port_network_order = htons(port);
-	//uint32_t network_order = htonl(host_value);
-
-	//rev: ntohl
-	//semd: ht
-	// Create a string with at least 4 bytes
-	uint32_t Xpos, Ypos;
-	uint32_t Xvel, Yvel;
-	uint32_t Xacc, Yacc;
-	uint32_t rot;
-
-	std::memcpy(&Xpos, &player.Position_X, 4);
-	std::memcpy(&Ypos, &player.Position_Y, 4);
-
-	std::memcpy(&Xvel, &player.Velocity_X, 4);
-	std::memcpy(&Yvel, &player.Velocity_Y, 4);
-
-	std::memcpy(&Xacc, &player.Acceleration_X, 4);
-	std::memcpy(&Yacc, &player.Acceleration_Y, 4);
-
-	std::memcpy(&rot, &player.Rotation, 4);
-
-
-	Xpos = htonl(Xpos);
-	Ypos = htonl(Ypos);
-	Xvel = htonl(Xvel);
-	Yvel = htonl(Yvel);
-	Xacc = htonl(Xacc);
-	Yacc = htonl(Yacc);
-	rot = htonl(rot);
-
-	std::string result(29, '\0');
-	result[0] = static_cast<char>(0x1); //Command ID //remove this out if (change to 28 instead)
-	// we are passing this already in the start
-
-	std::memcpy(&result[1], &Xpos, 4);
-	std::memcpy(&result[5], &Ypos, 4);
-	std::memcpy(&result[9], &Xvel, 4);
-	std::memcpy(&result[13], &Yvel, 4);
-	std::memcpy(&result[17], &Xacc, 4);
-	std::memcpy(&result[21], &Yacc, 4);
-	std::memcpy(&result[25], &rot, 4);
-
-
-	/*std::cout << "before: =============================\n";
-	std::cout << "POS: x: " << player.Position_X << " y: " << player.Position_Y << std::endl;
-	std::cout << "VEL: x: " << player.Velocity_X << " y: " << player.Velocity_Y << std::endl;
-	std::cout << "rotation: " << player.Rotation << std::endl;
-
-	std::memcpy(&Xpos, &result[1], 4);
-	std::memcpy(&Ypos, &result[5], 4);
-	std::memcpy(&Xvel, &result[9], 4);
-	std::memcpy(&Yvel, &result[13], 4);
-	std::memcpy(&Xacc, &result[17], 4);
-	std::memcpy(&Yacc, &result[21], 4);
-	std::memcpy(&rot, &result[25], 4);
-
-	Xpos = ntohl(Xpos);
-	Ypos = ntohl(Ypos);
-	Xvel = ntohl(Xvel);
-	Yvel = ntohl(Yvel);
-	Xacc = ntohl(Xacc);
-	Yacc = ntohl(Yacc);
-	rot = ntohl(rot);
-
-	float posX, posY, velX, velY, accX, accY, rot2;
-	std::memcpy(&posX, &Xpos, 4);
-	std::memcpy(&posY, &Ypos, 4);
-	std::memcpy(&velX, &Xvel, 4);
-	std::memcpy(&velY, &Yvel, 4);
-	std::memcpy(&accX, &Xacc, 4);
-	std::memcpy(&accY, &Yacc, 4);
-	std::memcpy(&rot2, &rot, 4);
-
-	std::cout << "after: =============================\n";
-	std::cout << "POS: x: " << posX << " y: " << posY << std::endl;
-	std::cout << "VEL: x: " << velX << " y: " << velY << std::endl;
-	std::cout << "rotation: " << rot2 << std::endl;*/
-
-	std::memcpy(&Xpos, &result[1], 4);
-	std::memcpy(&Ypos, &result[5], 4);
-	std::memcpy(&Xvel, &result[9], 4);
-	std::memcpy(&Yvel, &result[13], 4);
-	std::memcpy(&Xacc, &result[17], 4);
-	std::memcpy(&Yacc, &result[21], 4);
-	std::memcpy(&rot, &result[25], 4);
-
-	Xpos = ntohl(Xpos);
-	Ypos = ntohl(Ypos);
-	Xvel = ntohl(Xvel);
-	Yvel = ntohl(Yvel);
-	Xacc = ntohl(Xacc);
-	Yacc = ntohl(Yacc);
-	rot = ntohl(rot);
-
-	float posX, posY, velX, velY, accX, accY, rot2;
-	std::memcpy(&posX, &Xpos, 4);
-	std::memcpy(&posY, &Ypos, 4);
-	std::memcpy(&velX, &Xvel, 4);
-	std::memcpy(&velY, &Yvel, 4);
-	std::memcpy(&accX, &Xacc, 4);
-	std::memcpy(&accY, &Yacc, 4);
-	std::memcpy(&rot2, &rot, 4);
-
-	//std::cout << "sending this player transform: =============================\n";
-	//std::cout << "POS: x: " << posX << " y: " << posY << std::endl;
-	//std::cout << "VEL: x: " << velX << " y: " << velY << std::endl;
-	//std::cout << "rotation: " << rot2 << std::endl;
-
-	return result;
-
-	//return std::string("Hello ");
-
-	// To verify (optional): print each byte in hex
-	/*for (unsigned char c : Xpos) {
-		printf("%02X ", c);
-	}
-	std::cout << std::endl;*/
-
-
+	char buffer[1 + 7 * 4]{};
+	Bit_Writer output{ buffer, sizeof(buffer) };
+	output.WriteBits(CLIENT_PLAYER_TRANSFORM, 8);
+	output.WriteQuantized(player.Position_X, POSITION_QUANTIZATION);
+	output.WriteQuantized(player.Position_Y, POSITION_QUANTIZATION);
+	output.WriteQuantized(player.Velocity_X, VELOCITY_QUANTIZATION);
+	output.WriteQuantized(player.Velocity_Y, VELOCITY_QUANTIZATION);
+	output.WriteQuantized(player.Acceleration_X, ACCELERATION_QUANTIZATION);
+	output.WriteQuantized(player.Acceleration_Y, ACCELERATION_QUANTIZATION);
+	output.WriteAngle(player.Rotation, ANGLE_BITS);
+	output.AlignToByte();
+	return std::string(buffer, output.GetBytesWritten());
 }
 
-int Read_PlayersTransform(std::string buffer, std::map<unsigned int, Player>& player_map, std::vector<unsigned int>& players_to_create) {
-
-	if (buffer.empty()) {
-
-		PrintString("Read_PlayersTransform: buffer is empty!");
-
-		return 0;
-	}
-
-	int bytes_read = 0;
-
-	//char ID_Dump = buffer[0];
-
-
-	uint16_t num_players = 0;
-	std::memcpy(&num_players, &buffer[0], 2);
-	//std::cout << "num_players before ntohs: " << num_players << std::endl;
-	num_players = ntohs(num_players);
-	int int_num_player = num_players;
-	
-	bytes_read = 2;
+/*
+	Everything after [0x4]:
+	[varint, number of players][varint, Player ID][transform, as Write_PlayerTransform() writes it]...
+*/
+bool Read_PlayersTransform(Bit_Reader& input, std::map<unsigned int, Player>& player_map, std::vector<unsigned int>& players_to_create) {
 
-	//std::cout << "int_num_player: " << int_num_player << std::endl;
+	uint32_t num_players = input.ReadVarUInt();
 
-	for (int i = 0; i < int_num_player; i++) {
+	for (uint32_t i = 0; i < num_players && !input.HasFailed(); i++) {
 
 		Player player;
 
-		int offset = i * 30 + 2; //30 is total bytes, 3 is offset
-
-		uint16_t player_ID = 0;
-		std::memcpy(&player_ID, &buffer[offset], 2);
-		player_ID = ntohs(player_ID);
-
-		uint32_t Xpos = 0, Ypos = 0;
-		uint32_t Xvel = 0, Yvel = 0;
-		uint32_t Xacc = 0, Yacc = 0;
-		uint32_t rot = 0;
-
-		std::memcpy(&Xpos, &buffer[2 + offset], 4);
-		std::memcpy(&Ypos, &buffer[6 + offset], 4);
-		std::memcpy(&Xvel, &buffer[10 + offset], 4);
-		std::memcpy(&Yvel, &buffer[14 + offset], 4);
-		std::memcpy(&Xacc, &buffer[18 + offset], 4);
-		std::memcpy(&Yacc, &buffer[22 + offset], 4);
-		std::memcpy(&rot, &buffer[26 + offset], 4);
-
-		Xpos = ntohl(Xpos);
-		Ypos = ntohl(Ypos);
-		Xvel = ntohl(Xvel);
-		Yvel = ntohl(Yvel);
-		Xacc = ntohl(Xacc);
-		Yacc = ntohl(Yacc);
-		rot = ntohl(rot);
-
-
-		std::memcpy(&player.Position_X, &Xpos, 4);
-		std::memcpy(&player.Position_Y, &Ypos, 4);
-		std::memcpy(&player.Velocity_X, &Xvel, 4);
-		std::memcpy(&player.Velocity_Y, &Yvel, 4);
-		std::memcpy(&player.Acceleration_X, &Xacc, 4);
-		std::memcpy(&player.Acceleration_Y, &Yacc, 4);
-		std::memcpy(&player.Rotation, &rot, 4);
+		unsigned int player_ID = input.ReadVarUInt();
+		player.Position_X = input.ReadQuantized(POSITION_QUANTIZATION);
+		player.Position_Y = input.ReadQuantized(POSITION_QUANTIZATION);
+		player.Velocity_X = input.ReadQuantized(VELOCITY_QUANTIZATION);
+		player.Velocity_Y = input.ReadQuantized(VELOCITY_QUANTIZATION);
+		player.Acceleration_X = input.ReadQuantized(ACCELERATION_QUANTIZATION);
+		player.Acceleration_Y = input.ReadQuantized(ACCELERATION_QUANTIZATION);
+		player.Rotation = input.ReadAngle(ANGLE_BITS);
+		if (input.HasFailed()) break;
 
 		//if player does not exist, means its a new player, so we create a new profile for him
 
-		auto it = player_map.find(static_cast<unsigned int>(player_ID));
+		auto it = player_map.find(player_ID);
 
 		if (it == player_map.end()) {
 
-			player_map[static_cast<unsigned int>(player_ID)] = player;
+			player_map[player_ID] = player;
 			players_to_create.push_back(player_ID);
 
 		}
@@ -237,190 +85,96 @@ int Read_PlayersTransform(std::string buffer, std::map<unsigned int, Player>& pl
 
 		}
 
-		bytes_read += 30;
-		//std::cout << "Receiving next player transform: =============================\n";
-		//std::cout << "POS: x: " << player.Position_X << " y: " << player.Position_Y << std::endl;
-		//std::cout << "VEL: x: " << player.Velocity_X << " y: " << player.Velocity_Y << std::endl;
-		//std::cout << "rotation: " << player.Rotation << std::endl;
-
 	}
-	//std::cout << "Read_PlayersTransform | bytes read: " << bytes_read << std::endl; //should be 32
-
-	return bytes_read;
+	input.AlignToByte();
+	return !input.HasFailed();
 
 }
 
 /*
-[0x2] [2 bytes, number of bullets] [4bytes, int Object ID] [4 bytes, float X position][4 bytes, float Y position][8 bytes,
-vec2 velocity][4 bytes, float rotation][4 bytes, float timestamp][4 bytes, int Object ID 2]...
+[0x2][varint, number of bullets][zigzag varint, Object ID - previous Object ID (0 for the first)][16 bits, X position][16 bits, Y position]
+[2 x 12 bits, velocity][10 bits, rotation][32 bits, float timestamp][zigzag varint, Object ID 2 - Object ID]...
+Everything but the timestamp is fixed point, as set in Utility.hpp.
 */
 std::string Write_NewBullet(unsigned int session_ID, std::map<unsigned int, Bullet>& new_bullets) {
 
+	std::vector<char> buffer(1 + MAX_VARINT_SIZE + new_bullets.size() * (MAX_VARINT_SIZE + 6 * 4));
+	Bit_Writer output{ buffer.data(), buffer.size() };
+	output.WriteBits(CLIENT_BULLET_CREATION, 8);
+	output.WriteVarUInt(static_cast<uint32_t>(new_bullets.size()));
 
-	uint16_t num_bullets = new_bullets.size();
-	num_bullets = htons(num_bullets);
-
-
-	std::string result(3 + new_bullets.size() * 28, '\0');
-
-	result[0] = static_cast<char>(0x2); //Command ID //remove this out if (change to 28 instead)
-	std::memcpy(&result[1], &num_bullets, 2); //copy the number of bullets
-
-	int j = 0;
+	//IDs go up one at a time, so their differences fit in a byte.
+	unsigned int previous_id = 0;
 	for (auto i = new_bullets.begin(); i != new_bullets.end(); i++) {
 
-		int offset = 3 + j * 28;
-
-		uint32_t bullet_id = 0;
-		std::memcpy(&bullet_id, &i->first, 4);
-
-
-		auto it = i->second;
-		uint32_t Xpos = 0, Ypos = 0;
-		uint32_t Xvel = 0, Yvel = 0;
-
-		uint32_t rot = 0, time_stamp = 0;
-
-		std::memcpy(&Xpos, &it.Position_X, 4);
-		std::memcpy(&Ypos, &it.Position_Y, 4);
-		std::memcpy(&Xvel, &it.Velocity_X, 4);
-		std::memcpy(&Yvel, &it.Velocity_Y, 4);
-		std::memcpy(&time_stamp, &it.Time_Stamp, 4);
-		std::memcpy(&rot, &it.Rotation, 4);
-
-		Xpos = htonl(Xpos);
-		Ypos = htonl(Ypos);
-
-		Xvel = htonl(Xvel);
-		Yvel = htonl(Yvel);
-
-		time_stamp = htonl(time_stamp);
-		rot = htonl(rot);
-		bullet_id = htonl(bullet_id);
-
-		std::memcpy(&result[offset], &bullet_id, 4);
-		std::memcpy(&result[offset + 4], &Xpos, 4);
-		std::memcpy(&result[offset + 8], &Ypos, 4);
-		std::memcpy(&result[offset + 12], &Xvel, 4);
-		std::memcpy(&result[offset + 16], &Yvel, 4);
-		std::memcpy(&result[offset + 20], &rot, 4);
-		std::memcpy(&result[offset + 24], &time_stamp, 4);
-
-
-
-		j++;
-
+		output.WriteVarInt(static_cast<int32_t>(i->first - previous_id));
+		previous_id = i->first;
 
+		const Bullet& it = i->second;
+		output.WriteQuantized(it.Position_X, POSITION_QUANTIZATION);
+		output.WriteQuantized(it.Position_Y, POSITION_QUANTIZATION);
+		output.WriteQuantized(it.Velocity_X, VELOCITY_QUANTIZATION);
+		output.WriteQuantized(it.Velocity_Y, VELOCITY_QUANTIZATION);
+		output.WriteAngle(it.Rotation, ANGLE_BITS);
+		output.WriteFloat(it.Time_Stamp);
 	}
-
-	//std::cout << "new bullets size: " << new_bullets.size() << std::endl;
+	output.AlignToByte();
 
 	//after creating, remove the bullets to be created. to avoid duplication
 	new_bullets.clear();
 
-	return result;
-	//return std::string("World\n");
+	return std::string(buffer.data(), output.GetBytesWritten());
 }
 
 
 
-int Read_New_Bullets(std::string buffer, std::map<unsigned int, std::map<unsigned int, Bullet>>& bullets_map, std::map<unsigned int, Player> player_map, std::vector<std::pair<unsigned int, unsigned int>>& other_bullets) {
-
-	if (buffer.empty()) {
-
-		PrintString("Read_New_Bullets: buffer is empty!");
-
-		return 0;
-	}
-
-	int bytes_read = 0;
-
-	//char ID_Dump = buffer[0];
-
-	uint16_t num_players = 0;
-	std::memcpy(&num_players, &buffer[0], 2);
-	num_players = ntohs(num_players);
-
-	int offset = 2;
-
-	bytes_read = 2;
-
-
-	for (int i = 0; i < (int)num_players; i++) {
-
-		Player player;
+/*
+	Everything after [0x5]:
+	[varint, number of players][varint, Player ID][bullets of the player, as Write_NewBullet() writes them (after 0x2)]
+	[varint, Player ID 2]...
+*/
+bool Read_New_Bullets(Bit_Reader& input, std::map<unsigned int, std::map<unsigned int, Bullet>>& bullets_map, std::map<unsigned int, Player> player_map, std::vector<std::pair<unsigned int, unsigned int>>& other_bullets) {
 
-		uint16_t player_ID = 0;
-		std::memcpy(&player_ID, &buffer[offset], 2);
-		player_ID = ntohs(player_ID);
+	uint32_t num_players = input.ReadVarUInt();
 
-		uint16_t num_bullets = 0;
-		std::memcpy(&num_bullets, &buffer[offset + 2], 2);
-		num_bullets = ntohs(num_bullets);
+	for (uint32_t i = 0; i < num_players && !input.HasFailed(); i++) {
 
+		unsigned int player_ID = input.ReadVarUInt();
+		uint32_t num_bullets = input.ReadVarUInt();
 
+		//This player's own bullets are read past, as they already exist.
+		bool is_own_bullets = false;
 		{
 			std::lock_guard<std::mutex> player_lock{ this_player_lock };
-			if (player_ID == this_player.player_ID) {
-				offset += 4 + num_bullets * 28;
-				bytes_read += 4 + num_bullets * 28;
-				continue;
-			}
+			is_own_bullets = player_ID == static_cast<unsigned int>(this_player.player_ID);
 		}
 
-		offset += 4; //if bullet num =1, offset here should be 7
-		bytes_read += 4;
-
-		for (int j = 0; j < (int)num_bullets; j++) {
-			if (offset + 28 > buffer.size()) {
-				return bytes_read;
-			}
+		unsigned int bullet_id = 0;
+		for (uint32_t j = 0; j < num_bullets && !input.HasFailed(); j++) {
 
-			uint32_t bullet_id = 0;
-			uint32_t Xpos = 0, Ypos = 0;
-			uint32_t Xvel = 0, Yvel = 0;
-			uint32_t rot = 0, time_stamp = 0;
-
-			std::memcpy(&bullet_id, &buffer[offset], 4);
-			std::memcpy(&Xpos, &buffer[offset + 4], 4);
-			std::memcpy(&Ypos, &buffer[offset + 8], 4);
-			std::memcpy(&Xvel, &buffer[offset + 12], 4);
-			std::memcpy(&Yvel, &buffer[offset + 16], 4);
-			std::memcpy(&rot, &buffer[offset + 20], 4);
-			std::memcpy(&time_stamp, &buffer[offset + 24], 4);
-
-			offset += 28;
-			bytes_read += 28;
-
-			Xpos = ntohl(Xpos);
-			Ypos = ntohl(Ypos);
-			Xvel = ntohl(Xvel);
-			Yvel = ntohl(Yvel);
-			rot = ntohl(rot);
-			time_stamp = ntohl(time_stamp);
-			bullet_id = ntohl(bullet_id);
+			bullet_id += input.ReadVarInt();
 
 			Bullet new_bullet;
+			new_bullet.Position_X = input.ReadQuantized(POSITION_QUANTIZATION);
+			new_bullet.Position_Y = input.ReadQuantized(POSITION_QUANTIZATION);
+			new_bullet.Velocity_X = input.ReadQuantized(VELOCITY_QUANTIZATION);
+			new_bullet.Velocity_Y = input.ReadQuantized(VELOCITY_QUANTIZATION);
+			new_bullet.Rotation = input.ReadAngle(ANGLE_BITS);
+			new_bullet.Time_Stamp = input.ReadFloat();
+			if (input.HasFailed() || is_own_bullets) continue;
 
-			std::memcpy(&new_bullet.Position_X, &Xpos, 4);
-			std::memcpy(&new_bullet.Position_Y, &Ypos, 4);
-			std::memcpy(&new_bullet.Velocity_X, &Xvel, 4);
-			std::memcpy(&new_bullet.Velocity_Y, &Yvel, 4);
-			std::memcpy(&new_bullet.Rotation, &rot, 4);
-			std::memcpy(&new_bullet.Time_Stamp, &time_stamp, 4);
-			
 			//std::cout << "New Bullet with position (" << new_bullet.Position_X << ", " << new_bullet.Position_Y << ")" << std::endl;
 			//std::cout << "New Bullet with velocity (" << new_bullet.Velocity_X << ", " << new_bullet.Velocity_Y << ")" << std::endl;
 			//std::cout << "New Bullet with rotation (" << new_bullet.Rotation << ")" << std::endl;
-			auto it = bullets_map.find(static_cast<unsigned int>(player_ID)); //add it to the player id map
+			auto it = bullets_map.find(player_ID); //add it to the player id map
 
 			//if the player exists
 			if (it != bullets_map.end()) {
 
 				//if the bullet id is new, then we add to the map, if not we can just ignore
-				if (it->second.find(static_cast<unsigned int>(bullet_id)) == it->second.end()) {
+				if (it->second.find(bullet_id) == it->second.end()) {
 
-					it->second[static_cast<unsigned int>(bullet_id)] = new_bullet;
+					it->second[bullet_id] = new_bullet;
 					other_bullets.push_back(std::pair<unsigned int, unsigned int>(player_ID, bullet_id));
 				}
 
@@ -433,13 +187,13 @@ int Read_New_Bullets(std::string buffer, std::map<unsigned int, std::map<unsigne
 				//        the bullet map is not created for the player yet.
 				// So we create a map with the session ID with the first few bullets he have created
 
-				if (player_map.find(static_cast<unsigned int>(player_ID)) != player_map.end()) {
+				if (player_map.find(player_ID) != player_map.end()) {
 
 					std::map<unsigned int, Bullet> new_bullet_map;
 
-					new_bullet_map[static_cast<unsigned int>(bullet_id)] = new_bullet;
+					new_bullet_map[bullet_id] = new_bullet;
 
-					bullets_map[static_cast<unsigned int>(player_ID)] = new_bullet_map;
+					bullets_map[player_ID] = new_bullet_map;
 					other_bullets.push_back(std::pair<unsigned int, unsigned int>(player_ID, bullet_id));
 				}
 				else {
@@ -454,204 +208,66 @@ int Read_New_Bullets(std::string buffer, std::map<unsigned int, std::map<unsigne
 		}
 
 	}
-	//std::cout << "Read_New_Bullets | bytes read: " << bytes_read << std::endl;
-	return bytes_read;
+	input.AlignToByte();
+	return !input.HasFailed();
 
 }
 
 
-// [0x3][2 bytes, number of collisions][4 bytes, Object ID][4 bytes, Asteroid ID][4 bytes, float timestamp][4 bytes, Object ID 2]... 
-// Using a loop to create number of strings per collision 
 /*
-	Collision if any (Daryl & Asteriod)
-
-	Bullet to asteroid with timestamp
-
-	Player to asteroid with timestamp
-
-	[0x3][2 bytes, number of collisions][4 bytes, Object ID][4 bytes, Asteroid ID][4 bytes, float timestamp][4 bytes, Object ID 2]...
-
-	Object ID = 0 means player’s ship
-
-	Object ID != 0 means bullets
-
-	This means that when added to CollisionEvent
-
+	Everything after [0x6]:
+	[varint, number of asteroids][zigzag varint, Asteroid ID - previous Asteroid ID (0 for the first)][2 x 16 bits, pos]
+	[2 x 12 bits, velocity][10 bits, rotation][2 x 6 bits, scale][32 bits, float timestamp][zigzag varint, Asteroid ID2 - Asteroid ID]...
+	Everything but the timestamp is fixed point, as set in Utility.hpp.
 */
-std::string Write_AsteroidCollision(unsigned int session_ID, std::vector<CollisionEvent>& all_collisions)
+bool Read_AsteroidCreations(Bit_Reader& input, std::map<unsigned int, Asteroids>& Asteroid_map, std::vector<std::pair<unsigned int, Asteroids>>& new_asteroids)
 {
-	// Check number of collisions
-	uint16_t num_collides = all_collisions.size();
-	num_collides = htons(num_collides);
-
-	// [4 bytes, Object ID][4 bytes, Asteroid ID][4 bytes, float timestamp]
-	std::string result(2 + num_collides * 12, '\0');
-
-	// Set first byte to command ID
-	result[0] = static_cast<char>(0x3);
-
-	if (all_collisions.size() == 0) return result;
-	// Copy number of collisions to next 2 byte
-	std::memcpy(&result[1], &num_collides, 2);
-
-	// Append the collisions to the back of the message
-	for (size_t i = 0; i < all_collisions.size(); i++) {
-		CollisionEvent temp = all_collisions[i];
-
-		// Find the offset of current collision event
-		int offset_of_bytes = 3 + i * 12;
-
-		// Obtain object ID, Asteroid ID and Time Stamp
-		uint32_t obj_ID = temp.object_ID;
-		uint32_t asteroid_ID = temp.asteroid_ID;
-
-		uint32_t time_stamp;
-		std::memcpy(&time_stamp, &temp.timestamp, 4); // reinterpret float as uint32_t
-
-		// Convert all to network byte order
-		obj_ID = htonl(obj_ID);
-		asteroid_ID = htonl(asteroid_ID);
-		time_stamp = htonl(time_stamp);
-
-		// Write to buffer
-		std::memcpy(&result[offset_of_bytes], &obj_ID, 4);
-		std::memcpy(&result[offset_of_bytes + 4], &asteroid_ID, 4);
-		std::memcpy(&result[offset_of_bytes + 8], &time_stamp, 4);
-	}
-
-	// Avoid re-writing the same collision
-	all_collisions.clear();
-
-	return result;
-}
-
-int Read_AsteroidCreations(const std::string& buffer, std::map<unsigned int, Asteroids>& Asteroid_map, std::vector<std::pair<unsigned int, Asteroids>>& new_asteroids)
-{
-	// Check empty string
-	if (buffer.empty()) {
-		return 0;
-	}
-
-	//// Check if wrong string was sent to this function
-	//if (buffer[0] != 0x6) {
-	//	PrintString("Read_AsteroidCreations: Wrong Command ID sent to this function");
-	//	return 0;
-	//}
-
 	// Getting number of Asteroids
-	uint16_t num_asteroids = 0;
-	std::memcpy(&num_asteroids, &buffer[0], 2);
-	num_asteroids = ntohs(num_asteroids);
+	uint32_t num_asteroids = input.ReadVarUInt();
 
-	int bytes_read = 2;
-	int offset = 2;
-	for (int i = 0; i < num_asteroids; i++) {
+	unsigned int asteroid_ID = 0;
+	for (uint32_t i = 0; i < num_asteroids && !input.HasFailed(); i++) {
 
 		Asteroids temp{};
-		int asteroid_ID;
-
-		// Copy Asteroid ID
-		std::memcpy(&asteroid_ID, &buffer[offset], 4);
-		asteroid_ID = ntohl(asteroid_ID);
-		asteroid_ID = ntohl(asteroid_ID);
-
-		// Copy the rest of Asteroid information into a temp Asteroid object
-		// Position
-		uint32_t posx{}, posy{};
-		std::memcpy(&posx, &buffer[offset + 4], 4);
-		std::memcpy(&posy, &buffer[offset + 8], 4);
-
-		posx = ntohl(posx);
-		posy = ntohl(posy);
-
-		std::memcpy(&temp.Position_x, &posx, 4);
-		std::memcpy(&temp.Position_y, &posy, 4);
-
-		temp.Position_x *= AEGfxGetWinMaxX() / 2;
-		temp.Position_y *= AEGfxGetWinMaxY() / 2;
-
-		// Velocity
-		uint32_t vel_x{}, vel_y{};
-		std::memcpy(&vel_x, &buffer[offset + 12], 4);
-		std::memcpy(&vel_y, &buffer[offset + 16], 4);
-
-		vel_x = ntohl(vel_x);
-		vel_y = ntohl(vel_y);
-
-		std::memcpy(&temp.Velocity_x, &vel_x, 4);
-		std::memcpy(&temp.Velocity_y, &vel_y, 4);
-
-		// Rotation
-		uint32_t rot{};
-		std::memcpy(&rot, &buffer[offset + 20], 4);
-		rot = ntohl(rot);
-		std::memcpy(&temp.Rotation, &rot, 4);
-
-		// Scale
-		uint32_t sca_x{}, sca_y{};
-		std::memcpy(&sca_x, &buffer[offset + 24], 4);
-		std::memcpy(&sca_y, &buffer[offset + 28], 4);
-
-		sca_x = ntohl(sca_x);
-		sca_y = ntohl(sca_y);
-
-		std::memcpy(&temp.Scale_x, &sca_x, 4);
-		std::memcpy(&temp.Scale_y, &sca_y, 4);
+		asteroid_ID += input.ReadVarInt();
+
+		// Already in world coordinates, as the server simulates the asteroids too.
+		temp.Position_x = input.ReadQuantized(POSITION_QUANTIZATION);
+		temp.Position_y = input.ReadQuantized(POSITION_QUANTIZATION);
+		temp.Velocity_x = input.ReadQuantized(VELOCITY_QUANTIZATION);
+		temp.Velocity_y = input.ReadQuantized(VELOCITY_QUANTIZATION);
+		temp.Rotation = input.ReadAngle(ANGLE_BITS);
+		temp.Scale_x = input.ReadQuantized(SCALE_QUANTIZATION);
+		temp.Scale_y = input.ReadQuantized(SCALE_QUANTIZATION);
+		temp.time_of_creation = input.ReadFloat();
+		if (input.HasFailed()) break;
 
 		//std::cout << "Read asteroid info with Scale (" << temp.Scale_x << ", " << temp.Scale_y << ")" << std::endl;
 
-		// Time Stamp
-		uint32_t time{};
-		std::memcpy(&time, &buffer[offset + 32], 4);
-		time = ntohl(time);
-		std::memcpy(&temp.time_of_creation, &time, 4);
-
 		Asteroid_map[asteroid_ID] = temp;
 		new_asteroids.push_back({ asteroid_ID, temp });
-		bytes_read += 36;
-		offset += 36;
 	}
-	return bytes_read;
+	input.AlignToByte();
+	return !input.HasFailed();
 }
 
-int Read_AsteroidDestruction(const std::string& buffer, std::map<unsigned int, std::map<unsigned int, Bullet>>& all_bullets,
+/*
+	Everything after [0x7]:
+	[varint, number of collisions][varint, Player ID][varint, Object ID (0 for the ship)][varint, Asteroid ID]...
+*/
+bool Read_AsteroidDestruction(Bit_Reader& input, std::map<unsigned int, std::map<unsigned int, Bullet>>& all_bullets,
 	std::map<unsigned int, Asteroids>& Asteroid_map, std::vector<std::pair<unsigned int, unsigned int>>& bullet_destruction,
 	std::vector<std::pair<unsigned int, int>>& asteroid_destruction)
 {
-	// Check empty string
-	if (buffer.empty()) {
-		return 0;
-	}
-
-	//// Check if wrong string was sent to this function
-	//if (buffer[0] != 0x7) {
-	//	PrintString("Read_AsteroidDestruction: Wrong Command ID sent to this function");
-	//	return 0;
-	//}
-
 	// Getting number of Collisions
-	uint16_t num_col = 0;
-	std::memcpy(&num_col, &buffer[0], 2);
-	num_col = ntohs(num_col);
-
-	int bytes_read = 2;
+	uint32_t num_col = input.ReadVarUInt();
 
-	for (int i = 0; i < num_col; i++) {
-		int offset = 2 + i * 10;
+	for (uint32_t i = 0; i < num_col && !input.HasFailed(); i++) {
 
-		// Obtain Player ID
-		int Player_ID;
-		std::memcpy(&Player_ID, &buffer[offset], 2);
-		Player_ID = ntohs(Player_ID);
-
-		int obj_ID;
-		std::memcpy(&obj_ID, &buffer[offset + 2], 4);
-		obj_ID = ntohl(obj_ID);
-
-		// Asteroid
-		int Asteroid_ID;
-		std::memcpy(&Asteroid_ID, &buffer[offset + 6], 4);
-		Asteroid_ID = ntohl(Asteroid_ID);
+		int Player_ID = static_cast<int>(input.ReadVarUInt());
+		unsigned int obj_ID = input.ReadVarUInt();
+		unsigned int Asteroid_ID = input.ReadVarUInt();
+		if (input.HasFailed()) break;
 
 		// Asteroid Response ( Deleting from Map, delayed destruction )
 		Asteroid_map.erase(Asteroid_ID);
@@ -670,26 +286,18 @@ int Read_AsteroidDestruction(const std::string& buffer, std::map<unsigned int, s
 			players[Player_ID].Acceleration_Y = 0.f;
 		}
 		// Bullet
-		else if (obj_ID > 0) {
+		else {
 			// Bullet response ( Deleting from Map )
 			//players[Player_ID].score += amount;
-			int bulletID = obj_ID;
-			all_bullets[Player_ID].erase(bulletID);
+			all_bullets[Player_ID].erase(obj_ID);
 
-			bullet_destruction.push_back({ Player_ID, bulletID });
+			bullet_destruction.push_back({ Player_ID, obj_ID });
 		}
-
-		bytes_read += 10;
 	}
-	return bytes_read;
+	input.AlignToByte();
+	return !input.HasFailed();
 }
 
-/*
-
-[0x5] [2 bytes, number of players] [2 bytes, playerID] [2 bytes, number of bullets] [4bytes Object ID][8bytes vec2 pos][8 bytes vec2 velocity][4 bytes float rotation]
-[4bytes, float timestamp][4bytes Object ID2]...[2 bytes, playerID 2]...
-
-*/
 namespace
 {
 	/*
@@ -734,23 +342,16 @@ int InitializeUDP()
 	config_file >> temp >> client_udp_portString >> std::ws;
 
 	// -------------------------------------------------------------------------
-	// Start up Winsock, asking for version 2.2.
+	// Start up the socket library (Winsock 2.2 on Windows).
 	//
-	// WSAStartup()
+	// StartupSockets()
 	// -------------------------------------------------------------------------
 
-	// This object holds the information about the version of Winsock that we
-	// are using, which is not necessarily the version that we requested.
-	WSADATA wsaData{};
-	SecureZeroMemory(&wsaData, sizeof(wsaData));
-
-	// Initialize Winsock. You must call WSACleanup when you are finished.
-	// As this function uses a reference counter, for each call to WSAStartup,
-	// you must call WSACleanup or suffer memory issues.
-	int errorCode = WSAStartup(MAKEWORD(2, 2), &wsaData);
+	// Each successful StartupSockets() must be matched by a CleanupSockets().
+	int errorCode = StartupSockets();
 	if (NO_ERROR != errorCode)
 	{
-		std::cerr << "WSAStartup() failed." << std::endl;
+		std::cerr << "StartupSockets() failed." << std::endl;
 		return errorCode;
 	}
 	char hostname[1000]{};
@@ -771,7 +372,7 @@ int InitializeUDP()
 	if (udp_socket == INVALID_SOCKET)
 	{
 		std::cerr << "socket() failed." << std::endl;
-		WSACleanup();
+		CleanupSockets();
 		return 1;
 	}
 
@@ -807,7 +408,7 @@ int InitializeUDP()
 		if (offset > 30)
 		{
 			std::cerr << "getaddrinfo() failed, or unable to bind udp socket." << std::endl;
-			WSACleanup();
+			CleanupSockets();
 			return errorCode;
 		}
 	} while (bind(udp_socket, info_udp->ai_addr, static_cast<int>(info_udp->ai_addrlen)) != NO_ERROR);
@@ -829,8 +430,8 @@ int InitializeUDP()
 
 
 	// Enable non-blocking I/O on the udp socket.
-	u_long enable = 1;
-	ioctlsocket(udp_socket, FIONBIO, &enable);
+	SetNonBlocking(udp_socket);
+	socket_io.Attach(udp_socket);
 
 
 	//==Convert server ip and port to a sockaddr, for sending.
@@ -847,68 +448,45 @@ int InitializeUDP()
 
 void FreeUDP()
 {
-	closesocket(udp_socket); //Shutdown not necessary.
+	CloseSocket(udp_socket); //Shutdown not necessary.
 	udp_socket = INVALID_SOCKET;
-	WSACleanup();
+	CleanupSockets();
 }
 
 
-namespace {
-	//Just used to shift writing of socket to outside the map, to prevent locking of 2 mutexes (which may lead to deadlock if not done well).
-	struct WriteData
-	{
-		sockaddr_storage addrDest;
-		std::string data;
-	};
-}
-
 /*
 	\brief
 	Helper function to handle received packets.
 */
-void HandleReceivedPackets(std::string data, int seq_or_ack_number)
+void HandleReceivedPackets(std::string data, int sequence_number, const Packet_Header& header)
 {
 	/*
-		Data only (without sequence number/ack/checksum), and are uncorrupted (checksum check has passed).
-		Sequence number/Ack number is located under Packet, as a separate variable.
+		Data only (without header), and are uncorrupted (checksum check has passed).
+		Sequence number and ACKs (from the header of the datagram it came in) are separate variables.
 		Size of packets may start from 0, don't assume there is data inside.
 	*/
 
 	/*
 		Types of packets
 		- ACK: [General Command ID (ACK) unsigned char]
-		- Non ACK: Reply with ACK [Checksum][ACK number][General Command ID (ACK) unsigned char][Player ID]
+		- Non ACK: ACK'd through the header of the next packet sent to the server (or a standalone ACK if there's none).
 	*/
 
 	//Discard packets if empty, since no command ID.
 	if (data.empty()) return;
 	unsigned char command_ID = data[0];
 
-
-	if (command_ID == ACK)
-	{
-		//PrintString(std::string("ACK RECV, Seq Num: ") + std::to_string(seq_or_ack_number));
-		/*
-			Using ACK number, decide what to do with ACK.
-			If ACK == current sequence number, packet has been received successfully
-			- Increment sequence number, get rid of the current packet to send the next packet.
-			- Reset timeout to infinity.
-			- If there's buffer left, set isSend to true.
-		*/
-		std::lock_guard<std::mutex> player_lock{ this_player_lock };
-		//==ACK number is less than packet sent out, so ignore.
-		if (seq_or_ack_number < this_player.reliable_transfer.current_sequence_number) return;
-		//==ACK matches packet sent out, meaning packet received successfully.
-		this_player.reliable_transfer.current_sequence_number++;
-		//Clear all data that has been sent successfully.
-		if (!this_player.messages_to_send.empty()) this_player.messages_to_send.pop();
-
-		//Reset timers
-		this_player.reliable_transfer.time_last_packet_sent = 20000000000000; //Reset to some time in the future to effectively set timeout to infinity.
-		//Send the remaining data in the buffer, if any.
-		if (!this_player.messages_to_send.empty()) this_player.reliable_transfer.toSend = true;
-		return; //Handling of packet finished.
-	}
+	std::lock_guard<std::mutex> player_lock{ this_player_lock };
+	//Once JOIN_RESPONSE has set the mode, a datagram that wasn't checked with it can't be trusted, not even its ACKs.
+	if (this_player.player_ID != -1 && header.integrity_mode != this_player.reliable_transfer.integrity_mode) return;
+	/*
+		Using the ACKs in the header, mark the packets in the send window as received.
+		The window slides forward once the packets in front are all ACK'd, letting new packets be sent.
+		This also ACKs the JOIN_REQUEST when the JOIN_RESPONSE arrives.
+	*/
+	Ticks current_time = GetMonotonicTime();
+	this_player.reliable_transfer.ReceiveAckBits(header.ack_number, header.ack_bits, current_time);
+	if (command_ID == ACK) return; //Handling of packet finished.
 	//==Below here, it is a non-ACK packet (i.e. command).
 
 
@@ -916,17 +494,14 @@ void HandleReceivedPackets(std::string data, int seq_or_ack_number)
 
 	/*
 		Two scenarios
-		1. JOIN_RESPONSE
-		- Treat it like an ACK.
-		- If player id has not been set, then increment and treat it like ACK successful. Also set player ID.
-		2. Existing player --> [General Command ID][Player ID][Length of message][Command ID]...
-		- Send back ACK.
+		1. JOIN_RESPONSE --> [General Command ID][Player ID, 2][Integrity Mode, 1]
+		- If player id has not been set, then set player ID and the integrity mode picked by the server.
+		2. Existing player --> [General Command ID][Length of message][Command ID]...
+		- ACK is sent back with the next packet.
 		- Add to recv buffer if necessary.
-		In both cases, increment ack_last_packet_received if it's higher.
 	*/
 	if (command_ID == JOIN_RESPONSE)
 	{
-		std::lock_guard<std::mutex> player_lock{ this_player_lock };
 		//Ignore JOIN_RESPONSE if already have player ID or invalid format.
 		if (this_player.player_ID != -1 || data.size() < 3) return;
 
@@ -934,21 +509,51 @@ void HandleReceivedPackets(std::string data, int seq_or_ack_number)
 		uint16_t id{};
 		memcpy_s(&id, 2, data.data() + 1, 2);
 		this_player.player_ID = ntohs(id);
-		PrintString("JOIN_RESPONSE RECV, Seq Num: " + std::to_string(seq_or_ack_number) + " Player ID: " + std::to_string(this_player.player_ID));
-
-		//Since "ACK" for the recently sent "JOIN_REQUEST" message is successful, then respond accordingly.
-		this_player.reliable_transfer.current_sequence_number++;
-		//Clear all data that has been sent successfully.
-		if (!this_player.messages_to_send.empty()) this_player.messages_to_send.pop();
+		//Servers that don't send a mode only support the 16 bit checksum.
+		uint8_t integrity_mode = data.size() >= 4 ? static_cast<uint8_t>(data[3]) : INTEGRITY_SUM16;
+		if (integrity_mode < INTEGRITY_MODE_COUNT) this_player.reliable_transfer.integrity_mode = static_cast<IntegrityMode>(integrity_mode);
+		PrintString("JOIN_RESPONSE RECV, ACK Num: " + std::to_string(header.ack_number) + " Player ID: " + std::to_string(this_player.player_ID));
+		return;
+	}
 
-		//Reset timers
-		this_player.reliable_transfer.time_last_packet_sent = 20000000000000; //Reset to some time in the future to effectively set timeout to infinity.
-		//Send the remaining data in the buffer, if any.
-		if (!this_player.messages_to_send.empty()) this_player.reliable_transfer.toSend = true;
+	/*
+		Clock synchronization ping --> [CLOCK_SYNC_REQUEST][Server Send Time, 8]
+		- Answered straight away, not ACK'd: [CLOCK_SYNC_RESPONSE][Player ID, 2][Server Send Time, 8][Receive Time, 4][Send Time, 4]
+		- Times are from get_TimeStamp(), so the server can convert bullet timestamps to its own clock.
+	*/
+	if (command_ID == CLOCK_SYNC_REQUEST)
+	{
+		float receive_time = get_TimeStamp();
+		if (this_player.player_ID == -1 || data.size() < 9) return;
+		char sync_response[19]{};
+		sync_response[0] = CLOCK_SYNC_RESPONSE;
+		uint16_t network_player_id = htons((uint16_t)this_player.player_ID);
+		memcpy_s(sync_response + 1, 2, &network_player_id, 2);
+		//Server's time is echoed back as is.
+		memcpy_s(sync_response + 3, 8, data.data() + 1, 8);
+		float send_time = get_TimeStamp();
+		uint32_t network_time{};
+		memcpy_s(&network_time, 4, &receive_time, 4);
+		network_time = htonl(network_time);
+		memcpy_s(sync_response + 11, 4, &network_time, 4);
+		memcpy_s(&network_time, 4, &send_time, 4);
+		network_time = htonl(network_time);
+		memcpy_s(sync_response + 15, 4, &network_time, 4);
+		Encoded_Frame sync_frame = EncodeFrame(-1, std::string(sync_response, sync_response + 19));
+		std::string datagram = this_player.reliable_transfer.AssembleDatagrams({ &sync_frame }).front();
+		socket_io.QueueSend(this_player.addrDest, datagram.data(), datagram.size());
 		return;
 	}
 
 
+	//Format: [COMMAND_SEQUENCED][Sequence Number, 4][Command ID]...
+	//Not ACK'd, older messages are dropped.
+	if (command_ID == COMMAND_SEQUENCED)
+	{
+		this_player.sequenced_transfer.ReceiveMessage(data.data() + 1, data.size() - 1);
+		return;
+	}
+
 	/*
 		COMMAND_INCOMPLETE or COMMAND_COMPLETE.
 
@@ -956,78 +561,54 @@ void HandleReceivedPackets(std::string data, int seq_or_ack_number)
 		Set messageIncomplete to false or true depending on the general command.
 	*/
 
+	if (command_ID != COMMAND_COMPLETE && command_ID != COMMAND_INCOMPLETE) return;
+	//Message format: [General Command = COMMAND][Command ID]...[Command ID 2]
+
 	/*
-		*Send back an ACK for the packet received. Don't need to for JOIN_RESPONSE, as JOIN_RESPONSE is just an ACK.
-		*Format: [Checksum, 2][ACK, 4][ACK command ID, 1][player id, 2]
+		Buffer the packet, getting back every packet that is now in order (may be none if there's a gap in front).
+		Packets too far ahead of the window are dropped without an ACK, so they get resent later.
+		The ACK is sent with the next packet to the server (or a standalone ACK after ACK_DELAY).
 	*/
-	int network_player_id{}; sockaddr_storage senderAddr{};
-	{
-		std::lock_guard<std::mutex> player_lock{ this_player_lock };
-		network_player_id = htons((uint16_t)this_player.player_ID);
-		senderAddr = this_player.addrDest;
-	}
-	char ack_buffer[9]{};
-	//Add in ACK number and command ID.
-	uint32_t network_response_ACK = htonl(seq_or_ack_number);
-	memcpy_s(ack_buffer + 2, 4, &network_response_ACK, 4);
-	ack_buffer[6] = ACK;
-	memcpy_s(ack_buffer + 7, 2, &network_player_id, 2);
-	//Calculate and add in checksum.
-	uint16_t network_checksum = htons(CalculateChecksum(7, ack_buffer + 2));
-	memcpy_s(ack_buffer, 2, &network_checksum, 2);
-
-	//Send back ACK response to sender.
-	{
-		std::lock_guard<std::mutex> socket_locker{ socket_lock };
-		WriteToSocket(udp_socket, senderAddr, ack_buffer, 9);
-	}
+	std::vector<std::string> packets_in_order{};
+	if (!this_player.reliable_transfer.ReceivePacket(sequence_number, data, packets_in_order, current_time)) return;
 
 	/*
-		In both cases, add to the recv buffer. Set message complete to be true or false depending.
+		Reassemble the fragments after removing [General Command ID]
+		This is because general command ID is not necessary.
+		Once every fragment of a message is received, add it to the player's recv buffer.
 	*/
-	if (command_ID == COMMAND_COMPLETE || command_ID == COMMAND_INCOMPLETE)
+	for (const std::string& packet_data : packets_in_order)
 	{
-		//Message format: [General Command = COMMAND][Command ID]...[Command ID 2]
-		std::lock_guard<std::mutex> player_lock{ this_player_lock };
-
-		//==Check if it's a new message, by comparing packet number with the last successful packet.
-		if (this_player.reliable_transfer.ack_last_packet_received >= seq_or_ack_number) return;
-		//it's a new packet, so update the stored ack number.
-		this_player.reliable_transfer.ack_last_packet_received = seq_or_ack_number;
-
-
-		/*
-			Add to the player's recv buffer after removing [General Command ID]
-			This is because general command ID is not necessary.
-			Doing this also helps to chain incomplete packets together.
-		*/
-		this_player.recv_buffer.insert(this_player.recv_buffer.end(), data.begin() + 1, data.end());
-		if (command_ID == COMMAND_COMPLETE) this_player.is_recv_message_complete = true;
-		else this_player.is_recv_message_complete = false; //Still need to wait for more packets.
-
-		//PrintString("MESSAGE RECV, Seq Num: " + std::to_string(seq_or_ack_number) + " Data: " + data);
+		std::string complete_message{};
+		if (!this_player.reassembler.ReceiveFragment(packet_data.data() + 1, packet_data.size() - 1, complete_message)) continue;
+		this_player.recv_buffer += complete_message;
+		this_player.is_recv_message_complete = true;
 	}
 
+	//PrintString("MESSAGE RECV, Seq Num: " + std::to_string(sequence_number) + " Data: " + data);
 }
 /*
-		It should be called in a separate thread.
-		Will continually read messages from the udp socket, handling them.
-		Will write messages to socket as needed (for messages that require ACK) based on toSend and timeout.
+		It should be called in a separate thread, the only thread that writes to the socket.
+		Will write messages to socket as needed (for messages that require ACK) based on the send window and timeout.
+		Sleeps until the nearest retransmission or ACK deadline, or until woken because there is something new to send.
 
 		Note:
-		- Only messages that require an ACK should be sent in this method. Otherwise, just write as per normal (note need to use mutex lock)
-		- To Send: Set the send buffer to the message (excluding checksum and sequence number). Set toSend to be true.
-		- Packet data in the queue has their checksum and sequence number stripped away. They are all confirmed to be uncorrupted,
-		and the number is a separate variable from the data.
+		- Only messages that require an ACK should be sent in this method. Otherwise, queue them with socket_io.QueueSend().
+		- To Send: Add the message (excluding header) to messages_to_send.
+		- ACKs for received packets are carried in the header of the packets sent, or sent on their own after ACK_DELAY.
 */
-void ReceiveSendMessages()
+void SendMessages()
 {
-	//Buffer used for receiving data.
-	char buffer[MAX_BUFFER_SIZE]{};
-
+	//Earliest time there is something to send, from the last pass.
+	Ticks next_send_time = 0;
 	while (isGameRunning)
 	{
-		std::vector<WriteData> data_to_write{};
+		//Sleeps until the next deadline, or until another thread queues a datagram or adds a message.
+		socket_io.WaitForQueuedSends((std::min)(TicksToSeconds(next_send_time - GetMonotonicTime()), IDLE_WAIT_INTERVAL));
+		socket_io.FlushSends();
+
+		//Written after the lock is released, so the socket is never written while holding the session lock.
+		std::vector<Outgoing_Datagram> data_to_write{};
 		/*
 			Send all pending messages
 			- Timeout has run out
@@ -1035,84 +616,89 @@ void ReceiveSendMessages()
 
 			Ensure send buffer isn't empty.
 		*/
-		for (int i = 0; i < 1; i++) //Loop of 1 iteration is just for early returns like "continue" or "break".
 		{
 			std::lock_guard<std::mutex> player_lock{ this_player_lock };
 			Player_Session& session = this_player;
-			//Ensure that data being written is not empty.
-			if (session.messages_to_send.empty()) break;
-			if (session.messages_to_send.front().empty())
+			//Other packets need the player ID from JOIN_RESPONSE, so only the JOIN_REQUEST is in flight until then.
+			int window_size = (session.player_ID == -1) ? 1 : SEND_WINDOW_SIZE;
+			//Let more packets into the window if there's space, then send the new and timed out packets.
+			session.reliable_transfer.FillSendWindow(session.messages_to_send, window_size);
+			Ticks current_time = UpdateCachedTime();
+			std::vector<Encoded_Frame*> frames{};
+			session.reliable_transfer.GetFramesToSend(current_time, frames);
+			//Sequenced message is sent once without waiting for the window.
+			//Format: [COMMAND_SEQUENCED, 1][player id, 2][Sequence Number, 4][Command ID]...
+			Encoded_Frame sequenced_frame{};
+			if (session.player_ID != -1 && !session.sequenced_message_to_send.empty())
 			{
-				session.messages_to_send.pop();
-				break;
+				uint16_t network_player_id = htons((uint16_t)session.player_ID);
+				char sequenced_prefix[3]{};
+				sequenced_prefix[0] = COMMAND_SEQUENCED;
+				memcpy_s(sequenced_prefix + 1, 2, &network_player_id, 2);
+				std::string sequenced_message = std::string(sequenced_prefix, sequenced_prefix + 3) + session.sequenced_transfer.EncodeMessage(session.sequenced_message_to_send);
+				sequenced_frame = EncodeFrame(-1, sequenced_message);
+				frames.push_back(&sequenced_frame);
+				session.sequenced_message_to_send.clear();
 			}
-			if (GetTime() - session.reliable_transfer.time_last_packet_sent > TIMEOUT_TIMER)
+			//Nothing is going out to carry the ACKs of the packets received, so send them on their own.
+			//Format: [ACK command ID, 1][player id, 2]
+			Encoded_Frame ack_frame{};
+			if (frames.empty() && session.player_ID != -1 && session.reliable_transfer.IsStandaloneAckDue(current_time))
 			{
-				session.reliable_transfer.toSend = true;
+				uint16_t network_player_id = htons((uint16_t)session.player_ID);
+				char ack_message[3]{};
+				ack_message[0] = ACK;
+				memcpy_s(ack_message + 1, 2, &network_player_id, 2);
+				ack_frame = EncodeFrame(-1, std::string(ack_message, ack_message + 3));
+				frames.push_back(&ack_frame);
 			}
-			if (!session.reliable_transfer.toSend) break;
-			//Below here, packet is to be sent.
-			std::string message_to_send = session.messages_to_send.front();
-			//Don't pop, unless ACK'd.
-
-			//Add sequence number to the send.
-			uint32_t network_sequence_number = htonl(session.reliable_transfer.current_sequence_number);
-			char number_buffer[4]{};
-			memcpy_s(number_buffer, 4, &network_sequence_number, 4);
-			std::string sequence_number(number_buffer, number_buffer + 4); //Casting the number to a string.
-
-			std::string data = sequence_number + message_to_send;
-
-			//Add in checksum, convert to network order.
-			uint16_t checksum = htons(CalculateChecksum(data.size(), data.data()));
-			//Collate everything into a single string.
-			memcpy_s(number_buffer, 2, &checksum, 2); //overwrite the previous data in buffer for 0 and 1 byte.
-			std::string checksum_string(number_buffer, number_buffer + 2); //Convert checksum to number.
-			data = checksum_string + data; //checksum in front of data.
-
-			//Reset timeout.
-			session.reliable_transfer.time_last_packet_sent = GetTime();
-			session.reliable_transfer.toSend = false;
-			data_to_write.push_back({ session.addrDest, data });
-
-			//PrintString("MESSAGE SENT, Seq Num: " + std::to_string(session.reliable_transfer.current_sequence_number) + " Data: " + data);
-		}
-
-		{
-			std::lock_guard<std::mutex> socket_locker{ socket_lock };
-			for (WriteData& write_data : data_to_write)
+			//Pack the frames into as few datagrams as possible, each carrying the ACKs in its header.
+			for (std::string& data : session.reliable_transfer.AssembleDatagrams(frames))
 			{
-				//Send data over
-				WriteToSocket(udp_socket, write_data.addrDest, write_data.data.data(), write_data.data.size());
+				data_to_write.push_back({ session.addrDest, std::move(data) });
 			}
+			next_send_time = session.reliable_transfer.GetNextSendTime();
 		}
 
-		memset(buffer, 0, MAX_BUFFER_SIZE);
-		/*
-			Receive all messages.
-			Upon receiving, add the packet to the queue.
-		*/
-		//==Read any incoming message.
-		sockaddr_storage sender_addr{}; //temporarily store sender's address.
-		int size_sockaddr = sizeof(sender_addr);
-		int bytes_read{};
-		{
-			std::lock_guard<std::mutex> socket_locker{ socket_lock };
-			bytes_read = recvfrom(udp_socket, buffer, MAX_BUFFER_SIZE, 0, (sockaddr*)&sender_addr, &size_sockaddr);
-		}
-		if (bytes_read <= 0) continue; //Since it is a non-blocking socket read.
-
+		//Send data over
+		socket_io.SendBatch(data_to_write);
+	}
+}
 
-		//==Check if valid.
-		//Do not accept any message that doesn't have both a checksum and a sequence number
-		//since the game always uses RDT protocol for all messages.
-		if (bytes_read < 6) continue;
-		int number = ReadChecksumAndNumber(buffer, bytes_read);
-		if (number == -1) continue; //Checksum failed.
+/*
+		It should be called in a separate thread, the only thread that reads from the socket.
+		Will continually read messages from the udp socket, handling them.
 
-		//==Handle the uncorrupted packets
-		//First, remove the checksum and sequence number from the packet to make it easier to read.
-		std::string data_recv(buffer + 6, buffer + bytes_read);
-		HandleReceivedPackets(data_recv, number);
+		Note:
+		- Packet data received has their header stripped away. They are all confirmed to be uncorrupted,
+		and the header is a separate variable from the data.
+*/
+void ReceiveMessages()
+{
+	while (isGameRunning)
+	{
+		//Sleeps while there is nothing to read.
+		if (socket_io.ReceiveDatagrams(IDLE_WAIT_INTERVAL) == 0) continue;
+		Queued_Datagram* datagrams[PACKET_BATCH_SIZE]{};
+		while (size_t datagram_count = socket_io.received.PeekBatch(datagrams, PACKET_BATCH_SIZE))
+		{
+			for (size_t i = 0; i < datagram_count; i++)
+			{
+				//==Check if valid.
+				Packet_Header header{};
+				std::vector<Frame> frames{};
+				if (!ReadDatagram(datagrams[i]->data, datagrams[i]->length, header, frames)) continue; //Too short or integrity check failed.
+
+				//==Handle the uncorrupted packets
+				//Each frame in the datagram is handled as its own packet, with the headers already removed.
+				for (Frame& frame : frames)
+				{
+					HandleReceivedPackets(std::move(frame.message), frame.sequence_number, header);
+				}
+			}
+			socket_io.received.PopBatch(datagram_count);
+		}
+		//ACKs may have opened up the send window, and received packets need their ACKs sent, so the sending thread has new deadlines.
+		socket_io.WakeSender();
 	}
 }
\ No newline at end of file
@@ -190,7 +190,6 @@ std::vector<unsigned int> new_players;
 std::vector<std::pair<unsigned int, unsigned int>> new_otherbullets; //list of bullets created by other players
 std::map<unsigned int, Asteroids> Asteroid_map;
 std::vector<std::pair<unsigned int, Asteroids>> new_asteroids;
-std::vector<CollisionEvent> all_collisions;
 std::vector<std::pair<unsigned int,int>> asteroid_destruction;
 std::set<unsigned int> player_hit;
 std::vector<std::pair<unsigned int, unsigned int>> bullet_destruction;
@@ -208,58 +207,6 @@ float get_TimeStamp() {
 
 
 
-/******************************************************************************/
-/*!
-\brief
-Adds a new random asteroid within min-max x,y scale as defined by the constants ASTEROID_MAX_SCALE....
-Gives it a random pos within window screen size, and set its velocity randomly within (-100 to 100, -100 to 100)
-Adds newly created asteroid to gameobjectinstance list.
-*/
-/******************************************************************************/
-void AddNewAsteroid()
-{
-	//static lambda to only run once.
-	static auto once = []() {
-		srand((unsigned int)AEGetTime(nullptr));
-		};
-	AEVec2 pos, vel, scale;
-	//Set it so that it doesn't spawn on the player.
-	do
-	{
-		pos = { (float)(rand() % ((int)AEGfxGetWinMaxX() * 2)) + AEGfxGetWinMinX(), (float)(rand() % ((int)AEGfxGetWinMaxY() * 2)) + AEGfxGetWinMinY() };
-
-	} while (pos.x < spShip->posCurr.x + 200 && pos.x > spShip->posCurr.x - 200 || pos.y < spShip->posCurr.y + 200 && pos.y > spShip->posCurr.y - 200);
-	vel = { (float)(rand() % 200) - 100.f,(float)(rand() % 200) - 100.f };
-	scale = { (float)(rand() % (int)(ASTEROID_MAX_SCALE_X - ASTEROID_MIN_SCALE_X)) + ASTEROID_MIN_SCALE_X,(float)(rand() % (int)(ASTEROID_MAX_SCALE_Y - ASTEROID_MIN_SCALE_Y) + ASTEROID_MIN_SCALE_Y) };
-	static int obj_id = 0;
-	auto test = gameObjInstCreate(TYPE_ASTEROID, &scale, &pos, &vel, 0.0f);
-
-	Asteroids temp;
-
-	// Position
-	temp.Position_x = pos.x;
-	temp.Position_y = pos.y;
-
-	// Velocity
-	temp.Velocity_x = vel.x;
-	temp.Velocity_y = vel.y;
-
-	// Scale
-	temp.Scale_x = scale.x;
-	temp.Scale_y = scale.y;
-
-	// Rotation
-	temp.Rotation = 0.0f;
-
-	// Time of creation
-	temp.time_of_creation = get_TimeStamp();
-
-	test->Object_ID = obj_id;
-	Asteroid_map[test->Object_ID] = temp;
-
-	sGameObjInstNum++;
-	obj_id++;
-}
 static bool onValueChange = true;
 
 
@@ -400,10 +347,7 @@ void GameStateAsteroidsInit(void)
 	sGameObjInstNum++;
 
 
-	for (int i = 0; i < 4; i++)
-	{
-		AddNewAsteroid();
-	}
+	//Asteroids are all spawned by the server (SERVER_ASTEROID_CREATION), so every player sees the same ones.
 
 	// create the static wall
 	AEVec2Set(&scale, WALL_SCALE_X, WALL_SCALE_Y);
@@ -547,9 +491,6 @@ void GameStateAsteroidsUpdate(void)
 	// Pos1 = v1*t + Pos0
 	float deltaTime = (float)AEFrameRateControllerGetFrameTime();
 
-	//RECALCULATE TIME STAMP AT THE START OF THE PROGRAM
-	program_start = std::chrono::steady_clock::now(); // Starts at 0
-
 	//Acceleration
 	AEVec2 addedAccel{};
 
@@ -743,93 +684,9 @@ void GameStateAsteroidsUpdate(void)
 
 
 	// ======================================================================
-	// check for dynamic-dynamic collisions
+	// dynamic-dynamic collisions (asteroids against bullets and ships)
+	// are decided by the server, which sends back which asteroids were destroyed (SERVER_COLLISION).
 	// ======================================================================
-	float tFirst{};
-	/*
-		Loop the array once for each object in the array(two for loops).
-		Only check cases of collision with asteroids.
-	*/
-	for (int i = 0; i < GAME_OBJ_INST_NUM_MAX; i++)
-	{
-		GameObjInst& gameObj1 = sGameObjInstList[i];
-		if (!gameObj1.flag) continue;
-		for (int j = 0; j < GAME_OBJ_INST_NUM_MAX; j++)
-		{
-			GameObjInst& gameObj2 = sGameObjInstList[j];
-			if (!gameObj2.flag) continue;
-			if (gameObj1.pObject->type == TYPE_ASTEROID)
-			{
-				CollisionEvent temp{};
-
-				switch (gameObj2.pObject->type)
-				{
-				case TYPE_SHIP: //Reduce life, move ship back to center, delete asteroid.
-					if (sShipLives < 0 || !runGame) continue; //don't collide with a dead ship or a winning ship.
-					//Static collision failed, check dynamic now.
-					if (!CollisionIntersection_RectRect(gameObj1.boundingBox, gameObj1.velCurr, gameObj2.boundingBox, gameObj2.velCurr, tFirst))
-					{
-						//Will not collide within this frame.
-						if (tFirst >= deltaTime)
-						{
-							continue;
-						}
-					}
-					//Has collided or will collide within this frame. 
-					//spShip->posCurr = spShip->posPrev = { 0, 0 };
-					//spShip->velCurr = { 0, 0 };
-					//sShipLives--;
-					//gameObjInstDestroy(&gameObj1);
-					//AddNewAsteroid();
-					//sGameObjInstNum--;
-					//sScore += 100;
-					//onValueChange = true;
-
-					temp.asteroid_ID = gameObj1.Object_ID;
-					temp.object_ID = 0;
-					temp.timestamp = get_TimeStamp();
-
-					all_collisions.push_back(temp);
-					break;
-				case TYPE_BULLET:
-					//Static collision failed, check dynamic now.
-					if (!CollisionIntersection_RectRect(gameObj1.boundingBox, gameObj1.velCurr, gameObj2.boundingBox, gameObj2.velCurr, tFirst))
-					{
-						//Will not collide within this frame.
-						if (tFirst >= deltaTime)
-						{
-							continue;
-						}
-					}
-					////Has collided or will collide within this frame. 
-					////delete both bullet and asteroid, then add 1-2 new asteroids.
-					//gameObjInstDestroy(&gameObj1);
-					//gameObjInstDestroy(&gameObj2);
-					//sGameObjInstNum -= 2;
-					//for (int k = 0; k < rand() % 2 + 1; k++)
-					//{
-					//	AddNewAsteroid();
-					//}
-					//sScore += 100;
-					//onValueChange = true;
-
-					temp.asteroid_ID = gameObj1.Object_ID;
-					temp.object_ID = gameObj2.Object_ID;
-					temp.timestamp = get_TimeStamp();
-
-					all_collisions.push_back(temp);
-
-					//std::cout << "Asteroid ID: " << gameObj1.Object_ID << ", Bullet ID: " << gameObj2.Object_ID << std::endl;
-					break;
-
-					default: continue; //If asteroid or wall, no need check collision.
-				}
-			}
-
-		}
-	}
-
-
 
 
 	// ===================================================================
@@ -998,22 +855,19 @@ void GameStateAsteroidsUpdate(void)
 
 	{
 		std::lock_guard<std::mutex> player_lock{ this_player_lock };
-		std::string message_to_SERVER{};
-		message_to_SERVER += Write_PlayerTransform(players[this_player.player_ID]);
-
+		//Transform is sent on the sequenced channel, so a lost transform doesn't hold up newer ones.
+		this_player.SendSequencedMessage(Write_PlayerTransform(players[this_player.player_ID]));
 
-		if (new_bullets.size()) {
+		//Only written when there are new bullets. The server doesn't wait for it, it reads whatever has arrived on each tick.
+		if (!new_bullets.empty())
+		{
+			std::string message_to_SERVER{};
 			message_to_SERVER += Write_NewBullet(this_player.player_ID, new_bullets);
-		}
-
-		if (all_collisions.size()) {
-			message_to_SERVER += Write_AsteroidCollision(this_player.player_ID, all_collisions);
-			PrintString("CollisionWritten");
-		}
 
-		//std::cout << message_to_SERVER.c_str();
+			//std::cout << message_to_SERVER.c_str();
 
-		this_player.SendLongMessage(message_to_SERVER);
+			this_player.SendLongMessage(message_to_SERVER);
+		}
 	}
 
 	/////////////////////////////////////////////////////////
@@ -1022,51 +876,32 @@ void GameStateAsteroidsUpdate(void)
 	////////////////////////////////////////////////////////
 
 	std::string buffer{};
-	//Spinlock until something is read.
-	while (true)
+	//Takes whatever has arrived since the last frame without waiting, as the server sends on its own ticks rather than in reply.
 	{
-		
-		{
-			std::lock_guard<std::mutex> player_lock{ this_player_lock };
-			if (!this_player.recv_buffer.empty() && this_player.is_recv_message_complete) {
-				buffer = this_player.recv_buffer;
-				this_player.recv_buffer.clear(); //Clear since it's been read.
-				this_player.is_recv_message_complete = false; //Since buffer has been cleared.
-				break;
-			}
+		std::lock_guard<std::mutex> player_lock{ this_player_lock };
+		//Latest transforms (if new ones arrived) are read together with the rest of the commands.
+		buffer = this_player.sequenced_transfer.TakeLatestMessage();
+		if (!this_player.recv_buffer.empty() && this_player.is_recv_message_complete) {
+			buffer += this_player.recv_buffer;
+			this_player.recv_buffer.clear(); //Clear since it's been read.
+			this_player.is_recv_message_complete = false; //Since buffer has been cleared.
 		}
-		//Give other threads a chance to grab the mutex.
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
-		continue;
 	}
 
 	//std::cout << "\n\n";
 	if (!buffer.empty()) {
 
-		//we need to split first (ROLL EYE)
-		//we need to do bytes checking, function should return the number of bytes read
+		//Every command starts on a byte, [Command ID, 1] followed by its bit-packed fields.
+		//Reading stops at a command cut off part way, as the commands after it can't be found.
+		Bit_Reader input{ buffer.data(), buffer.size() };
 
-		int bytes_read = 0;
+		while (input.GetBytesLeft() > 0) {
 
-		while (bytes_read < buffer.size()) {
-
-			uint8_t Command_ID = buffer[bytes_read]; //lets say 0
-			bytes_read++;
-			// reads 5, read next command
-			PrintString(std::to_string(bytes_read));
+			uint8_t Command_ID = static_cast<uint8_t>(input.ReadBits(8));
 			if (Command_ID == SERVER_PLAYER_TRANSFORM) { //server_player_transform
 
 				//std::cout << "SERVER_PLAYER_TRANSFORM\n";
-				if (bytes_read >= buffer.size()) break; //No more things to read.
-				std::string result = buffer.substr(bytes_read); // Starts at index 1 and goes to the end
-				//if (!result.size()) {
-				//	continue;
-				//}
-				int tempp = Read_PlayersTransform(result, players, new_players); //add to player map, lets say 5
-				//std::cout << "tempp size: " << tempp << std::endl;
-
-				//so now bytes read will be 6
-				bytes_read += tempp;
+				if (!Read_PlayersTransform(input, players, new_players)) break; //add to player map
 				//create new players
 				for (unsigned int player : new_players) {
 
@@ -1092,13 +927,7 @@ void GameStateAsteroidsUpdate(void)
 			}
 			else if (Command_ID == SERVER_BULLET_CREATION) { //server_bullet_transform
 
-				if (bytes_read >= buffer.size()) break; //No more things to read.
-				std::string result = buffer.substr(bytes_read); // Starts at index 1 and goes to the end
-				// test if msg is empty
-				if (!result.size()) {
-					continue;
-				}
-				bytes_read += Read_New_Bullets(result, all_bullets, players, new_otherbullets);
+				if (!Read_New_Bullets(input, all_bullets, players, new_otherbullets)) break;
 
 				for (std::pair<unsigned int, unsigned int> one_bullet : new_otherbullets) {
 
@@ -1116,7 +945,8 @@ void GameStateAsteroidsUpdate(void)
 							AEVec2 vel{ iter->second.Velocity_X, iter->second.Velocity_Y };
 
 							//gameObjInstCreate(TYPE_BULLET, &scale, &spShip->posCurr, &vel, spShip->dirCurr);
-							gameObjInstCreate(this_player.player_ID, one_bullet.second, TYPE_BULLET, &scale, &pos, &vel, iter->second.Rotation);
+							//Owned by the player that fired it, so the server's destruction events (by player and bullet ID) find it.
+							gameObjInstCreate((int)one_bullet.first, one_bullet.second, TYPE_BULLET, &scale, &pos, &vel, iter->second.Rotation);
 							sGameObjInstNum++;
 
 						}
@@ -1130,9 +960,7 @@ void GameStateAsteroidsUpdate(void)
 			else if (Command_ID == SERVER_ASTEROID_CREATION) {
 
 				//std::cout << "SERVER_ASTEROID_CREATION\n";
-				if (bytes_read >= buffer.size()) break; //No more things to read.
-				std::string result = buffer.substr(bytes_read);
-				bytes_read += Read_AsteroidCreations(result, Asteroid_map, new_asteroids);
+				if (!Read_AsteroidCreations(input, Asteroid_map, new_asteroids)) break;
 
 				for (std::pair<unsigned int, Asteroids>& Asteroided : new_asteroids) {
 
@@ -1158,12 +986,7 @@ void GameStateAsteroidsUpdate(void)
 			else if (Command_ID == SERVER_COLLISION) {
 
 				//std::cout << "SERVER_COLLISION\n";
-				if (bytes_read >= buffer.size()) break; //No more things to read.
-				std::string result = buffer.substr(bytes_read);
-				if (!result.size()) {
-					continue;
-				}
-				bytes_read += Read_AsteroidDestruction(result, all_bullets, Asteroid_map, bullet_destruction, asteroid_destruction);
+				if (!Read_AsteroidDestruction(input, all_bullets, Asteroid_map, bullet_destruction, asteroid_destruction)) break;
 
 				for (std::pair<unsigned int, int>& Asteroid_ID : asteroid_destruction) {
 					DestroyInstanceByID(Asteroid_ID.first, TYPE_ASTEROID, this_player.player_ID);
@@ -1365,7 +1188,6 @@ void GameStateAsteroidsUpdate(void)
 	player_hit.clear();
 	asteroid_destruction.clear();
 	bullet_destruction.clear();
-	all_collisions.clear();
 
 	// =====================================================================
 	// calculate the matrix for all objects
@@ -26,11 +26,12 @@ bool isGameRunning = true;
 */
 void SendJoinRequest()
 {
-	char message = JOIN_REQUEST;
+	//[JOIN_REQUEST][Supported Integrity Modes, 1], the server picks the integrity mode from these.
+	char message[2]{ JOIN_REQUEST, static_cast<char>(SUPPORTED_INTEGRITY_MODES) };
 	std::lock_guard<std::mutex> player_lock{ this_player_lock };
-	//Send the General Command ID only to message queue, then let the other thread handle the checksum and sequence number.
-	this_player.messages_to_send.push(std::string(&message, &(message)+1));
-	this_player.reliable_transfer.toSend = true;
+	//Send the message to message queue, then let the other thread handle the header.
+	this_player.messages_to_send.push(std::string(message, message + 2));
+	socket_io.WakeSender();
 }
 
 /******************************************************************************/
@@ -71,7 +72,9 @@ int WINAPI WinMain(HINSTANCE instanceH, HINSTANCE prevInstanceH, LPSTR command_l
 		AESysExit();
 		return returnVal;
 	}
-	std::thread thread_that_handles_receiving_sending_messages(ReceiveSendMessages);
+	//Sending and receiving have a thread each, so neither waits on the other.
+	std::thread thread_that_handles_sending_messages(SendMessages);
+	std::thread thread_that_handles_receiving_messages(ReceiveMessages);
 	/*
 		Get Player ID and any other information required.
 	*/
@@ -125,7 +128,8 @@ int WINAPI WinMain(HINSTANCE instanceH, HINSTANCE prevInstanceH, LPSTR command_l
 	//To get all other threads to end.
 	isGameRunning = false;
 
-	if (thread_that_handles_receiving_sending_messages.joinable()) thread_that_handles_receiving_sending_messages.join();
+	if (thread_that_handles_sending_messages.joinable()) thread_that_handles_sending_messages.join();
+	if (thread_that_handles_receiving_messages.joinable()) thread_that_handles_receiving_messages.join();
 
 	// free the system
 	AESysExit();
@@ -0,0 +1,207 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file BatchedIOBenchmark.cpp
+\author Joel Lee Jie
+\date 15 October 2026
+\brief
+This file benchmarks the server's socket hot path on loopback, in datagrams per second.
+- receive: draining a burst of datagrams waiting on the socket into a Packet_Ring,
+  one recvfrom() per datagram (before) against Datagram_IO::ReceiveDatagrams() (after, recvmmsg on Linux).
+- send: writing one datagram to each of 4, 16 and 64 sessions, like the per-tick world update,
+  one sendto() per datagram (before) against Datagram_IO::SendBatch() (after, sendmmsg on Linux).
+Only the socket calls are timed, not filling or draining the sockets around them.
+On platforms without recvmmsg/sendmmsg both columns make one call per datagram.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "../Utility.hpp"
+#include <cstdio>
+#include <vector>
+
+namespace {
+	//Size of each datagram, about the size of a player transform update.
+	constexpr int DATAGRAM_SIZE = 64;
+	//Datagrams waiting on the socket at the start of every receive round, small enough for the default receive buffer.
+	constexpr int RECEIVE_BURST = 64;
+	//Rounds of each test.
+	constexpr int ROUND_COUNT = 2000;
+
+	/*
+		\brief
+		Creates a non-blocking UDP socket bound to a free loopback port, returning its address in addr.
+	*/
+	SOCKET CreateLoopbackSocket(sockaddr_storage& addr)
+	{
+		SOCKET udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+		sockaddr_in local{};
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		local.sin_port = 0;
+		bind(udp_socket, (sockaddr*)&local, sizeof(local));
+		Socket_Length size_sockaddr = sizeof(addr);
+		getsockname(udp_socket, (sockaddr*)&addr, &size_sockaddr);
+		SetNonBlocking(udp_socket);
+		return udp_socket;
+	}
+
+	/*
+		\brief
+		Waits for the socket to be readable, then reads every datagram waiting into the ring one recvfrom() at a time,
+		like ReceiveDatagrams() before batching.
+	*/
+	size_t ReceiveOneAtATime(SOCKET udp_socket, Packet_Ring& received)
+	{
+		if (!PollReadable(udp_socket, 0)) return 0;
+		char buffer[MAX_BUFFER_SIZE];
+		size_t datagrams_received = 0;
+		while (true)
+		{
+			sockaddr_storage sender_addr{};
+			Socket_Length size_sockaddr = sizeof(sender_addr);
+			int bytes_read = static_cast<int>(recvfrom(udp_socket, buffer, MAX_BUFFER_SIZE, 0, (sockaddr*)&sender_addr, &size_sockaddr));
+			if (bytes_read == SOCKET_ERROR)
+			{
+				if (IsWouldBlockError(GetLastSocketError())) break;
+				continue;
+			}
+			if (bytes_read < DATAGRAM_HEADER_SIZE) continue;
+			if (received.Push(sender_addr, buffer, bytes_read)) datagrams_received++;
+		}
+		return datagrams_received;
+	}
+
+	/*
+		\brief
+		Empties the ring, as the handling thread would.
+	*/
+	void EmptyRing(Packet_Ring& ring)
+	{
+		Queued_Datagram* datagrams[PACKET_BATCH_SIZE]{};
+		while (size_t count = ring.PeekBatch(datagrams, PACKET_BATCH_SIZE)) ring.PopBatch(count);
+	}
+
+	/*
+		\brief
+		Reads and discards every datagram waiting on the socket.
+	*/
+	void DrainSocket(SOCKET udp_socket)
+	{
+		char buffer[MAX_BUFFER_SIZE];
+		while (recv(udp_socket, buffer, MAX_BUFFER_SIZE, 0) > 0);
+	}
+
+	/*
+		\brief
+		Times draining RECEIVE_BURST datagrams from the socket, before and after batching.
+		\return
+		Datagrams per second, for one recvfrom() per datagram (before) and ReceiveDatagrams() (after).
+	*/
+	void RunReceiveTest(double& before, double& after)
+	{
+		sockaddr_storage sender_addr{}, receiver_addr{};
+		SOCKET sender = CreateLoopbackSocket(sender_addr);
+		SOCKET receiver = CreateLoopbackSocket(receiver_addr);
+		Datagram_IO socket_io{};
+		socket_io.Attach(receiver);
+		Packet_Ring received{};
+		char data[DATAGRAM_SIZE]{};
+
+		double time_taken[2]{};
+		size_t datagrams_received[2]{};
+		for (int round = 0; round < ROUND_COUNT; round++)
+		{
+			for (int method = 0; method < 2; method++)
+			{
+				for (int i = 0; i < RECEIVE_BURST; i++) WriteToSocket(sender, receiver_addr, data, DATAGRAM_SIZE);
+				double start_time = TicksToSeconds(GetMonotonicTime());
+				if (method == 0)
+				{
+					datagrams_received[method] += ReceiveOneAtATime(receiver, received);
+				}
+				else
+				{
+					datagrams_received[method] += socket_io.ReceiveDatagrams(0);
+				}
+				time_taken[method] += TicksToSeconds(GetMonotonicTime()) - start_time;
+				EmptyRing(method == 0 ? received : socket_io.received);
+			}
+		}
+		before = datagrams_received[0] / time_taken[0];
+		after = datagrams_received[1] / time_taken[1];
+		CloseSocket(sender);
+		CloseSocket(receiver);
+	}
+
+	/*
+		\brief
+		Times writing one datagram to each of session_count sessions, before and after batching.
+		\return
+		Datagrams per second, for one sendto() per datagram (before) and SendBatch() (after).
+	*/
+	void RunSendTest(int session_count, double& before, double& after)
+	{
+		sockaddr_storage server_addr{};
+		SOCKET server = CreateLoopbackSocket(server_addr);
+		Datagram_IO socket_io{};
+		socket_io.Attach(server);
+		std::vector<SOCKET> players(session_count);
+		std::vector<Outgoing_Datagram> world_update(session_count);
+		for (int i = 0; i < session_count; i++)
+		{
+			players[i] = CreateLoopbackSocket(world_update[i].addrDest);
+			world_update[i].data.assign(DATAGRAM_SIZE, '\0');
+		}
+
+		double time_taken[2]{};
+		size_t datagrams_sent[2]{};
+		for (int round = 0; round < ROUND_COUNT; round++)
+		{
+			for (int method = 0; method < 2; method++)
+			{
+				double start_time = TicksToSeconds(GetMonotonicTime());
+				if (method == 0)
+				{
+					for (Outgoing_Datagram& datagram : world_update)
+					{
+						if (socket_io.Send(datagram.addrDest, datagram.data.data(), datagram.data.size()) > 0) datagrams_sent[method]++;
+					}
+				}
+				else
+				{
+					datagrams_sent[method] += socket_io.SendBatch(world_update);
+				}
+				time_taken[method] += TicksToSeconds(GetMonotonicTime()) - start_time;
+				for (SOCKET player : players) DrainSocket(player);
+			}
+		}
+		before = datagrams_sent[0] / time_taken[0];
+		after = datagrams_sent[1] / time_taken[1];
+		for (SOCKET player : players) CloseSocket(player);
+		CloseSocket(server);
+	}
+}
+
+int main()
+{
+	if (StartupSockets() != NO_ERROR) return 1;
+
+	std::printf("%-10s%16s%16s   (datagrams per second)\n", "", "before", "after");
+	double before{}, after{};
+	RunReceiveTest(before, after);
+	std::printf("%-10s%16.0f%16.0f\n", "receive", before, after);
+
+	std::printf("\n%-10s%16s%16s   (datagrams per second)\n", "sessions", "before", "after");
+	const int session_counts[] = { 4, 16, 64 };
+	for (int session_count : session_counts)
+	{
+		RunSendTest(session_count, before, after);
+		std::printf("%-10d%16.0f%16.0f\n", session_count, before, after);
+	}
+	CleanupSockets();
+	return 0;
+}
@@ -0,0 +1,161 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file BroadphaseBenchmark.cpp
+\author Joel Lee Jie
+\date 16 October 2026
+\brief
+This file benchmarks finding the collisions of one simulation step, in milliseconds per step.
+Half the entities are asteroids and half are bullets, spread over a wrapping world that grows with the count,
+so every size has the same number of entities per cell.
+- all pairs: SweepAABB() on every asteroid against every bullet (before).
+- spatial hash: updating each entity's swept box in a Spatial_Hash, then SweepAABB() only on the asteroids
+  each bullet's query finds (after). The update is timed along with the queries.
+Entities move between steps, so the incremental update has work to do. Both columns must find the same hits.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "../Simulation.hpp"
+#include "../Utility.hpp"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+	//Length of each step, at the server's default tick rate.
+	constexpr float STEP_TIME = 1.0f / 30.0f;
+	//World area for each entity, a bit busier than a full game in the 800x600 window.
+	constexpr float AREA_PER_ENTITY = 40.0f * 40.0f;
+	//Steps timed for each size, few since all pairs at 50000 entities takes seconds a step.
+	constexpr int STEP_COUNT = 2;
+
+	struct Entity
+	{
+		Sim_Vec2 position{}, velocity{}, scale{};
+		uint32_t proxy{};
+	};
+
+	Sim_AABB GetSweptBox(const Entity& entity)
+	{
+		Sim_AABB box = GetBoundingBox(entity.position, entity.scale);
+		Sim_Vec2 distance{ entity.velocity.x * STEP_TIME, entity.velocity.y * STEP_TIME };
+		return Sim_AABB{ { box.min.x + (std::min)(distance.x, 0.0f), box.min.y + (std::min)(distance.y, 0.0f) },
+			{ box.max.x + (std::max)(distance.x, 0.0f), box.max.y + (std::max)(distance.y, 0.0f) } };
+	}
+
+	/*
+		\brief
+		Counts the bullets that touch an asteroid during the step by testing every pair.
+	*/
+	size_t FindHitsAllPairs(const std::vector<Entity>& asteroids, const std::vector<Entity>& bullets)
+	{
+		size_t hit_count = 0;
+		for (const Entity& bullet : bullets)
+		{
+			Sim_AABB bullet_box = GetBoundingBox(bullet.position, bullet.scale);
+			for (const Entity& asteroid : asteroids)
+			{
+				float time{};
+				if (SweepAABB(GetBoundingBox(asteroid.position, asteroid.scale), asteroid.velocity, bullet_box, bullet.velocity, STEP_TIME, time)) hit_count++;
+			}
+		}
+		return hit_count;
+	}
+
+	/*
+		\brief
+		Counts the same hits as FindHitsAllPairs(), only testing the asteroids the broadphase finds near each bullet.
+		Asteroids have user data 0 and up, bullets have their index + asteroid count.
+	*/
+	size_t FindHitsSpatialHash(Spatial_Hash& broadphase, std::vector<Entity>& asteroids, std::vector<Entity>& bullets)
+	{
+		for (Entity& asteroid : asteroids) broadphase.Update(asteroid.proxy, GetSweptBox(asteroid));
+		for (Entity& bullet : bullets) broadphase.Update(bullet.proxy, GetSweptBox(bullet));
+
+		size_t hit_count = 0;
+		for (const Entity& bullet : bullets)
+		{
+			Sim_AABB bullet_box = GetBoundingBox(bullet.position, bullet.scale);
+			broadphase.Query(GetSweptBox(bullet), [&](uint32_t user_data) {
+				if (user_data >= asteroids.size()) return;
+				const Entity& asteroid = asteroids[user_data];
+				float time{};
+				if (SweepAABB(GetBoundingBox(asteroid.position, asteroid.scale), asteroid.velocity, bullet_box, bullet.velocity, STEP_TIME, time)) hit_count++;
+			});
+		}
+		return hit_count;
+	}
+
+	/*
+		\brief
+		Times STEP_COUNT steps of entity_count entities with each method.
+		\return
+		Milliseconds per step for all pairs (before) and the spatial hash (after), and whether they found the same hits.
+	*/
+	bool RunTest(int entity_count, double& before, double& after)
+	{
+		float world_size = std::sqrt(entity_count * AREA_PER_ENTITY);
+		std::mt19937 random{ static_cast<std::mt19937::result_type>(entity_count) };
+		std::uniform_real_distribution<float> position{ 0.0f, world_size };
+		std::uniform_real_distribution<float> asteroid_speed{ -100.0f, 100.0f };
+		std::uniform_real_distribution<float> asteroid_size{ 20.0f, 60.0f };
+		std::uniform_real_distribution<float> bullet_speed{ -400.0f, 400.0f };
+
+		Spatial_Hash broadphase{ {}, { world_size, world_size }, BROADPHASE_CELL_SIZE };
+		std::vector<Entity> asteroids(entity_count / 2), bullets(entity_count - entity_count / 2);
+		for (size_t a = 0; a < asteroids.size(); a++)
+		{
+			float size = asteroid_size(random);
+			asteroids[a] = Entity{ { position(random), position(random) }, { asteroid_speed(random), asteroid_speed(random) }, { size, size } };
+			asteroids[a].proxy = broadphase.Insert(GetSweptBox(asteroids[a]), static_cast<uint32_t>(a));
+		}
+		for (size_t b = 0; b < bullets.size(); b++)
+		{
+			bullets[b] = Entity{ { position(random), position(random) }, { bullet_speed(random), bullet_speed(random) }, BULLET_SCALE };
+			bullets[b].proxy = broadphase.Insert(GetSweptBox(bullets[b]), static_cast<uint32_t>(asteroids.size() + b));
+		}
+
+		bool is_matching = true;
+		double time_taken[2]{};
+		for (int step = 0; step < STEP_COUNT; step++)
+		{
+			double start_time = TicksToSeconds(GetMonotonicTime());
+			size_t all_pairs_hits = FindHitsAllPairs(asteroids, bullets);
+			double middle_time = TicksToSeconds(GetMonotonicTime());
+			size_t spatial_hash_hits = FindHitsSpatialHash(broadphase, asteroids, bullets);
+			time_taken[0] += middle_time - start_time;
+			time_taken[1] += TicksToSeconds(GetMonotonicTime()) - middle_time;
+			if (all_pairs_hits != spatial_hash_hits) is_matching = false;
+
+			for (std::vector<Entity>* entities : { &asteroids, &bullets })
+			{
+				for (Entity& entity : *entities)
+				{
+					entity.position.x = WrapValue(entity.position.x + entity.velocity.x * STEP_TIME, 0.0f, world_size);
+					entity.position.y = WrapValue(entity.position.y + entity.velocity.y * STEP_TIME, 0.0f, world_size);
+				}
+			}
+		}
+		before = time_taken[0] * 1000.0 / STEP_COUNT;
+		after = time_taken[1] * 1000.0 / STEP_COUNT;
+		return is_matching;
+	}
+}
+
+int main()
+{
+	std::printf("%-10s%16s%16s   (milliseconds per step)\n", "entities", "all pairs", "spatial hash");
+	const int entity_counts[] = { 1000, 5000, 10000, 50000 };
+	for (int entity_count : entity_counts)
+	{
+		double before{}, after{};
+		bool is_matching = RunTest(entity_count, before, after);
+		std::printf("%-10d%16.3f%16.3f%s\n", entity_count, before, after, is_matching ? "" : "   (hits differ)");
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file ChecksumBenchmark.cpp
+\author Joel Lee Jie
+\date 15 October 2026
+\brief
+This file benchmarks the checksum implementations against each other, across packet sizes
+from 7 bytes up to MAX_BUFFER_SIZE.
+It first checks that every implementation gives the same result as the original (bytewise) one,
+returning 1 if any of them don't.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "../Utility.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+	struct Implementation
+	{
+		ChecksumImplementation id;
+		const char* name;
+	};
+	const Implementation implementations[] = {
+		{ CHECKSUM_BYTEWISE, "bytewise" },
+		{ CHECKSUM_SCALAR_64, "scalar64" },
+		{ CHECKSUM_SSE2, "sse2" },
+		{ CHECKSUM_AVX2, "avx2" },
+	};
+
+	//Stops the compiler from optimising the benchmarked calls away.
+	volatile uint16_t sink{};
+}
+
+int main()
+{
+	std::mt19937 rng{ 1130 };
+	//Extra bytes so the data can start at any offset, to check unaligned loads.
+	std::vector<uint8_t> data(MAX_BUFFER_SIZE + 64);
+	for (uint8_t& byte : data) byte = static_cast<uint8_t>(rng());
+
+	/*
+		Check every implementation against the original for every length and a few offsets.
+	*/
+	for (const Implementation& implementation : implementations)
+	{
+		if (!IsChecksumImplementationSupported(implementation.id)) continue;
+		for (size_t offset = 0; offset < 8; offset++)
+		{
+			for (size_t length = 0; length <= MAX_BUFFER_SIZE; length++)
+			{
+				uint16_t expected = CalculateChecksumSumWith(CHECKSUM_BYTEWISE, length, data.data() + offset);
+				uint16_t result = CalculateChecksumSumWith(implementation.id, length, data.data() + offset);
+				if (result != expected)
+				{
+					std::printf("MISMATCH %s: length %zu offset %zu, expected 0x%04X got 0x%04X\n",
+						implementation.name, length, offset, expected, result);
+					return 1;
+				}
+			}
+		}
+	}
+	//All ones is the only data that sums to 0xFFFF, so check it doesn't come out as 0x0000 instead.
+	std::vector<uint8_t> all_ones(MAX_BUFFER_SIZE, 0xFF);
+	for (const Implementation& implementation : implementations)
+	{
+		if (!IsChecksumImplementationSupported(implementation.id)) continue;
+		if (CalculateChecksumSumWith(implementation.id, all_ones.size(), all_ones.data()) != 0xFFFF)
+		{
+			std::printf("MISMATCH %s: all ones\n", implementation.name);
+			return 1;
+		}
+	}
+	std::printf("All implementations match the original.\n");
+
+	/*
+		Time each implementation for each packet size.
+	*/
+	const size_t sizes[] = { 7, 16, 32, 64, 80, 96, 112, 128, 256, 512, MAX_PACKET_SIZE, 1500, MAX_BUFFER_SIZE };
+	std::printf("%-10s", "bytes");
+	for (const Implementation& implementation : implementations) std::printf("%14s", implementation.name);
+	std::printf("%14s   (ns per checksum)\n", "picked");
+	for (size_t size : sizes)
+	{
+		std::printf("%-10zu", size);
+		//Roughly the same amount of data for every size, so small sizes still run long enough to measure.
+		size_t iterations = (std::max)(static_cast<size_t>(200000), static_cast<size_t>(200000000) / (size + 16));
+		for (const Implementation& implementation : implementations)
+		{
+			if (!IsChecksumImplementationSupported(implementation.id))
+			{
+				std::printf("%14s", "n/a");
+				continue;
+			}
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < iterations; i++)
+			{
+				//Offset changes each time, so the work can't be hoisted out of the loop.
+				sink = CalculateChecksumSumWith(implementation.id, size, data.data() + (i & 7));
+			}
+			auto end = std::chrono::steady_clock::now();
+			double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+			std::printf("%14.1f", nanoseconds);
+		}
+		//Which one CalculateChecksumSum uses for this size, on this CPU.
+		std::printf("%14s\n", implementations[GetFastestChecksumImplementation(size)].name);
+	}
+	return 0;
+}
@@ -0,0 +1,389 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file ImpairmentRelay.cpp
+\author Joel Lee Jie
+\date 16 October 2026
+\brief
+This file implements a UDP relay that sits between the clients and the server on one machine,
+impairing the datagrams passing through it like a bad network would, so the reliable transfer
+and the game loop can be measured under latency and loss.
+
+Usage: ImpairmentRelay <listen port> <server ip> <server port> [options]
+	--latency ms     delay added to every datagram (default 0)
+	--jitter ms      random delay of up to +-ms on top of the latency, without reordering (default 0)
+	--loss %         chance a datagram is dropped (default 0)
+	--duplicate %    chance a datagram is delivered twice (default 0)
+	--reorder %      chance a datagram is held back by --reorder-delay, letting later ones overtake it (default 0)
+	--reorder-delay ms (default 10)
+	--bandwidth kbps link rate in each direction, 0 for unlimited (default 0)
+	--queue ms       datagrams that would wait longer than this for the link are dropped (default 200)
+	--seed n         seed of the random decisions (default 1)
+	--duration s     time to run for, 0 to run until killed (default 0)
+	--report s       time between reports of what was done to the datagrams (default 5)
+
+Clients send to the listen port instead of the server. Each client is given its own socket towards the server,
+so the server still sees one address per client.
+Every direction of every client draws from its own random sequence, seeded from the seed, the client
+(in order of their first datagram) and the direction. The same datagrams are therefore lost, duplicated and
+delayed on every run with the same seed, whatever the timing between clients, except for drops from a full link queue.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "../Utility.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	//Max number of clients relayed, each with a socket of its own.
+	constexpr size_t MAX_RELAY_CLIENTS = 256;
+
+	struct Impairment_Config
+	{
+		Ticks latency{ 0 };
+		Ticks jitter{ 0 };
+		//Chances are from 0 to 1.
+		double loss{ 0 };
+		double duplicate{ 0 };
+		double reorder{ 0 };
+		Ticks reorder_delay{ 10 * TICKS_PER_MILLISECOND };
+		//Bits per second, 0 for unlimited.
+		double bandwidth{ 0 };
+		Ticks max_queue_delay{ 200 * TICKS_PER_MILLISECOND };
+		uint64_t seed{ 1 };
+		Ticks duration{ 0 };
+		Ticks report_interval{ 5 * TICKS_PER_SECOND };
+	};
+
+	//Counts of what was done to the datagrams going one way.
+	struct Link_Stats
+	{
+		size_t received{ 0 };
+		size_t lost{ 0 };
+		size_t queue_drops{ 0 };
+		size_t duplicated{ 0 };
+		size_t reordered{ 0 };
+		size_t delivered{ 0 };
+		//Total time the delivered datagrams were held for, for the mean.
+		Ticks total_delay{ 0 };
+	};
+
+	/*
+		One direction of one client's path, to the server or back.
+	*/
+	struct Link
+	{
+		std::mt19937_64 rng{};
+		//Time the last datagram finishes going out at the link rate, the next one queues behind it.
+		Ticks time_link_free{ 0 };
+		//Latest delivery time so far, so jitter doesn't reorder datagrams (only --reorder does).
+		Ticks time_last_delivery{ 0 };
+		Link_Stats stats{};
+	};
+
+	struct Relay_Client
+	{
+		sockaddr_storage client_addr{};
+		//Socket the client's datagrams are sent to the server from, and the server's replies are read from.
+		SOCKET upstream_socket{ INVALID_SOCKET };
+		Link to_server{};
+		Link to_client{};
+	};
+
+	struct Scheduled_Datagram
+	{
+		Ticks delivery_time{};
+		//Order the datagrams were scheduled in, so ones due at the same time keep their order.
+		uint64_t order{};
+		Ticks arrival_time{};
+		SOCKET out_socket{};
+		sockaddr_storage addr_dest{};
+		std::string data{};
+		Link* link{};
+	};
+
+	struct Later_Delivery
+	{
+		bool operator()(const Scheduled_Datagram& lhs, const Scheduled_Datagram& rhs) const
+		{
+			if (lhs.delivery_time != rhs.delivery_time) return lhs.delivery_time > rhs.delivery_time;
+			return lhs.order > rhs.order;
+		}
+	};
+
+	typedef std::priority_queue<Scheduled_Datagram, std::vector<Scheduled_Datagram>, Later_Delivery> Delivery_Queue;
+
+	/*
+		\brief
+		Reads the options after the three arguments, returning false if an option is unknown or is missing its value.
+	*/
+	bool ReadOptions(int argc, char** argv, Impairment_Config& config)
+	{
+		for (int i = 4; i < argc; i += 2)
+		{
+			if (i + 1 >= argc) return false;
+			std::string option = argv[i];
+			double value = std::atof(argv[i + 1]);
+			if (option == "--latency") config.latency = static_cast<Ticks>(value * TICKS_PER_MILLISECOND);
+			else if (option == "--jitter") config.jitter = static_cast<Ticks>(value * TICKS_PER_MILLISECOND);
+			else if (option == "--loss") config.loss = value / 100;
+			else if (option == "--duplicate") config.duplicate = value / 100;
+			else if (option == "--reorder") config.reorder = value / 100;
+			else if (option == "--reorder-delay") config.reorder_delay = static_cast<Ticks>(value * TICKS_PER_MILLISECOND);
+			else if (option == "--bandwidth") config.bandwidth = value * 1000;
+			else if (option == "--queue") config.max_queue_delay = static_cast<Ticks>(value * TICKS_PER_MILLISECOND);
+			else if (option == "--seed") config.seed = std::strtoull(argv[i + 1], nullptr, 10);
+			else if (option == "--duration") config.duration = static_cast<Ticks>(value * TICKS_PER_SECOND);
+			else if (option == "--report") config.report_interval = static_cast<Ticks>(value * TICKS_PER_SECOND);
+			else return false;
+		}
+		return true;
+	}
+
+	/*
+		\brief
+		Seeds the link from the seed, the client and the direction.
+	*/
+	void SeedLink(Link& link, uint64_t seed, size_t client_index, int direction)
+	{
+		std::seed_seq seed_sequence{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+			static_cast<uint32_t>(client_index), static_cast<uint32_t>(direction) };
+		link.rng.seed(seed_sequence);
+	}
+
+	/*
+		\brief
+		Decides what happens to a datagram arriving on the link, scheduling each copy that gets through.
+		Every datagram takes the same number of random draws, whatever happens to it, so later decisions don't depend on earlier ones.
+	*/
+	void ImpairDatagram(Link& link, const Impairment_Config& config, Ticks current_time, const char* data, int length,
+		SOCKET out_socket, const sockaddr_storage& addr_dest, Delivery_Queue& deliveries, uint64_t& next_order)
+	{
+		std::uniform_real_distribution<double> chance{ 0.0, 1.0 };
+		double loss_roll = chance(link.rng);
+		double duplicate_roll = chance(link.rng);
+		double jitter_rolls[2]{ chance(link.rng), chance(link.rng) };
+		double reorder_rolls[2]{ chance(link.rng), chance(link.rng) };
+
+		link.stats.received++;
+		if (loss_roll < config.loss)
+		{
+			link.stats.lost++;
+			return;
+		}
+		//Goes out at the link rate once the datagrams in front have, or is dropped if the queue is too long.
+		Ticks time_sent = current_time;
+		if (config.bandwidth > 0)
+		{
+			Ticks time_start = (std::max)(current_time, link.time_link_free);
+			if (time_start - current_time > config.max_queue_delay)
+			{
+				link.stats.queue_drops++;
+				return;
+			}
+			link.time_link_free = time_start + static_cast<Ticks>(length * 8 * TICKS_PER_SECOND / config.bandwidth);
+			time_sent = link.time_link_free;
+		}
+
+		int copies = duplicate_roll < config.duplicate ? 2 : 1;
+		if (copies == 2) link.stats.duplicated++;
+		for (int copy = 0; copy < copies; copy++)
+		{
+			Ticks jitter = static_cast<Ticks>((jitter_rolls[copy] * 2 - 1) * config.jitter);
+			Ticks delivery_time = time_sent + (std::max)(config.latency + jitter, Ticks{ 0 });
+			if (reorder_rolls[copy] < config.reorder)
+			{
+				delivery_time += config.reorder_delay;
+				link.stats.reordered++;
+			}
+			else
+			{
+				delivery_time = (std::max)(delivery_time, link.time_last_delivery);
+				link.time_last_delivery = delivery_time;
+			}
+			deliveries.push(Scheduled_Datagram{ delivery_time, next_order++, current_time, out_socket, addr_dest, std::string(data, length), &link });
+		}
+	}
+
+	/*
+		\brief
+		Creates a non-blocking UDP socket bound to the port on every interface, 0 for any free port.
+	*/
+	SOCKET CreateSocket(unsigned short port)
+	{
+		SOCKET udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+		if (udp_socket == INVALID_SOCKET) return udp_socket;
+		sockaddr_in local{};
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(INADDR_ANY);
+		local.sin_port = htons(port);
+		if (bind(udp_socket, (sockaddr*)&local, sizeof(local)) == SOCKET_ERROR)
+		{
+			CloseSocket(udp_socket);
+			return INVALID_SOCKET;
+		}
+		SetNonBlocking(udp_socket);
+		return udp_socket;
+	}
+
+	void AddStats(Link_Stats& total, const Link_Stats& stats)
+	{
+		total.received += stats.received;
+		total.lost += stats.lost;
+		total.queue_drops += stats.queue_drops;
+		total.duplicated += stats.duplicated;
+		total.reordered += stats.reordered;
+		total.delivered += stats.delivered;
+		total.total_delay += stats.total_delay;
+	}
+
+	void PrintStats(const char* direction, const Link_Stats& stats)
+	{
+		double mean_delay = stats.delivered > 0 ? TicksToSeconds(stats.total_delay) * 1000 / stats.delivered : 0;
+		std::printf("  %-10s%10zu in%8zu lost%8zu queue drops%8zu duplicated%8zu reordered%10zu out%9.2f ms mean delay\n",
+			direction, stats.received, stats.lost, stats.queue_drops, stats.duplicated, stats.reordered, stats.delivered, mean_delay);
+	}
+
+	/*
+		\brief
+		Prints the totals of every client's links so far.
+	*/
+	void PrintReport(Ticks elapsed, const std::vector<Relay_Client>& clients)
+	{
+		Link_Stats to_server{}, to_client{};
+		for (const Relay_Client& client : clients)
+		{
+			AddStats(to_server, client.to_server.stats);
+			AddStats(to_client, client.to_client.stats);
+		}
+		std::printf("[%7.1f s] %zu clients\n", TicksToSeconds(elapsed), clients.size());
+		PrintStats("to server", to_server);
+		PrintStats("to client", to_client);
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Impairment_Config config{};
+	if (argc < 4 || !ReadOptions(argc, argv, config))
+	{
+		std::printf("Usage: %s <listen port> <server ip> <server port> [--latency ms] [--jitter ms] [--loss %%] [--duplicate %%]\n"
+			"       [--reorder %%] [--reorder-delay ms] [--bandwidth kbps] [--queue ms] [--seed n] [--duration s] [--report s]\n", argv[0]);
+		return 1;
+	}
+	if (StartupSockets() != NO_ERROR) return 1;
+
+	sockaddr_storage server_addr{};
+	sockaddr_in& server_addr_in = (sockaddr_in&)server_addr;
+	server_addr_in.sin_family = AF_INET;
+	server_addr_in.sin_port = htons(static_cast<unsigned short>(std::atoi(argv[3])));
+	if (inet_pton(AF_INET, argv[2], &server_addr_in.sin_addr) != 1)
+	{
+		std::printf("Invalid server ip: %s\n", argv[2]);
+		return 1;
+	}
+	SOCKET listen_socket = CreateSocket(static_cast<unsigned short>(std::atoi(argv[1])));
+	if (listen_socket == INVALID_SOCKET)
+	{
+		std::printf("Unable to bind port %s\n", argv[1]);
+		return 1;
+	}
+
+	std::vector<Relay_Client> clients{};
+	//Reserved up front, since the scheduled datagrams point to the links.
+	clients.reserve(MAX_RELAY_CLIENTS);
+	Address_Index client_index{};
+	//Listen socket first, then the upstream socket of each client, in the same order as clients.
+	std::vector<SOCKET> sockets{ listen_socket };
+	Delivery_Queue deliveries{};
+	uint64_t next_order = 0;
+	char buffer[MAX_BUFFER_SIZE];
+
+	Ticks start_time = GetMonotonicTime();
+	Ticks next_report_time = start_time + config.report_interval;
+	while (config.duration == 0 || GetMonotonicTime() - start_time < config.duration)
+	{
+		//Deliver everything that is due.
+		Ticks current_time = UpdateCachedTime();
+		while (!deliveries.empty() && deliveries.top().delivery_time <= current_time)
+		{
+			const Scheduled_Datagram& datagram = deliveries.top();
+			sendto(datagram.out_socket, datagram.data.data(), static_cast<int>(datagram.data.size()), 0,
+				(const sockaddr*)&datagram.addr_dest, GetSockAddrLength(datagram.addr_dest));
+			datagram.link->stats.delivered++;
+			datagram.link->stats.total_delay += current_time - datagram.arrival_time;
+			deliveries.pop();
+		}
+		if (current_time >= next_report_time)
+		{
+			PrintReport(current_time - start_time, clients);
+			next_report_time += config.report_interval;
+		}
+
+		//Sleep until the next delivery or report, or until a datagram arrives. Waits under a millisecond are spun.
+		Ticks next_wake_time = (std::min)(next_report_time, deliveries.empty() ? TICKS_NEVER : deliveries.top().delivery_time);
+		int timeout_ms = static_cast<int>((std::min)((next_wake_time - current_time) / TICKS_PER_MILLISECOND, Ticks{ 100 }));
+		if (!PollAnyReadable(sockets.data(), sockets.size(), timeout_ms)) continue;
+		current_time = UpdateCachedTime();
+
+		//From the clients, each new one getting its own socket towards the server.
+		while (true)
+		{
+			sockaddr_storage sender_addr{};
+			Socket_Length size_sockaddr = sizeof(sender_addr);
+			int bytes_read = static_cast<int>(recvfrom(listen_socket, buffer, MAX_BUFFER_SIZE, 0, (sockaddr*)&sender_addr, &size_sockaddr));
+			if (bytes_read == SOCKET_ERROR)
+			{
+				if (IsWouldBlockError(GetLastSocketError())) break;
+				continue;
+			}
+			int index = client_index.Find(sender_addr);
+			if (index == -1)
+			{
+				if (clients.size() == MAX_RELAY_CLIENTS) continue;
+				SOCKET upstream_socket = CreateSocket(0);
+				if (upstream_socket == INVALID_SOCKET) continue;
+				index = static_cast<int>(clients.size());
+				clients.push_back(Relay_Client{});
+				clients[index].client_addr = sender_addr;
+				clients[index].upstream_socket = upstream_socket;
+				SeedLink(clients[index].to_server, config.seed, index, 0);
+				SeedLink(clients[index].to_client, config.seed, index, 1);
+				client_index.Insert(sender_addr, index);
+				sockets.push_back(upstream_socket);
+			}
+			Relay_Client& client = clients[index];
+			ImpairDatagram(client.to_server, config, current_time, buffer, bytes_read, client.upstream_socket, server_addr, deliveries, next_order);
+		}
+
+		//From the server, back to the client each socket belongs to.
+		for (Relay_Client& client : clients)
+		{
+			while (true)
+			{
+				int bytes_read = static_cast<int>(recv(client.upstream_socket, buffer, MAX_BUFFER_SIZE, 0));
+				if (bytes_read == SOCKET_ERROR)
+				{
+					if (IsWouldBlockError(GetLastSocketError())) break;
+					continue;
+				}
+				ImpairDatagram(client.to_client, config, current_time, buffer, bytes_read, listen_socket, client.client_addr, deliveries, next_order);
+			}
+		}
+	}
+	PrintReport(GetMonotonicTime() - start_time, clients);
+
+	for (SOCKET relay_socket : sockets) CloseSocket(relay_socket);
+	CleanupSockets();
+	return 0;
+}
@@ -0,0 +1,108 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file IntegrityBenchmark.cpp
+\author Joel Lee Jie
+\date 15 October 2026
+\brief
+This file benchmarks the integrity modes (16 bit checksum, CRC32C and the 64 bit hash)
+against each other, in nanoseconds per byte across packet sizes up to MAX_BUFFER_SIZE.
+It first checks CRC32C against its standard check value, and the crc32 instruction against
+the table version, returning 1 if either doesn't match.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "../Utility.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+	struct Implementation
+	{
+		const char* name;
+		uint32_t(*calculate)(size_t, const void*);
+		bool is_supported;
+	};
+	uint32_t Sum16(size_t length_of_data, const void* data) { return CalculateIntegrity(INTEGRITY_SUM16, length_of_data, data); }
+	uint32_t Hash64(size_t length_of_data, const void* data) { return CalculateIntegrity(INTEGRITY_HASH64, length_of_data, data); }
+	const Implementation implementations[] = {
+		{ "sum16", Sum16, true },
+		{ "crc32c_hw", CalculateCRC32C, IsCRC32CHardwareSupported() },
+		{ "crc32c_sw", CalculateCRC32CSoftware, true },
+		{ "hash64", Hash64, true },
+	};
+
+	//Stops the compiler from optimising the benchmarked calls away.
+	volatile uint32_t sink{};
+}
+
+int main()
+{
+	//Check value of CRC32C, from the CRC catalogue.
+	const char check_input[] = "123456789";
+	if (CalculateCRC32CSoftware(9, check_input) != 0xE3069283 || CalculateCRC32C(9, check_input) != 0xE3069283)
+	{
+		std::printf("MISMATCH crc32c: check value\n");
+		return 1;
+	}
+
+	std::mt19937 rng{ 1130 };
+	//Extra bytes so the data can start at any offset, to check unaligned loads.
+	std::vector<uint8_t> data(MAX_BUFFER_SIZE + 64);
+	for (uint8_t& byte : data) byte = static_cast<uint8_t>(rng());
+
+	//The crc32 instruction has to give the same result as the tables, or the two sides could disagree.
+	for (size_t offset = 0; offset < 8; offset++)
+	{
+		for (size_t length = 0; length <= MAX_BUFFER_SIZE; length++)
+		{
+			uint32_t expected = CalculateCRC32CSoftware(length, data.data() + offset);
+			uint32_t result = CalculateCRC32C(length, data.data() + offset);
+			if (result != expected)
+			{
+				std::printf("MISMATCH crc32c: length %zu offset %zu, expected 0x%08X got 0x%08X\n", length, offset, expected, result);
+				return 1;
+			}
+		}
+	}
+	std::printf("CRC32C matches the check value%s.\n", IsCRC32CHardwareSupported() ? " with and without SSE4.2" : "");
+
+	/*
+		Time each mode for each packet size.
+	*/
+	const size_t sizes[] = { 16, 64, 256, 512, MAX_PACKET_SIZE, 1500, MAX_BUFFER_SIZE };
+	std::printf("%-10s", "bytes");
+	for (const Implementation& implementation : implementations) std::printf("%14s", implementation.name);
+	std::printf("   (ns per byte)\n");
+	for (size_t size : sizes)
+	{
+		std::printf("%-10zu", size);
+		//Roughly the same amount of data for every size, so small sizes still run long enough to measure.
+		size_t iterations = (std::max)(static_cast<size_t>(200000), static_cast<size_t>(200000000) / (size + 16));
+		for (const Implementation& implementation : implementations)
+		{
+			if (!implementation.is_supported)
+			{
+				std::printf("%14s", "n/a");
+				continue;
+			}
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < iterations; i++)
+			{
+				//Offset changes each time, so the work can't be hoisted out of the loop.
+				sink = implementation.calculate(size, data.data() + (i & 7));
+			}
+			auto end = std::chrono::steady_clock::now();
+			double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+			std::printf("%14.3f", nanoseconds / size);
+		}
+		std::printf("\n");
+	}
+	return 0;
+}
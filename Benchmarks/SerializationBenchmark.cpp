@@ -0,0 +1,354 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file SerializationBenchmark.cpp
+\author Joel Lee Jie
+\date 16 October 2026
+\brief
+This file benchmarks writing and reading a tick's world update, in messages per second.
+Each message has the transforms of every player, a few new bullets from each, new asteroids and destroyed asteroids.
+- stream: every field htonl()'d and written to a std::ostringstream, then read back with std::istream::read(),
+  as the server and client messages used to be (before).
+- bit stream: the same fields written with a Bit_Writer into a buffer kept between messages, then read back
+  with a Bit_Reader, with counts and IDs as varints, and positions, velocities, rotations and scales
+  quantized to fixed point like the game messages (after).
+Both read back what was written (the stream exactly, the bit stream rounded to its fixed point formats), which is checked,
+and the size of each message is printed too.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "../BitStream.hpp"
+#include "../Utility.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+namespace {
+	//Bullets fired by each player, new asteroids and destroyed asteroids in each message.
+	constexpr int BULLETS_PER_PLAYER = 4;
+	constexpr int ASTEROID_COUNT = 3;
+	constexpr int DESTRUCTION_COUNT = 4;
+	//Messages written and read for each player count.
+	constexpr int MESSAGE_COUNT = 20000;
+
+	//Floats in a transform, bullet and asteroid.
+	constexpr int TRANSFORM_FIELDS = 7, BULLET_FIELDS = 6, ASTEROID_FIELDS = 8;
+
+	//How the bit stream writes each field, as the game messages do.
+	enum Field_Format
+	{
+		FORMAT_FLOAT,
+		FORMAT_POSITION,
+		FORMAT_VELOCITY,
+		FORMAT_ACCELERATION,
+		FORMAT_ANGLE,
+		FORMAT_SCALE
+	};
+	constexpr Field_Format TRANSFORM_FORMATS[TRANSFORM_FIELDS] = { FORMAT_POSITION, FORMAT_POSITION, FORMAT_VELOCITY, FORMAT_VELOCITY,
+		FORMAT_ACCELERATION, FORMAT_ACCELERATION, FORMAT_ANGLE };
+	constexpr Field_Format BULLET_FORMATS[BULLET_FIELDS] = { FORMAT_POSITION, FORMAT_POSITION, FORMAT_VELOCITY, FORMAT_VELOCITY,
+		FORMAT_ANGLE, FORMAT_FLOAT };
+	constexpr Field_Format ASTEROID_FORMATS[ASTEROID_FIELDS] = { FORMAT_POSITION, FORMAT_POSITION, FORMAT_VELOCITY, FORMAT_VELOCITY,
+		FORMAT_ANGLE, FORMAT_SCALE, FORMAT_SCALE, FORMAT_FLOAT };
+	const Field_Format* const FIELD_FORMATS[] = { TRANSFORM_FORMATS, BULLET_FORMATS, ASTEROID_FORMATS };
+
+	const Quantization& GetQuantization(Field_Format format)
+	{
+		switch (format)
+		{
+		case FORMAT_POSITION: return POSITION_QUANTIZATION;
+		case FORMAT_VELOCITY: return VELOCITY_QUANTIZATION;
+		case FORMAT_ACCELERATION: return ACCELERATION_QUANTIZATION;
+		default: return SCALE_QUANTIZATION;
+		}
+	}
+	void WriteField(Bit_Writer& output, float value, Field_Format format)
+	{
+		if (format == FORMAT_FLOAT) output.WriteFloat(value);
+		else if (format == FORMAT_ANGLE) output.WriteAngle(value, ANGLE_BITS);
+		else output.WriteQuantized(value, GetQuantization(format));
+	}
+	float ReadField(Bit_Reader& input, Field_Format format)
+	{
+		if (format == FORMAT_FLOAT) return input.ReadFloat();
+		if (format == FORMAT_ANGLE) return input.ReadAngle(ANGLE_BITS);
+		return input.ReadQuantized(GetQuantization(format));
+	}
+	//The value ReadField() gets back for value.
+	float QuantizeField(float value, Field_Format format)
+	{
+		if (format == FORMAT_FLOAT) return value;
+		if (format == FORMAT_ANGLE) return DecodeAngle(EncodeAngle(value, ANGLE_BITS), ANGLE_BITS);
+		return Quantize(value, GetQuantization(format));
+	}
+
+	struct Entity
+	{
+		uint32_t id{};
+		//Transform, bullet or asteroid fields, all floats, the ones after its field count left 0.
+		float fields[ASTEROID_FIELDS]{};
+	};
+
+	struct World_Update
+	{
+		std::vector<Entity> transforms{}, bullets{}, asteroids{};
+		std::vector<uint32_t> destructions{};
+	};
+
+	World_Update MakeUpdate(int player_count)
+	{
+		World_Update update{};
+		uint32_t next_bullet_id = 1;
+		for (int p = 0; p < player_count; p++)
+		{
+			Entity transform{ static_cast<uint32_t>(p) };
+			for (int f = 0; f < TRANSFORM_FIELDS; f++) transform.fields[f] = p * 10.5f - f * 3.25f;
+			update.transforms.push_back(transform);
+			for (int b = 0; b < BULLETS_PER_PLAYER; b++)
+			{
+				Entity bullet{ next_bullet_id++ };
+				for (int f = 0; f < BULLET_FIELDS; f++) bullet.fields[f] = b * 7.75f + p - f;
+				update.bullets.push_back(bullet);
+			}
+		}
+		for (int a = 0; a < ASTEROID_COUNT; a++)
+		{
+			Entity asteroid{ static_cast<uint32_t>(500 + a) };
+			for (int f = 0; f < ASTEROID_FIELDS; f++) asteroid.fields[f] = a * -12.5f + f;
+			update.asteroids.push_back(asteroid);
+		}
+		for (int d = 0; d < DESTRUCTION_COUNT; d++) update.destructions.push_back(400 + d * 3);
+		return update;
+	}
+
+	void StreamWrite(std::ostream& output, uint32_t value, size_t size)
+	{
+		if (size == 2)
+		{
+			uint16_t net_value = htons(static_cast<uint16_t>(value));
+			output.write(reinterpret_cast<const char*>(&net_value), sizeof(net_value));
+			return;
+		}
+		uint32_t net_value = htonl(value);
+		output.write(reinterpret_cast<const char*>(&net_value), sizeof(net_value));
+	}
+	void StreamWriteFloat(std::ostream& output, float value)
+	{
+		uint32_t bits{};
+		std::memcpy(&bits, &value, sizeof(bits));
+		StreamWrite(output, bits, 4);
+	}
+	uint32_t StreamRead(std::istream& input, size_t size)
+	{
+		if (size == 2)
+		{
+			uint16_t net_value{};
+			input.read(reinterpret_cast<char*>(&net_value), sizeof(net_value));
+			return ntohs(net_value);
+		}
+		uint32_t net_value{};
+		input.read(reinterpret_cast<char*>(&net_value), sizeof(net_value));
+		return ntohl(net_value);
+	}
+	float StreamReadFloat(std::istream& input)
+	{
+		uint32_t bits = StreamRead(input, 4);
+		float value{};
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	/*
+		\brief
+		Writes the update as the server used to, [count, 2] then each entry's ID (4 bytes) and fields, one write() per field.
+	*/
+	std::string WriteWithStream(const World_Update& update)
+	{
+		std::ostringstream output(std::ios::binary);
+		const std::vector<Entity>* lists[] = { &update.transforms, &update.bullets, &update.asteroids };
+		const int field_counts[] = { TRANSFORM_FIELDS, BULLET_FIELDS, ASTEROID_FIELDS };
+		for (int list = 0; list < 3; list++)
+		{
+			StreamWrite(output, static_cast<uint32_t>(lists[list]->size()), 2);
+			for (const Entity& entity : *lists[list])
+			{
+				StreamWrite(output, entity.id, 4);
+				for (int f = 0; f < field_counts[list]; f++) StreamWriteFloat(output, entity.fields[f]);
+			}
+		}
+		StreamWrite(output, static_cast<uint32_t>(update.destructions.size()), 2);
+		for (uint32_t asteroid_id : update.destructions) StreamWrite(output, asteroid_id, 4);
+		return output.str();
+	}
+
+	World_Update ReadWithStream(const std::string& message)
+	{
+		World_Update update{};
+		std::istringstream input(message, std::ios::binary);
+		std::vector<Entity>* lists[] = { &update.transforms, &update.bullets, &update.asteroids };
+		const int field_counts[] = { TRANSFORM_FIELDS, BULLET_FIELDS, ASTEROID_FIELDS };
+		for (int list = 0; list < 3; list++)
+		{
+			uint32_t count = StreamRead(input, 2);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				Entity entity{ StreamRead(input, 4) };
+				for (int f = 0; f < field_counts[list]; f++) entity.fields[f] = StreamReadFloat(input);
+				lists[list]->push_back(entity);
+			}
+		}
+		uint32_t count = StreamRead(input, 2);
+		for (uint32_t i = 0; i < count; i++) update.destructions.push_back(StreamRead(input, 4));
+		return update;
+	}
+
+	//The update as the bit stream reads it back.
+	World_Update QuantizeUpdate(const World_Update& update)
+	{
+		World_Update quantized = update;
+		std::vector<Entity>* lists[] = { &quantized.transforms, &quantized.bullets, &quantized.asteroids };
+		const int field_counts[] = { TRANSFORM_FIELDS, BULLET_FIELDS, ASTEROID_FIELDS };
+		for (int list = 0; list < 3; list++)
+		{
+			for (Entity& entity : *lists[list])
+			{
+				for (int f = 0; f < field_counts[list]; f++) entity.fields[f] = QuantizeField(entity.fields[f], FIELD_FORMATS[list][f]);
+			}
+		}
+		return quantized;
+	}
+
+	/*
+		\brief
+		Writes the update with a Bit_Writer, with counts as varints, each list's IDs as zigzag varint differences
+		and fields in the formats of the game messages.
+		\return
+		Bytes written.
+	*/
+	size_t WriteWithBitStream(const World_Update& update, std::vector<char>& buffer)
+	{
+		Bit_Writer output{ buffer.data(), buffer.size() };
+		const std::vector<Entity>* lists[] = { &update.transforms, &update.bullets, &update.asteroids };
+		const int field_counts[] = { TRANSFORM_FIELDS, BULLET_FIELDS, ASTEROID_FIELDS };
+		for (int list = 0; list < 3; list++)
+		{
+			output.WriteVarUInt(static_cast<uint32_t>(lists[list]->size()));
+			uint32_t previous_id = 0;
+			for (const Entity& entity : *lists[list])
+			{
+				output.WriteVarInt(static_cast<int32_t>(entity.id - previous_id));
+				previous_id = entity.id;
+				for (int f = 0; f < field_counts[list]; f++) WriteField(output, entity.fields[f], FIELD_FORMATS[list][f]);
+			}
+		}
+		output.WriteVarUInt(static_cast<uint32_t>(update.destructions.size()));
+		for (uint32_t asteroid_id : update.destructions) output.WriteVarUInt(asteroid_id);
+		return output.HasOverflowed() ? 0 : output.GetBytesWritten();
+	}
+
+	World_Update ReadWithBitStream(const char* message, size_t size)
+	{
+		World_Update update{};
+		Bit_Reader input{ message, size };
+		std::vector<Entity>* lists[] = { &update.transforms, &update.bullets, &update.asteroids };
+		const int field_counts[] = { TRANSFORM_FIELDS, BULLET_FIELDS, ASTEROID_FIELDS };
+		for (int list = 0; list < 3; list++)
+		{
+			uint32_t count = input.ReadVarUInt();
+			uint32_t id = 0;
+			for (uint32_t i = 0; i < count && !input.HasFailed(); i++)
+			{
+				id += input.ReadVarInt();
+				Entity entity{ id };
+				for (int f = 0; f < field_counts[list]; f++) entity.fields[f] = ReadField(input, FIELD_FORMATS[list][f]);
+				lists[list]->push_back(entity);
+			}
+		}
+		uint32_t count = input.ReadVarUInt();
+		for (uint32_t i = 0; i < count && !input.HasFailed(); i++) update.destructions.push_back(input.ReadVarUInt());
+		return update;
+	}
+
+	bool IsSameUpdate(const World_Update& lhs, const World_Update& rhs)
+	{
+		const std::vector<Entity>* lhs_lists[] = { &lhs.transforms, &lhs.bullets, &lhs.asteroids };
+		const std::vector<Entity>* rhs_lists[] = { &rhs.transforms, &rhs.bullets, &rhs.asteroids };
+		for (int list = 0; list < 3; list++)
+		{
+			if (lhs_lists[list]->size() != rhs_lists[list]->size()) return false;
+			for (size_t i = 0; i < lhs_lists[list]->size(); i++)
+			{
+				const Entity& a = (*lhs_lists[list])[i];
+				const Entity& b = (*rhs_lists[list])[i];
+				if (a.id != b.id || std::memcmp(a.fields, b.fields, sizeof(a.fields)) != 0) return false;
+			}
+		}
+		return lhs.destructions == rhs.destructions;
+	}
+
+	/*
+		\brief
+		Times writing and reading MESSAGE_COUNT updates for player_count players with each method.
+		\return
+		Messages per second written and read, and bytes per message, for the stream (before) and bit stream (after).
+		false if either read back something different from what was written.
+	*/
+	bool RunTest(int player_count, double write_rate[2], double read_rate[2], size_t message_size[2])
+	{
+		World_Update update = MakeUpdate(player_count);
+		World_Update quantized_update = QuantizeUpdate(update);
+		//Large enough for every player count.
+		std::vector<char> buffer(64 * 1024);
+		bool is_matching = true;
+		double write_time[2]{}, read_time[2]{};
+		for (int message = 0; message < MESSAGE_COUNT; message++)
+		{
+			double start_time = TicksToSeconds(GetMonotonicTime());
+			std::string stream_message = WriteWithStream(update);
+			double written_time = TicksToSeconds(GetMonotonicTime());
+			World_Update stream_update = ReadWithStream(stream_message);
+			double read_done_time = TicksToSeconds(GetMonotonicTime());
+			write_time[0] += written_time - start_time;
+			read_time[0] += read_done_time - written_time;
+
+			start_time = TicksToSeconds(GetMonotonicTime());
+			size_t bit_size = WriteWithBitStream(update, buffer);
+			written_time = TicksToSeconds(GetMonotonicTime());
+			World_Update bit_update = ReadWithBitStream(buffer.data(), bit_size);
+			read_done_time = TicksToSeconds(GetMonotonicTime());
+			write_time[1] += written_time - start_time;
+			read_time[1] += read_done_time - written_time;
+
+			message_size[0] = stream_message.size();
+			message_size[1] = bit_size;
+			if (!IsSameUpdate(stream_update, update) || !IsSameUpdate(bit_update, quantized_update)) is_matching = false;
+		}
+		for (int method = 0; method < 2; method++)
+		{
+			write_rate[method] = MESSAGE_COUNT / write_time[method];
+			read_rate[method] = MESSAGE_COUNT / read_time[method];
+		}
+		return is_matching;
+	}
+}
+
+int main()
+{
+	std::printf("%-10s%14s%14s%14s%14s%14s%14s   (messages per second, bytes per message)\n",
+		"players", "write before", "write after", "read before", "read after", "bytes before", "bytes after");
+	const int player_counts[] = { 2, 8, 32 };
+	for (int player_count : player_counts)
+	{
+		double write_rate[2]{}, read_rate[2]{};
+		size_t message_size[2]{};
+		bool is_matching = RunTest(player_count, write_rate, read_rate, message_size);
+		std::printf("%-10d%14.0f%14.0f%14.0f%14.0f%14zu%14zu%s\n", player_count, write_rate[0], write_rate[1], read_rate[0], read_rate[1],
+			message_size[0], message_size[1], is_matching ? "" : "   (values differ)");
+	}
+	return 0;
+}
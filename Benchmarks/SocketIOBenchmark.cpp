@@ -0,0 +1,281 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file SocketIOBenchmark.cpp
+\author Joel Lee Jie
+\date 15 October 2026
+\brief
+This file benchmarks the server's socket threads on loopback, in round trips per second
+for 4, 16 and 64 simulated sessions.
+- before: one thread reads and writes the socket under socket_lock and queues packets under a mutex,
+  while the handling thread spins on the queue and writes its replies under socket_lock.
+- after: Datagram_IO, with a receiving thread, a handling thread and a single sending thread,
+  passing datagrams through lock-free rings.
+Every session keeps a few datagrams in flight, and the handling thread echoes each one back
+(like a JOIN_RESPONSE or standalone ACK).
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "../Utility.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+	//Datagrams each session keeps in flight.
+	constexpr int DATAGRAMS_IN_FLIGHT = 8;
+	//Size of each datagram, about the size of a player transform update.
+	constexpr int DATAGRAM_SIZE = 64;
+	//Threads acting as the players, each with its share of the sessions.
+	constexpr int PLAYER_THREAD_COUNT = 4;
+	//Time each test runs for.
+	constexpr double TEST_DURATION = 1.0;
+	//Time a session waits for its replies before assuming they were dropped.
+	constexpr double REPLY_TIMEOUT = 0.05;
+
+	/*
+		\brief
+		Creates a non-blocking UDP socket bound to a free loopback port, returning its address in addr.
+	*/
+	SOCKET CreateLoopbackSocket(sockaddr_storage& addr)
+	{
+		SOCKET udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+		sockaddr_in local{};
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		local.sin_port = 0;
+		bind(udp_socket, (sockaddr*)&local, sizeof(local));
+		Socket_Length size_sockaddr = sizeof(addr);
+		getsockname(udp_socket, (sockaddr*)&addr, &size_sockaddr);
+		SetNonBlocking(udp_socket);
+		return udp_socket;
+	}
+
+	/*
+		Server threads as they were before Datagram_IO.
+	*/
+	struct Locked_Server
+	{
+		SOCKET udp_socket{};
+		std::mutex socket_lock{};
+		std::mutex packet_queue_lock{};
+		std::queue<std::pair<sockaddr_storage, std::string>> packet_recv_queue{};
+		std::atomic<bool> is_running{ true };
+
+		void ReceiveSendMessages()
+		{
+			char buffer[MAX_BUFFER_SIZE]{};
+			while (is_running)
+			{
+				//Send burst at the top of the loop, which has nothing to send here but still takes the lock.
+				{
+					std::lock_guard<std::mutex> socket_locker{ socket_lock };
+				}
+				sockaddr_storage sender_addr{};
+				Socket_Length size_sockaddr = sizeof(sender_addr);
+				int bytes_read{};
+				{
+					std::lock_guard<std::mutex> socket_locker{ socket_lock };
+					bytes_read = (int)recvfrom(udp_socket, buffer, MAX_BUFFER_SIZE, 0, (sockaddr*)&sender_addr, &size_sockaddr);
+				}
+				if (bytes_read <= 0) continue;
+				std::lock_guard<std::mutex> packet_locker{ packet_queue_lock };
+				packet_recv_queue.push({ sender_addr, std::string(buffer, buffer + bytes_read) });
+			}
+		}
+
+		void HandleReceivedPackets()
+		{
+			while (is_running)
+			{
+				std::pair<sockaddr_storage, std::string> packet{};
+				{
+					std::lock_guard<std::mutex> packet_locker{ packet_queue_lock };
+					if (packet_recv_queue.empty()) continue;
+					packet = packet_recv_queue.front();
+					packet_recv_queue.pop();
+				}
+				std::lock_guard<std::mutex> socket_locker{ socket_lock };
+				WriteToSocket(udp_socket, packet.first, packet.second.data(), packet.second.size());
+			}
+		}
+	};
+
+	/*
+		Server threads with Datagram_IO.
+	*/
+	struct Split_Server
+	{
+		Datagram_IO socket_io{};
+		std::atomic<bool> is_running{ true };
+
+		void SendMessages()
+		{
+			while (is_running)
+			{
+				socket_io.WaitForQueuedSends(IDLE_WAIT_INTERVAL);
+				socket_io.FlushSends();
+			}
+		}
+
+		void ReceiveMessages()
+		{
+			while (is_running) socket_io.ReceiveDatagrams(IDLE_WAIT_INTERVAL);
+		}
+
+		void HandleReceivedPackets()
+		{
+			Queued_Datagram* datagrams[PACKET_BATCH_SIZE]{};
+			while (is_running)
+			{
+				if (!socket_io.received.WaitForDatagrams(IDLE_WAIT_INTERVAL)) continue;
+				size_t count = socket_io.received.PeekBatch(datagrams, PACKET_BATCH_SIZE);
+				for (size_t i = 0; i < count; i++) socket_io.QueueSend(datagrams[i]->addr, datagrams[i]->data, datagrams[i]->length, false);
+				socket_io.received.PopBatch(count);
+				socket_io.WakeSender();
+			}
+		}
+	};
+
+	/*
+		A simulated player, with its own socket.
+	*/
+	struct Session
+	{
+		SOCKET udp_socket{};
+		sockaddr_storage addr{};
+		int in_flight{};
+		double time_last_reply{};
+	};
+
+	/*
+		\brief
+		Keeps DATAGRAMS_IN_FLIGHT datagrams in flight for each session until the time is up.
+		\return
+		Number of replies received.
+	*/
+	size_t RunPlayers(std::vector<Session>& sessions, sockaddr_storage server_addr, double end_time)
+	{
+		char datagram[DATAGRAM_SIZE]{};
+		char buffer[MAX_BUFFER_SIZE]{};
+		size_t replies = 0;
+		double current_time = GetTime();
+		while (current_time < end_time)
+		{
+			for (Session& session : sessions)
+			{
+				//Replies that never came back were dropped, so stop waiting for them.
+				if (session.in_flight > 0 && current_time - session.time_last_reply > REPLY_TIMEOUT)
+				{
+					session.in_flight = 0;
+					session.time_last_reply = current_time;
+				}
+				while (session.in_flight < DATAGRAMS_IN_FLIGHT)
+				{
+					if (WriteToSocket(session.udp_socket, server_addr, datagram, DATAGRAM_SIZE) <= 0) break;
+					session.in_flight++;
+				}
+				while (recv(session.udp_socket, buffer, MAX_BUFFER_SIZE, 0) > 0)
+				{
+					replies++;
+					session.in_flight = (std::max)(session.in_flight - 1, 0);
+					session.time_last_reply = current_time;
+				}
+			}
+			//Sleep until a reply arrives instead of spinning, so the players don't take CPU time from the server threads.
+			fd_set read_set{};
+			FD_ZERO(&read_set);
+			SOCKET highest_socket{};
+			for (Session& session : sessions)
+			{
+				FD_SET(session.udp_socket, &read_set);
+				highest_socket = (std::max)(highest_socket, session.udp_socket);
+			}
+			timeval wait_time{ 0, 1000 };
+			//First argument is ignored by Winsock.
+			select(static_cast<int>(highest_socket) + 1, &read_set, nullptr, nullptr, &wait_time);
+			current_time = GetTime();
+		}
+		return replies;
+	}
+
+	/*
+		\brief
+		Runs the players against the server's socket for TEST_DURATION.
+		\return
+		Round trips per second.
+	*/
+	double RunTest(int session_count, const sockaddr_storage& server_addr)
+	{
+		std::vector<std::vector<Session>> player_sessions(PLAYER_THREAD_COUNT);
+		for (int i = 0; i < session_count; i++)
+		{
+			Session session{};
+			session.udp_socket = CreateLoopbackSocket(session.addr);
+			session.time_last_reply = GetTime();
+			player_sessions[i % PLAYER_THREAD_COUNT].push_back(session);
+		}
+		std::vector<size_t> replies(PLAYER_THREAD_COUNT);
+		std::vector<std::thread> player_threads{};
+		double end_time = GetTime() + TEST_DURATION;
+		for (int i = 0; i < PLAYER_THREAD_COUNT; i++)
+		{
+			player_threads.emplace_back([&, i]() { replies[i] = RunPlayers(player_sessions[i], server_addr, end_time); });
+		}
+		size_t total_replies = 0;
+		for (int i = 0; i < PLAYER_THREAD_COUNT; i++)
+		{
+			player_threads[i].join();
+			total_replies += replies[i];
+			for (Session& session : player_sessions[i]) CloseSocket(session.udp_socket);
+		}
+		return total_replies / TEST_DURATION;
+	}
+}
+
+int main()
+{
+	if (StartupSockets() != NO_ERROR) return 1;
+
+	const int session_counts[] = { 4, 16, 64 };
+	std::printf("%-10s%16s%16s   (round trips per second)\n", "sessions", "before", "after");
+	for (int session_count : session_counts)
+	{
+		double before{}, after{};
+		{
+			Locked_Server server{};
+			sockaddr_storage server_addr{};
+			server.udp_socket = CreateLoopbackSocket(server_addr);
+			std::thread io_thread([&]() { server.ReceiveSendMessages(); });
+			std::thread handling_thread([&]() { server.HandleReceivedPackets(); });
+			before = RunTest(session_count, server_addr);
+			server.is_running = false;
+			io_thread.join();
+			handling_thread.join();
+			CloseSocket(server.udp_socket);
+		}
+		{
+			Split_Server server{};
+			sockaddr_storage server_addr{};
+			SOCKET udp_socket = CreateLoopbackSocket(server_addr);
+			server.socket_io.Attach(udp_socket);
+			std::thread sending_thread([&]() { server.SendMessages(); });
+			std::thread receiving_thread([&]() { server.ReceiveMessages(); });
+			std::thread handling_thread([&]() { server.HandleReceivedPackets(); });
+			after = RunTest(session_count, server_addr);
+			server.is_running = false;
+			sending_thread.join();
+			receiving_thread.join();
+			handling_thread.join();
+			CloseSocket(udp_socket);
+		}
+		std::printf("%-10d%16.0f%16.0f\n", session_count, before, after);
+	}
+	CleanupSockets();
+	return 0;
+}
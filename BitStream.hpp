@@ -0,0 +1,267 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file BitStream.hpp
+\author Joel Lee Jie
+\date 16 October 2026
+\brief
+This file implements the bit-packed serializer the game messages are written and read with:
+Bit_Writer and Bit_Reader over a buffer the caller owns, with fields of any width from 1 to 32 bits,
+varints, zigzag encoding, and floats quantized to fixed point.
+Bits are packed most significant first, so byte-aligned 8, 16 and 32 bit fields are in network byte order.
+Everything is defined here, as it's called for every field of every message.
+It is used by both client and server.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#ifndef BITSTREAM_HPP
+#define BITSTREAM_HPP
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//Most bytes a varint of a 32 bit value takes, 7 bits in each.
+constexpr size_t MAX_VARINT_SIZE = 5;
+
+/*
+	\brief
+	Maps signed values to unsigned ones with the small magnitudes first (0, -1, 1, -2, 2... to 0, 1, 2, 3, 4...),
+	so small negative values also make short varints.
+*/
+inline uint32_t ZigZagEncode(int32_t value)
+{
+	return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+inline int32_t ZigZagDecode(uint32_t value)
+{
+	return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+/*
+	Fixed point format of a float: bit_count bits (1 to 32) spread evenly from min to max, both included.
+	Values outside are clamped to them.
+*/
+struct Quantization
+{
+	float min{}, max{};
+	int bit_count{};
+};
+
+/*
+	\brief
+	Converts value to the nearest of the 2^bit_count values of quantization (halfway rounds up), and back.
+	Worked out in double, which every platform rounds the same, so the server and client get the same values.
+	NaN is treated as min.
+*/
+uint32_t EncodeQuantized(float value, const Quantization& quantization);
+float DecodeQuantized(uint32_t code, const Quantization& quantization);
+//The value a reader gets back for value, for keeping the same value as the players who read it.
+inline float Quantize(float value, const Quantization& quantization)
+{
+	return DecodeQuantized(EncodeQuantized(value, quantization), quantization);
+}
+/*
+	\brief
+	Converts an angle in radians to the nearest of 2^bit_count steps around the circle (bit_count 1 to 31), and back.
+	Angles outside -PI to PI wrap around instead of being clamped. Decoded angles are from -PI up to (not including) PI.
+	Infinity and NaN are treated as 0.
+*/
+uint32_t EncodeAngle(float angle, int bit_count);
+float DecodeAngle(uint32_t code, int bit_count);
+
+/*
+	Writes fields into a buffer the caller owns, bit by bit.
+	Writing past the end of the buffer writes nothing more and marks the writer as overflowed, so a message
+	that didn't fit can be told apart from one that did, without checking every field.
+*/
+class Bit_Writer
+{
+public:
+	Bit_Writer(void* buffer, size_t capacity) : buffer{ static_cast<unsigned char*>(buffer) }, capacity{ capacity } {}
+
+	//Writes the low bit_count bits of value, bit_count from 1 to 32.
+	void WriteBits(uint32_t value, int bit_count);
+	void WriteBool(bool value) { WriteBits(value ? 1 : 0, 1); }
+	void WriteFloat(float value);
+	void WriteQuantized(float value, const Quantization& quantization) { WriteBits(EncodeQuantized(value, quantization), quantization.bit_count); }
+	void WriteAngle(float angle, int bit_count) { WriteBits(EncodeAngle(angle, bit_count), bit_count); }
+	/*
+		\brief
+		Writes value 7 bits at a time, low bits first, each group with a bit in front saying if another follows.
+		Takes 1 byte for values under 128, up to MAX_VARINT_SIZE.
+	*/
+	void WriteVarUInt(uint32_t value);
+	//Writes value zigzag encoded as a varint.
+	void WriteVarInt(int32_t value) { WriteVarUInt(ZigZagEncode(value)); }
+	//Pads with 0 bits to the start of the next byte.
+	void AlignToByte();
+
+	//Bytes written, including a partly written last byte.
+	size_t GetBytesWritten() const { return byte_count + (scratch_bits > 0 ? 1 : 0); }
+	bool HasOverflowed() const { return has_overflowed; }
+
+private:
+	unsigned char* buffer{};
+	size_t capacity{};
+	//Bytes completely written.
+	size_t byte_count{ 0 };
+	//Bits written after them (fewer than 8), in the low bits.
+	uint64_t scratch{ 0 };
+	int scratch_bits{ 0 };
+	bool has_overflowed{ false };
+};
+
+/*
+	Reads fields written by a Bit_Writer from a buffer the caller owns, in the same order and widths.
+	Reading past the end of the buffer (or a varint longer than MAX_VARINT_SIZE) returns 0 and marks the reader as failed,
+	so a truncated or malformed message only needs to be checked once, after reading it.
+*/
+class Bit_Reader
+{
+public:
+	Bit_Reader(const void* data, size_t size) : data{ static_cast<const unsigned char*>(data) }, size{ size } {}
+
+	//Reads bit_count bits, bit_count from 1 to 32.
+	uint32_t ReadBits(int bit_count);
+	bool ReadBool() { return ReadBits(1) != 0; }
+	float ReadFloat();
+	float ReadQuantized(const Quantization& quantization) { return DecodeQuantized(ReadBits(quantization.bit_count), quantization); }
+	float ReadAngle(int bit_count) { return DecodeAngle(ReadBits(bit_count), bit_count); }
+	uint32_t ReadVarUInt();
+	int32_t ReadVarInt() { return ZigZagDecode(ReadVarUInt()); }
+	//Skips to the start of the next byte.
+	void AlignToByte() { scratch_bits -= scratch_bits % 8; }
+
+	//Bytes not read at all yet, not counting a partly read byte.
+	size_t GetBytesLeft() const { return size - byte_count + static_cast<size_t>(scratch_bits / 8); }
+	bool HasFailed() const { return has_failed; }
+
+private:
+	const unsigned char* data{};
+	size_t size{};
+	//Bytes loaded into scratch.
+	size_t byte_count{ 0 };
+	//Bits loaded but not read yet, in the low bits.
+	uint64_t scratch{ 0 };
+	int scratch_bits{ 0 };
+	bool has_failed{ false };
+};
+
+inline uint32_t EncodeQuantized(float value, const Quantization& quantization)
+{
+	uint32_t max_code = 0xFFFFFFFFu >> (32 - quantization.bit_count);
+	double normalized = (static_cast<double>(value) - quantization.min) / (static_cast<double>(quantization.max) - quantization.min);
+	if (!(normalized > 0.0)) return 0;
+	if (normalized >= 1.0) return max_code;
+	return static_cast<uint32_t>(std::floor(normalized * max_code + 0.5));
+}
+
+inline float DecodeQuantized(uint32_t code, const Quantization& quantization)
+{
+	uint32_t max_code = 0xFFFFFFFFu >> (32 - quantization.bit_count);
+	double step = (static_cast<double>(quantization.max) - quantization.min) / max_code;
+	return static_cast<float>(quantization.min + code * step);
+}
+
+inline uint32_t EncodeAngle(float angle, int bit_count)
+{
+	if (!std::isfinite(angle)) return 0;
+	double turns = angle / 6.283185307179586;
+	turns -= std::floor(turns);
+	uint32_t step_count = 1u << bit_count;
+	//A turn that rounds up to a whole circle is 0.
+	return static_cast<uint32_t>(std::floor(turns * step_count + 0.5)) & (step_count - 1);
+}
+
+inline float DecodeAngle(uint32_t code, int bit_count)
+{
+	double turns = static_cast<double>(code) / (1u << bit_count);
+	if (turns >= 0.5) turns -= 1.0;
+	return static_cast<float>(turns * 6.283185307179586);
+}
+
+inline void Bit_Writer::WriteBits(uint32_t value, int bit_count)
+{
+	if (has_overflowed) return;
+	if ((byte_count * 8 + scratch_bits + bit_count + 7) / 8 > capacity)
+	{
+		has_overflowed = true;
+		return;
+	}
+	scratch = (scratch << bit_count) | (value & ((uint64_t{ 1 } << bit_count) - 1));
+	scratch_bits += bit_count;
+	while (scratch_bits >= 8)
+	{
+		scratch_bits -= 8;
+		buffer[byte_count++] = static_cast<unsigned char>(scratch >> scratch_bits);
+	}
+	//The partly written byte is kept in the buffer too, so the buffer is complete after every write.
+	if (scratch_bits > 0) buffer[byte_count] = static_cast<unsigned char>(scratch << (8 - scratch_bits));
+}
+
+inline void Bit_Writer::WriteFloat(float value)
+{
+	uint32_t bits{};
+	std::memcpy(&bits, &value, sizeof(bits));
+	WriteBits(bits, 32);
+}
+
+inline void Bit_Writer::WriteVarUInt(uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		WriteBits((value & 0x7F) | 0x80, 8);
+		value >>= 7;
+	}
+	WriteBits(value, 8);
+}
+
+inline void Bit_Writer::AlignToByte()
+{
+	if (scratch_bits > 0) WriteBits(0, 8 - scratch_bits);
+}
+
+inline uint32_t Bit_Reader::ReadBits(int bit_count)
+{
+	if (has_failed) return 0;
+	while (scratch_bits < bit_count)
+	{
+		if (byte_count == size)
+		{
+			has_failed = true;
+			return 0;
+		}
+		scratch = (scratch << 8) | data[byte_count++];
+		scratch_bits += 8;
+	}
+	scratch_bits -= bit_count;
+	return static_cast<uint32_t>((scratch >> scratch_bits) & ((uint64_t{ 1 } << bit_count) - 1));
+}
+
+inline float Bit_Reader::ReadFloat()
+{
+	uint32_t bits = ReadBits(32);
+	float value{};
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline uint32_t Bit_Reader::ReadVarUInt()
+{
+	uint32_t value = 0;
+	for (size_t i = 0; i < MAX_VARINT_SIZE; i++)
+	{
+		uint32_t group = ReadBits(8);
+		value |= (group & 0x7F) << (7 * i);
+		if ((group & 0x80) == 0) return value;
+	}
+	has_failed = true;
+	return 0;
+}
+
+#endif
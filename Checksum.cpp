@@ -15,6 +15,24 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 *******************************************************************/
 
 #include "Checksum.hpp"
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_HAS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+//MSVC allows AVX2 and SSE4.2 intrinsics in any function.
+#define CHECKSUM_TARGET_AVX2
+#define CHECKSUM_TARGET_SSE42
+#else
+#include <immintrin.h>
+//GCC/Clang only allow AVX2 and SSE4.2 intrinsics in functions compiled for them.
+#define CHECKSUM_TARGET_AVX2 __attribute__((target("avx2")))
+#define CHECKSUM_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
 
 /*
     \brief
@@ -23,38 +41,318 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 */
 uint16_t CalculateChecksum(size_t length_of_data, void* data) {
 
-    uint32_t checksum = 0; //checksum starts at 0
-  
-    //// If data length is odd, copy and pad with 0
-    //if (length_of_data % 2 == 1) {
-    //    ((uint8_t*)data)[length_of_data] = 0x00; // if the raw bytes is odd number, we add padding behind
-    //    length_of_data++; // as we add a new byte, we need to increase the length as well
-    //}
+    uint16_t result = ~CalculateChecksumSum(length_of_data, data);
+    return result; //in checksum, we need to return the one's complement
+
+}
+
+/*
+    \brief
+    Calculates the one's complement sum of the data (the checksum before it is complemented).
+    Uses the fastest implementation the CPU supports for the length, picked on the first call.
+*/
+uint16_t CalculateChecksumSum(size_t length_of_data, const void* data) {
+
+    static const ChecksumImplementation short_implementation = GetFastestChecksumImplementation(0);
+    static const ChecksumImplementation long_implementation = GetFastestChecksumImplementation(CHECKSUM_VECTOR_MIN_LENGTH);
+    return CalculateChecksumSumWith(length_of_data < CHECKSUM_VECTOR_MIN_LENGTH ? short_implementation : long_implementation, length_of_data, data);
+
+}
+
+namespace {
+
+    /*
+        \brief
+        Original implementation, reading each 16 bit word byte by byte.
+    */
+    uint16_t ChecksumSumBytewise(size_t length_of_data, const void* data) {
+
+        uint32_t checksum = 0; //checksum starts at 0
+        const uint8_t* buffer = static_cast<const uint8_t*>(data);
+
+        /*
+            Treat data as sequence of 16 bit integers, adding it up.
+        */
+        for (size_t i = 0; i + 1 < length_of_data; i += 2) {
+            uint16_t hex = (static_cast<uint16_t>(buffer[i]) << 8) | buffer[i + 1];
+            checksum += hex; //add the raw hex btyes (2 bytes)
+        }
+        //When data is odd numbered, then the last byte hasn't been considered yet.
+        //Pad with 0 and treat it as a 2 byte short.
+        if (length_of_data % 2 == 1)
+        {
+            uint16_t hex = (static_cast<uint16_t>(buffer[length_of_data - 1]) << 8) | 0x00;
+            checksum += hex;
+        }
+
+        //after adding carry the bit forward
+        while (checksum >> 16) {
+            checksum = (checksum & 0xFFFF) + (checksum >> 16);
+        }
+
+        return static_cast<uint16_t>(checksum);
+
+    }
+
+    /*
+        \brief
+        Folds a 64 bit one's complement sum down to 16 bits.
+    */
+    uint16_t FoldChecksum(uint64_t checksum) {
+
+        checksum = (checksum & 0xFFFFFFFF) + (checksum >> 32);
+        checksum = (checksum & 0xFFFFFFFF) + (checksum >> 32);
+        checksum = (checksum & 0xFFFF) + (checksum >> 16);
+        checksum = (checksum & 0xFFFF) + (checksum >> 16);
+        checksum = (checksum & 0xFFFF) + (checksum >> 16);
+        return static_cast<uint16_t>(checksum);
+
+    }
+
+    /*
+        \brief
+        Adds the data to checksum 8 bytes at a time, as 16 bit words in the CPU's byte order.
+        Carries out of the 64 bit sum are added back in, so nothing is lost.
+    */
+    uint64_t AddWords64(uint64_t checksum, size_t length_of_data, const uint8_t* buffer) {
+
+        size_t i = 0;
+        for (; i + 8 <= length_of_data; i += 8) {
+            uint64_t word{};
+            memcpy(&word, buffer + i, 8);
+            checksum += word;
+            if (checksum < word) checksum++; //carry the bit forward
+        }
+        //Remaining 0 to 7 bytes. Words can be added at any 16 bit position, as (1 << 16) is 1 in a one's complement sum.
+        uint64_t tail = 0;
+        if (length_of_data - i >= 4) {
+            uint32_t word{};
+            memcpy(&word, buffer + i, 4);
+            tail += word;
+            i += 4;
+        }
+        if (length_of_data - i >= 2) {
+            uint16_t word{};
+            memcpy(&word, buffer + i, 2);
+            tail += word;
+            i += 2;
+        }
+        if (i < length_of_data) {
+            //Padded with 0 at the end, same as a short last word.
+            uint16_t word{};
+            memcpy(&word, buffer + i, 1);
+            tail += word;
+        }
+        checksum += tail;
+        if (checksum < tail) checksum++;
+        return checksum;
+
+    }
+
+    /*
+        \brief
+        Converts a sum of 16 bit words in the CPU's byte order to a sum of big endian words.
+        Byte order doesn't matter to a one's complement sum, except that the result is byte swapped (RFC 1071).
+    */
+    uint16_t ToNetworkSum(uint16_t checksum) {
+
+        const uint16_t one = 1;
+        bool is_little_endian = *reinterpret_cast<const uint8_t*>(&one) == 1;
+        if (!is_little_endian) return checksum;
+        return static_cast<uint16_t>((checksum << 8) | (checksum >> 8));
+
+    }
+
+    /*
+        \brief
+        Portable implementation, reading 8 bytes at a time.
+    */
+    uint16_t ChecksumSumScalar64(size_t length_of_data, const void* data) {
+
+        uint64_t checksum = AddWords64(0, length_of_data, static_cast<const uint8_t*>(data));
+        return ToNetworkSum(FoldChecksum(checksum));
+
+    }
+
+#ifdef CHECKSUM_HAS_X86
+
+    /*
+        \brief
+        SSE2 implementation, widening 16 bytes at a time into 32 bit lanes.
+    */
+    uint16_t ChecksumSumSSE2(size_t length_of_data, const void* data) {
+
+        const uint8_t* buffer = static_cast<const uint8_t*>(data);
+        const __m128i zero = _mm_setzero_si128();
+        uint64_t checksum = 0;
+        size_t i = 0;
+        while (i + 16 <= length_of_data) {
+            //Each lane gains at most 2 words (0x1FFFE) per block, so sum at most 0x7FFF blocks before the lanes could overflow.
+            __m128i lanes = _mm_setzero_si128();
+            size_t block_end = i + 16 * (std::min)((length_of_data - i) / 16, static_cast<size_t>(0x7FFF));
+            for (; i < block_end; i += 16) {
+                __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + i));
+                lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(words, zero));
+                lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(words, zero));
+            }
+            alignas(16) uint32_t lane_values[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lane_values), lanes);
+            for (uint32_t lane_value : lane_values) checksum += lane_value;
+        }
+        //Remaining bytes, which start at an even offset so the words line up.
+        checksum = AddWords64(checksum, length_of_data - i, buffer + i);
+        return ToNetworkSum(FoldChecksum(checksum));
+
+    }
+
+    /*
+        \brief
+        AVX2 implementation, widening 32 bytes at a time into 32 bit lanes.
+    */
+    CHECKSUM_TARGET_AVX2 uint16_t ChecksumSumAVX2(size_t length_of_data, const void* data) {
+
+        const uint8_t* buffer = static_cast<const uint8_t*>(data);
+        const __m256i zero = _mm256_setzero_si256();
+        uint64_t checksum = 0;
+        size_t i = 0;
+        while (i + 32 <= length_of_data) {
+            //Each lane gains at most 2 words (0x1FFFE) per block, so sum at most 0x7FFF blocks before the lanes could overflow.
+            __m256i lanes = _mm256_setzero_si256();
+            size_t block_end = i + 32 * (std::min)((length_of_data - i) / 32, static_cast<size_t>(0x7FFF));
+            for (; i < block_end; i += 32) {
+                __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + i));
+                lanes = _mm256_add_epi32(lanes, _mm256_unpacklo_epi16(words, zero));
+                lanes = _mm256_add_epi32(lanes, _mm256_unpackhi_epi16(words, zero));
+            }
+            alignas(32) uint32_t lane_values[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lane_values), lanes);
+            for (uint32_t lane_value : lane_values) checksum += lane_value;
+        }
+        //Remaining bytes, which start at an even offset so the words line up.
+        checksum = AddWords64(checksum, length_of_data - i, buffer + i);
+        return ToNetworkSum(FoldChecksum(checksum));
 
-    uint8_t* buffer = static_cast<uint8_t*>(data); //initialise the raw data and cast it to 8 bits (1 byte) //we doing bytes by bytes & parse the raw data in bytes (updated)
+    }
 
     /*
-        Treat data as sequence of 16 bit integers, adding it up.
+        \brief
+        Checks if the CPU (and OS, for the AVX registers) supports AVX2.
     */
-    for (size_t i = 0; i + 1 < length_of_data; i += 2) {
-        uint16_t hex = (static_cast<uint16_t>(buffer[i]) << 8) | buffer[i + 1];
-        checksum += hex; //add the raw hex btyes (2 bytes)
+    bool IsAVX2Supported() {
+
+#ifdef _MSC_VER
+        int info[4]{};
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        bool has_osxsave = (info[2] & (1 << 27)) != 0;
+        bool has_avx = (info[2] & (1 << 28)) != 0;
+        if (!has_osxsave || !has_avx) return false;
+        //OS saves the AVX registers on a context switch.
+        if ((_xgetbv(0) & 0x6) != 0x6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+
     }
-    //When data is odd numbered, then the last byte hasn't been considered yet.
-    //Pad with 0 and treat it as a 2 byte short.
-    if (length_of_data % 2 == 1)
+
+#endif
+
+}
+
+/*
+    \brief
+    Checks if the implementation can be used on this CPU.
+*/
+bool IsChecksumImplementationSupported(ChecksumImplementation implementation) {
+
+    switch (implementation) {
+    case CHECKSUM_BYTEWISE:
+    case CHECKSUM_SCALAR_64:
+        return true;
+#ifdef CHECKSUM_HAS_X86
+    case CHECKSUM_SSE2:
+        return true; //Every x86-64 CPU has SSE2, and it's required by the build on x86.
+    case CHECKSUM_AVX2:
     {
-        uint16_t hex = (static_cast<uint16_t>(buffer[length_of_data-1]) << 8) | 0x00;
-        checksum += hex;
+        static const bool is_avx2_supported = IsAVX2Supported();
+        return is_avx2_supported;
+    }
+#endif
+    default:
+        return false;
+    }
+
+}
+
+/*
+    \brief
+    Returns the fastest implementation supported by this CPU, for data of the length.
+*/
+ChecksumImplementation GetFastestChecksumImplementation(size_t length_of_data) {
+
+    if (length_of_data < CHECKSUM_VECTOR_MIN_LENGTH) return CHECKSUM_SCALAR_64;
+    if (IsChecksumImplementationSupported(CHECKSUM_AVX2)) return CHECKSUM_AVX2;
+    if (IsChecksumImplementationSupported(CHECKSUM_SSE2)) return CHECKSUM_SSE2;
+    return CHECKSUM_SCALAR_64;
+
+}
+
+/*
+    \brief
+    Calculates the one's complement sum of the data with a specific implementation.
+    Falls back to the portable implementation if the CPU doesn't support it.
+*/
+uint16_t CalculateChecksumSumWith(ChecksumImplementation implementation, size_t length_of_data, const void* data) {
+
+    switch (implementation) {
+    case CHECKSUM_BYTEWISE:
+        return ChecksumSumBytewise(length_of_data, data);
+#ifdef CHECKSUM_HAS_X86
+    case CHECKSUM_SSE2:
+        return ChecksumSumSSE2(length_of_data, data);
+    case CHECKSUM_AVX2:
+        if (IsChecksumImplementationSupported(CHECKSUM_AVX2)) return ChecksumSumAVX2(length_of_data, data);
+        return ChecksumSumScalar64(length_of_data, data);
+#endif
+    default:
+        return ChecksumSumScalar64(length_of_data, data);
     }
 
+}
+
+/*
+    \brief
+    Adds the sum of the data that comes after (second_sum) to the sum of the data in front (first_sum).
+*/
+uint16_t AddChecksumSums(uint16_t first_sum, uint16_t second_sum, bool is_first_length_odd) {
+
+    //Byte order doesn't matter to a one's complement sum, so an offset sum only needs its bytes swapped (RFC 1071).
+    if (is_first_length_odd) second_sum = static_cast<uint16_t>((second_sum << 8) | (second_sum >> 8));
+    uint32_t checksum = static_cast<uint32_t>(first_sum) + second_sum;
     //after adding carry the bit forward
+    checksum = (checksum & 0xFFFF) + (checksum >> 16);
+    return static_cast<uint16_t>(checksum);
+
+}
+
+/*
+    \brief
+    Returns the new checksum after a 16 bit word of the data is changed from old_value to new_value (RFC 1624).
+*/
+uint16_t UpdateChecksum(uint16_t checksum_val, uint16_t old_value, uint16_t new_value) {
+
+    //HC' = ~(~HC + ~m + m'), which avoids the -0 problem of HC' = HC - ~m - m'.
+    uint32_t checksum = static_cast<uint16_t>(~checksum_val);
+    checksum += static_cast<uint16_t>(~old_value);
+    checksum += new_value;
     while (checksum >> 16) {
         checksum = (checksum & 0xFFFF) + (checksum >> 16);
     }
-
-    uint16_t result = ~checksum;
-    return result; //in checksum, we need to return the one's complement
+    return static_cast<uint16_t>(~checksum);
 
 }
 
@@ -79,4 +377,239 @@ bool ValidateChecksum(size_t length_of_data, void* data, uint16_t checksum_val)
         << " = 0x" << (sum & 0xFFFF) << std::endl;*/
 
     return (sum & 0xFFFF) == 0xFFFF;  // check whether they are equals to FFFF
-}
\ No newline at end of file
+}
+
+namespace {
+
+    //Reflected CRC32C (Castagnoli) polynomial.
+    constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+    /*
+        Lookup tables for slicing-by-8, built once.
+        tables[0] is the usual byte at a time table, and tables[k] is the CRC of a byte followed by k zero bytes.
+    */
+    struct CRC32C_Tables
+    {
+        uint32_t tables[8][256]{};
+        CRC32C_Tables() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+                tables[0][i] = crc;
+            }
+            for (int k = 1; k < 8; k++) {
+                for (uint32_t i = 0; i < 256; i++) {
+                    tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+                }
+            }
+        }
+    };
+
+    const CRC32C_Tables& GetCRC32CTables() {
+
+        static const CRC32C_Tables crc32c_tables{};
+        return crc32c_tables;
+
+    }
+
+    /*
+        \brief
+        Reads little endian words regardless of the CPU's byte order, so every CPU gets the same hash.
+    */
+    uint32_t ReadLittleEndian32(const uint8_t* buffer) {
+
+        return static_cast<uint32_t>(buffer[0]) | (static_cast<uint32_t>(buffer[1]) << 8)
+            | (static_cast<uint32_t>(buffer[2]) << 16) | (static_cast<uint32_t>(buffer[3]) << 24);
+
+    }
+
+    uint64_t ReadLittleEndian64(const uint8_t* buffer) {
+
+        return static_cast<uint64_t>(ReadLittleEndian32(buffer)) | (static_cast<uint64_t>(ReadLittleEndian32(buffer + 4)) << 32);
+
+    }
+
+    uint64_t RotateLeft(uint64_t value, int bits) {
+
+        return (value << bits) | (value >> (64 - bits));
+
+    }
+
+#ifdef CHECKSUM_HAS_X86
+
+    /*
+        \brief
+        CRC32C with the SSE4.2 crc32 instruction, 8 bytes at a time (4 on 32 bit).
+    */
+    CHECKSUM_TARGET_SSE42 uint32_t CRC32CHardware(size_t length_of_data, const void* data) {
+
+        const uint8_t* buffer = static_cast<const uint8_t*>(data);
+        size_t i = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+        uint64_t crc = 0xFFFFFFFF;
+        for (; i + 8 <= length_of_data; i += 8) {
+            uint64_t word{};
+            memcpy(&word, buffer + i, 8);
+            crc = _mm_crc32_u64(crc, word);
+        }
+        uint32_t crc32 = static_cast<uint32_t>(crc);
+#else
+        uint32_t crc32 = 0xFFFFFFFF;
+        for (; i + 4 <= length_of_data; i += 4) {
+            uint32_t word{};
+            memcpy(&word, buffer + i, 4);
+            crc32 = _mm_crc32_u32(crc32, word);
+        }
+#endif
+        for (; i < length_of_data; i++) crc32 = _mm_crc32_u8(crc32, buffer[i]);
+        return ~crc32;
+
+    }
+
+    /*
+        \brief
+        Checks if the CPU supports SSE4.2.
+    */
+    bool IsSSE42Supported() {
+
+#ifdef _MSC_VER
+        int info[4]{};
+        __cpuid(info, 1);
+        return (info[2] & (1 << 20)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+#endif
+
+    }
+
+#endif
+
+}
+
+/*
+    \brief
+    Calculates the CRC32C of the data 8 bytes at a time with lookup tables (slicing-by-8).
+*/
+uint32_t CalculateCRC32CSoftware(size_t length_of_data, const void* data) {
+
+    const uint32_t(&tables)[8][256] = GetCRC32CTables().tables;
+    const uint8_t* buffer = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFF;
+    size_t i = 0;
+    for (; i + 8 <= length_of_data; i += 8) {
+        uint32_t low = ReadLittleEndian32(buffer + i) ^ crc;
+        uint32_t high = ReadLittleEndian32(buffer + i + 4);
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24]
+            ^ tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^ tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+    }
+    //Remaining bytes, one at a time.
+    for (; i < length_of_data; i++) crc = tables[0][(crc ^ buffer[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+
+}
+
+/*
+    \brief
+    Checks if CalculateCRC32C uses the crc32 instruction.
+*/
+bool IsCRC32CHardwareSupported() {
+
+#ifdef CHECKSUM_HAS_X86
+    static const bool is_sse42_supported = IsSSE42Supported();
+    return is_sse42_supported;
+#else
+    return false;
+#endif
+
+}
+
+/*
+    \brief
+    Calculates the CRC32C of the data, with the crc32 instruction if the CPU supports it.
+*/
+uint32_t CalculateCRC32C(size_t length_of_data, const void* data) {
+
+#ifdef CHECKSUM_HAS_X86
+    if (IsCRC32CHardwareSupported()) return CRC32CHardware(length_of_data, data);
+#endif
+    return CalculateCRC32CSoftware(length_of_data, data);
+
+}
+
+/*
+    \brief
+    Calculates a fast 64 bit hash of the data, reading it 8 bytes at a time.
+    Each word is multiplied and rotated into the hash, then the bits are mixed at the end so every input bit affects the low 32 bits.
+*/
+uint64_t CalculateHash64(size_t length_of_data, const void* data) {
+
+    constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+    const uint8_t* buffer = static_cast<const uint8_t*>(data);
+    uint64_t hash = PRIME_5 + length_of_data;
+    size_t i = 0;
+    for (; i + 8 <= length_of_data; i += 8) {
+        uint64_t word = RotateLeft(ReadLittleEndian64(buffer + i) * PRIME_2, 31) * PRIME_1;
+        hash = RotateLeft(hash ^ word, 27) * PRIME_1 + PRIME_4;
+    }
+    if (i + 4 <= length_of_data) {
+        hash ^= static_cast<uint64_t>(ReadLittleEndian32(buffer + i)) * PRIME_1;
+        hash = RotateLeft(hash, 23) * PRIME_2 + PRIME_3;
+        i += 4;
+    }
+    for (; i < length_of_data; i++) {
+        hash ^= buffer[i] * PRIME_5;
+        hash = RotateLeft(hash, 11) * PRIME_1;
+    }
+
+    //Mix the bits, so a change anywhere in the data changes about half the bits of the hash.
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+
+}
+
+/*
+    \brief
+    Calculates the integrity value of the data with the given mode (the checksum for INTEGRITY_SUM16).
+*/
+uint32_t CalculateIntegrity(IntegrityMode mode, size_t length_of_data, const void* data) {
+
+    switch (mode) {
+    case INTEGRITY_CRC32C:
+        return CalculateCRC32C(length_of_data, data);
+    case INTEGRITY_HASH64:
+        return static_cast<uint32_t>(CalculateHash64(length_of_data, data)); //Truncated to the low 32 bits.
+    default:
+        return static_cast<uint16_t>(~CalculateChecksumSum(length_of_data, data));
+    }
+
+}
+
+/*
+    \brief
+    Validates the integrity value against the data passed in.
+*/
+bool ValidateIntegrity(IntegrityMode mode, size_t length_of_data, const void* data, uint32_t integrity_val) {
+
+    switch (mode) {
+    case INTEGRITY_SUM16:
+        //Only 16 bits are used, the rest should be 0.
+        if (integrity_val >> 16) return false;
+        return ValidateChecksum(length_of_data, const_cast<void*>(data), static_cast<uint16_t>(integrity_val));
+    case INTEGRITY_CRC32C:
+    case INTEGRITY_HASH64:
+        return CalculateIntegrity(mode, length_of_data, data) == integrity_val;
+    default:
+        return false;
+    }
+
+}
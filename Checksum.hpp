@@ -13,6 +13,8 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 */
 /* End Header
 *******************************************************************/
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
 #include <iostream>
 #include <cstdint>
 #include <cstddef>
@@ -29,4 +31,103 @@ uint16_t CalculateChecksum(size_t length_of_data, void* data);
     Validates checksum against data passed in.
     Returns true if successful, false if checksum fails.
 */
-bool ValidateChecksum(size_t length_of_data, void* data, uint16_t checksum_val);
\ No newline at end of file
+bool ValidateChecksum(size_t length_of_data, void* data, uint16_t checksum_val);
+/*
+    \brief
+    Calculates the one's complement sum of the data (the checksum before it is complemented).
+    Sums of separate pieces of data can be added with AddChecksumSums, instead of summing the whole data again.
+*/
+uint16_t CalculateChecksumSum(size_t length_of_data, const void* data);
+/*
+    Implementations of CalculateChecksumSum, which all give the same result.
+    CalculateChecksumSum picks the fastest one the CPU supports at runtime, for the length of the data.
+*/
+enum ChecksumImplementation
+{
+    CHECKSUM_BYTEWISE, //Original, 2 bytes at a time.
+    CHECKSUM_SCALAR_64, //Portable, 8 bytes at a time.
+    CHECKSUM_SSE2, //x86 only.
+    CHECKSUM_AVX2 //x86 only, if the CPU supports it.
+};
+/*
+    \brief
+    Checks if the implementation can be used on this CPU.
+*/
+bool IsChecksumImplementationSupported(ChecksumImplementation implementation);
+/*
+    Data shorter than this is summed with CHECKSUM_SCALAR_64 even if the CPU has AVX2 or SSE2,
+    as setting up the vector loop costs more than it saves (measured with ChecksumBenchmark, where they break even).
+*/
+constexpr size_t CHECKSUM_VECTOR_MIN_LENGTH = 96;
+/*
+    \brief
+    Returns the fastest implementation supported by this CPU, for data of the length.
+*/
+ChecksumImplementation GetFastestChecksumImplementation(size_t length_of_data);
+/*
+    \brief
+    Calculates the one's complement sum of the data with a specific implementation (e.g. for benchmarking).
+    Falls back to the portable implementation if the CPU doesn't support it.
+*/
+uint16_t CalculateChecksumSumWith(ChecksumImplementation implementation, size_t length_of_data, const void* data);
+/*
+    \brief
+    Adds the sum of the data that comes after (second_sum) to the sum of the data in front (first_sum).
+    If the data in front is odd in length, the bytes of second_sum are swapped, as its 16 bit words are offset by a byte.
+*/
+uint16_t AddChecksumSums(uint16_t first_sum, uint16_t second_sum, bool is_first_length_odd);
+/*
+    \brief
+    Returns the new checksum after a 16 bit word of the data is changed from old_value to new_value (RFC 1624).
+    The rest of the data doesn't need to be summed again.
+*/
+uint16_t UpdateChecksum(uint16_t checksum_val, uint16_t old_value, uint16_t new_value);
+
+/*
+    Algorithms that can be used to check a datagram for corruption, negotiated per session at JOIN.
+    The 16 bit sum misses swapped 16 bit words and many multi-bit errors, so the stronger ones are preferred.
+*/
+enum IntegrityMode : uint8_t
+{
+    INTEGRITY_SUM16 = 0, //16 bit one's complement sum (the original checksum). Used until a mode is negotiated.
+    INTEGRITY_CRC32C = 1, //CRC32C, using the SSE4.2 crc32 instruction if the CPU supports it.
+    INTEGRITY_HASH64 = 2, //64 bit hash, truncated to 32 bits.
+    INTEGRITY_MODE_COUNT
+};
+//Bitmask of every mode supported (bit i is IntegrityMode i), sent in JOIN_REQUEST.
+constexpr uint8_t SUPPORTED_INTEGRITY_MODES = (1 << INTEGRITY_SUM16) | (1 << INTEGRITY_CRC32C) | (1 << INTEGRITY_HASH64);
+
+/*
+    \brief
+    Calculates the CRC32C (Castagnoli) of the data.
+    Uses the SSE4.2 crc32 instruction if the CPU supports it, otherwise CalculateCRC32CSoftware.
+*/
+uint32_t CalculateCRC32C(size_t length_of_data, const void* data);
+/*
+    \brief
+    Calculates the CRC32C of the data 8 bytes at a time with lookup tables (slicing-by-8), for CPUs without SSE4.2.
+*/
+uint32_t CalculateCRC32CSoftware(size_t length_of_data, const void* data);
+/*
+    \brief
+    Checks if CalculateCRC32C uses the crc32 instruction.
+*/
+bool IsCRC32CHardwareSupported();
+/*
+    \brief
+    Calculates a fast 64 bit hash of the data, reading it 8 bytes at a time.
+*/
+uint64_t CalculateHash64(size_t length_of_data, const void* data);
+/*
+    \brief
+    Calculates the integrity value of the data with the given mode (the checksum for INTEGRITY_SUM16).
+*/
+uint32_t CalculateIntegrity(IntegrityMode mode, size_t length_of_data, const void* data);
+/*
+    \brief
+    Validates the integrity value against the data passed in.
+    Returns true if successful, false if the check fails or the mode isn't supported.
+*/
+bool ValidateIntegrity(IntegrityMode mode, size_t length_of_data, const void* data, uint32_t integrity_val);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file Platform.cpp
+\author Joel Lee Jie
+\date 15 October 2026
+\brief
+This file implements the thin socket layer over Winsock (Windows) and BSD sockets (Linux and others).
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "Platform.hpp"
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+#ifdef _WIN32
+
+/*
+	\brief
+	Starts up Winsock, asking for version 2.2.
+*/
+int StartupSockets()
+{
+	// This object holds the information about the version of Winsock that we
+	// are using, which is not necessarily the version that we requested.
+	WSADATA wsaData{};
+	return WSAStartup(MAKEWORD(2, 2), &wsaData);
+}
+
+void CleanupSockets()
+{
+	WSACleanup();
+}
+
+void CloseSocket(SOCKET socket_to_close)
+{
+	closesocket(socket_to_close);
+}
+
+bool SetNonBlocking(SOCKET socket_to_set)
+{
+	u_long enable = 1;
+	return ioctlsocket(socket_to_set, FIONBIO, &enable) == NO_ERROR;
+}
+
+/*
+	\brief
+	SO_REUSEADDR on Winsock lets a second socket take over the port instead of sharing it, so sharding isn't supported.
+*/
+bool SetReusePort(SOCKET)
+{
+	return false;
+}
+
+int GetLastSocketError()
+{
+	return WSAGetLastError();
+}
+
+bool IsWouldBlockError(int error_code)
+{
+	return error_code == WSAEWOULDBLOCK;
+}
+
+bool IsShutdownError(int error_code)
+{
+	return error_code == WSAESHUTDOWN;
+}
+
+bool PollReadable(SOCKET socket_to_poll, int timeout_ms)
+{
+	WSAPOLLFD poll_fd{};
+	poll_fd.fd = socket_to_poll;
+	poll_fd.events = POLLRDNORM;
+	return WSAPoll(&poll_fd, 1, timeout_ms) > 0;
+}
+
+bool PollAnyReadable(const SOCKET* sockets_to_poll, size_t count, int timeout_ms)
+{
+	std::vector<WSAPOLLFD> poll_fds(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		poll_fds[i].fd = sockets_to_poll[i];
+		poll_fds[i].events = POLLRDNORM;
+	}
+	return WSAPoll(poll_fds.data(), static_cast<ULONG>(count), timeout_ms) > 0;
+}
+
+#else
+
+/*
+	\brief
+	Copies count bytes if they fit in dest, otherwise clears dest like the MSVC version.
+*/
+int memcpy_s(void* dest, size_t dest_size, const void* src, size_t count)
+{
+	if (count == 0) return 0;
+	if (dest == nullptr) return EINVAL;
+	if (src == nullptr || count > dest_size)
+	{
+		memset(dest, 0, dest_size);
+		return src == nullptr ? EINVAL : ERANGE;
+	}
+	memcpy(dest, src, count);
+	return 0;
+}
+
+/*
+	\brief
+	BSD sockets need no start up.
+*/
+int StartupSockets()
+{
+	return 0;
+}
+
+void CleanupSockets()
+{
+}
+
+void CloseSocket(SOCKET socket_to_close)
+{
+	close(socket_to_close);
+}
+
+bool SetNonBlocking(SOCKET socket_to_set)
+{
+	int flags = fcntl(socket_to_set, F_GETFL, 0);
+	if (flags == -1) return false;
+	return fcntl(socket_to_set, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+bool SetReusePort(SOCKET socket_to_set)
+{
+#ifdef SO_REUSEPORT
+	int enable = 1;
+	return setsockopt(socket_to_set, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == 0;
+#else
+	return false;
+#endif
+}
+
+int GetLastSocketError()
+{
+	return errno;
+}
+
+bool IsWouldBlockError(int error_code)
+{
+	return error_code == EWOULDBLOCK || error_code == EAGAIN;
+}
+
+bool IsShutdownError(int error_code)
+{
+	return error_code == ESHUTDOWN || error_code == EPIPE;
+}
+
+bool PollReadable(SOCKET socket_to_poll, int timeout_ms)
+{
+	pollfd poll_fd{};
+	poll_fd.fd = socket_to_poll;
+	poll_fd.events = POLLIN;
+	return poll(&poll_fd, 1, timeout_ms) > 0;
+}
+
+bool PollAnyReadable(const SOCKET* sockets_to_poll, size_t count, int timeout_ms)
+{
+	std::vector<pollfd> poll_fds(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		poll_fds[i].fd = sockets_to_poll[i];
+		poll_fds[i].events = POLLIN;
+	}
+	return poll(poll_fds.data(), static_cast<nfds_t>(count), timeout_ms) > 0;
+}
+
+#endif
+
+/*
+	\brief
+	Returns the size of the IPv4 or IPv6 address, or the whole storage for other families.
+*/
+Socket_Length GetSockAddrLength(const sockaddr_storage& addr)
+{
+	if (addr.ss_family == AF_INET) return static_cast<Socket_Length>(sizeof(sockaddr_in));
+	if (addr.ss_family == AF_INET6) return static_cast<Socket_Length>(sizeof(sockaddr_in6));
+	return static_cast<Socket_Length>(sizeof(sockaddr_storage));
+}
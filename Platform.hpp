@@ -0,0 +1,140 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file Platform.hpp
+\author Joel Lee Jie
+\date 15 October 2026
+\brief
+This file declares the thin socket layer over Winsock (Windows) and BSD sockets (Linux and others),
+so the networking code can be built on either.
+On BSD sockets it also provides the Winsock names the code uses (SOCKET, INVALID_SOCKET, SOCKET_ERROR)
+and memcpy_s.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#ifndef PLATFORM_HPP
+#define PLATFORM_HPP
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+// Tell the Visual Studio linker to include Winsock.
+#pragma comment(lib, "ws2_32.lib")
+
+//Length of a socket address, as recvfrom() and getsockname() take it.
+typedef int Socket_Length;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+typedef int SOCKET;
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+#ifndef NO_ERROR
+constexpr int NO_ERROR = 0;
+#endif
+//Length of a socket address, as recvfrom() and getsockname() take it.
+typedef socklen_t Socket_Length;
+
+/*
+	\brief
+	Copies count bytes, like the MSVC version, failing (without copying) if they don't fit in dest.
+	\return
+	0 on success, EINVAL or ERANGE on failure.
+*/
+int memcpy_s(void* dest, size_t dest_size, const void* src, size_t count);
+#endif
+
+/*
+	\brief
+	Starts up the socket library (WSAStartup() for Winsock 2.2, nothing on BSD sockets).
+	\return
+	0 on success, otherwise the error code.
+*/
+int StartupSockets();
+
+/*
+	\brief
+	Releases the socket library, once for every successful StartupSockets().
+*/
+void CleanupSockets();
+
+/*
+	\brief
+	Closes the socket.
+*/
+void CloseSocket(SOCKET socket_to_close);
+
+/*
+	\brief
+	Makes reads and writes on the socket return straight away instead of waiting.
+	\return
+	true on success.
+*/
+bool SetNonBlocking(SOCKET socket_to_set);
+
+/*
+	\brief
+	Lets several sockets bind to the same port (SO_REUSEPORT), with the kernel spreading incoming datagrams between them
+	by source address, so each sender always reaches the same socket. Must be called before bind().
+	\return
+	false if the platform can't (Winsock has no equivalent), in which case only one socket can bind the port.
+*/
+bool SetReusePort(SOCKET socket_to_set);
+
+/*
+	\brief
+	Returns the error code of the last socket call on this thread (WSAGetLastError() or errno).
+*/
+int GetLastSocketError();
+
+/*
+	\brief
+	Returns true if the error means a non-blocking call had nothing to do (e.g. nothing to read), rather than a failure.
+*/
+bool IsWouldBlockError(int error_code);
+
+/*
+	\brief
+	Returns true if the error means the socket has been shut down.
+*/
+bool IsShutdownError(int error_code);
+
+/*
+	\brief
+	Sleeps up to timeout_ms (-1 to wait forever) until the socket has data to read, with poll() (WSAPoll() on Winsock).
+	\return
+	true if the socket is readable.
+*/
+bool PollReadable(SOCKET socket_to_poll, int timeout_ms);
+
+/*
+	\brief
+	Sleeps up to timeout_ms (-1 to wait forever) until any of the count sockets has data to read.
+	\return
+	true if at least one socket is readable.
+*/
+bool PollAnyReadable(const SOCKET* sockets_to_poll, size_t count, int timeout_ms);
+
+/*
+	\brief
+	Returns the length of the address for its family, for sendto().
+	Some BSD socket implementations reject sizeof(sockaddr_storage).
+*/
+Socket_Length GetSockAddrLength(const sockaddr_storage& addr);
+
+#endif
@@ -29,18 +29,7 @@ prior written consent of DigiPen Institute of Technology is prohibited.
  ******************************************************************************/
 
 
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-
-#include "Windows.h"		// Entire Win32 API...
- // #include "winsock2.h"	// ...or Winsock alone
-#include "ws2tcpip.h"		// getaddrinfo()
-
-// Tell the Visual Studio linker to include the following library in linking.
-// Alternatively, we could add this file to the linker command-line parameters,
-// but including it in the source code simplifies the configuration.
-#pragma comment(lib, "ws2_32.lib")
+#include "../Platform.hpp"	// Winsock or BSD sockets, getaddrinfo()
 
 #include <iostream>			// cout, cerr
 #include <string>			// string
@@ -51,13 +40,23 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 #include <filesystem>
 #include "taskqueue.h"	
 
-#include "..\Utility.hpp"
+#include "../Utility.hpp"
+#include "../Simulation.hpp" //World_Simulation, which decides who hit which asteroid.
+#include "../BitStream.hpp" //Bit_Writer and Bit_Reader, which the game messages are written and read with.
 #include <filesystem> //For file operations.
 #include <chrono> //for timeout timer.
+#include <limits> //for the send deadline when nothing is pending.
 #include <thread> //to create a separate thread for file downloader.
 #include <fstream>
+#include <algorithm> //std::clamp for bullet ages.
+#include <iomanip> //std::setprecision for the tick report.
+#include <charconv> //std::from_chars for Config.txt values.
+#include <atomic> //player_id, handed out by every shard's handling thread.
 
 // -------------------------------------------------Global definitions--------------------------------------------------
+// Defined with the other globals below, used by Player_Session to wake the sending thread of its shard.
+extern std::vector<std::unique_ptr<Datagram_IO>> socket_shards;
+
 /*
 	Represents a player session, where communications with the player is controlled through this.
 	Each player has their own session (and only one session).
@@ -68,69 +67,232 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 struct Player_Session
 {
 public:
-	Player_Session(sockaddr_storage addr)
-		: addrDest{ addr }
+	Player_Session(int id, sockaddr_storage addr, size_t shard_index = 0)
+		: player_ID{ id }, addrDest{ addr }, shard{ shard_index }
 	{
 	}
 
+	/*
+		Splits a message into fragments that fit within MAX_PAYLOAD_SIZE, each tagged with the message ID, its index and the fragment count.
+	*/
 	void SendLongMessage(const std::string& message)
+	{
+		FragmentMessage(message, std::string{}, next_message_id++, messages_to_send);
+		MarkSendPending();
+		socket_shards[shard]->WakeSender();
+	}
+	/*
+		Sends the message on the sequenced channel, replacing any sequenced message that hasn't been sent yet.
+		Only for state where the latest copy is all that matters, as it isn't resent if lost.
+		Messages too large for one packet are sent reliably instead.
+	*/
+	void SendSequencedMessage(const std::string& message)
 	{
 		if (message.empty()) return;
-		std::string long_message = message;
-		while (true)
+		if (message.size() > MAX_PAYLOAD_SIZE - SEQUENCED_MESSAGE_HEADER_SIZE)
 		{
-			//The last part of the message, add COMMAND_COMPLETE to indicate it is complete.
-			if (long_message.size() <= MAX_PAYLOAD_SIZE - 1)
-			{
-				long_message = (char)(COMMAND_COMPLETE)+long_message;
-				//String length is less than or equal to max payload size, so just push it all as one packet.
-				messages_to_send.push(long_message);
-				reliable_transfer.toSend = true;
-				return; //All parts of the message have been sent.
-			}
-			else
-			{
-				//Add incomplete, to show that there are more packets on the way.
-				long_message = (char)(COMMAND_INCOMPLETE)+long_message;
-				//Can only send MAX_PAYLOAD_SIZE for each packet, as 6 extra bytes are left for seq number and checksum.
-				messages_to_send.push(long_message.substr(0, MAX_PAYLOAD_SIZE));
-				//Move to the next chunk of the message.
-				long_message = long_message.substr(MAX_PAYLOAD_SIZE);
-			}
-
+			SendLongMessage(message);
+			return;
 		}
+		sequenced_message_to_send = message;
+		MarkSendPending();
+		socket_shards[shard]->WakeSender();
 	}
+	/*
+		Lists the session for the sending thread of its shard to visit on its next pass, unless it's already listed.
+		Called (with the lock of its shard held) whenever there may be something new to send. Doesn't wake the sending thread.
+	*/
+	void MarkSendPending();
+	/*
+		Current round trip time estimates of the session, in ticks.
+		Smoothed RTT is -1 until the player has ACK'd a packet.
+	*/
+	Ticks GetSmoothedRTT() const { return reliable_transfer.smoothed_rtt; }
+	Ticks GetRTTVariance() const { return reliable_transfer.rtt_variance; }
+	Ticks GetRetransmissionTimeout() const { return reliable_transfer.retransmission_timeout; }
+
 	//Used to control reliable data transfer.
 	Reliable_Transfer reliable_transfer{};
-	//Used to determine if a player should be forcibly disconnected, like after X seconds of no response.
-	double time_last_packet_received{ 20000000000000 };
-
+	//Used to control sequenced (unreliable) data transfer, for player transforms.
+	Sequenced_Transfer sequenced_transfer{};
+	//Puts the fragments of long messages from the player back together.
+	Message_Reassembler reassembler{};
+	//ID to give the next long message sent, so the player can tell which fragments belong together.
+	uint16_t next_message_id{ 0 };
+	//Offset and drift of the player's clock, so the timestamps they send can be compared with other players'.
+	Clock_Sync clock_sync{};
+	//Used to determine if a player should be forcibly disconnected, like after X seconds of no response. Set from their JOIN_REQUEST on.
+	Ticks time_last_packet_received{ TICKS_NEVER };
+
+	//ID given to the player in the JOIN_RESPONSE, which they put in front of every message.
+	int player_ID{ -1 };
 	//Used to indicate how to send. Need to set when recvfrom is called.
 	sockaddr_storage addrDest{};
-
-	/*
-		Indicates if the message stored in recv_buffer is complete.
-		Set to false at the start of the frame, and if the packets received from the player come with "COMMAND_INCOMPLETE".
-		Set to true when the last command packet from the player "COMMAND_COMPLETE" is received.
-	*/
-	bool is_recv_message_complete = false;
-	//Stores messages received from player, cleared at the end of each frame.
-	//Only stores "COMMAND" type messages, so it doesn't store ACK or JOIN_REQUEST messages.
-	std::string recv_buffer{};
+	//Socket shard that received the player's JOIN_REQUEST. Everything to the player is written by that shard's sending thread.
+	size_t shard{ 0 };
+	//Listed in the sessions_to_send of its shard, or has a send timer that fired, waiting for the sending thread.
+	bool is_send_pending{ false };
+	//Deadline of the session's latest timer in the send_timers of its shard, TICKS_NEVER if none. Older timers for the session are ignored.
+	Ticks scheduled_send_time{ TICKS_NEVER };
 
 	/*
 		Each string in the vector signifies a packet to send.
-		Packets are sent in order (FCFS).
-		Only one packet is sent at a time. The next packet can only be sent when the first packet has been ACK'd.
+		Packets enter the send window in order (FCFS), up to SEND_WINDOW_SIZE packets can be in flight at once.
 		Don't include checksum or seq number as they will be automatically added.
 
-		Each string contains [GeneralCommandID] as the first byte, indicating the type of packet it is (Either COMMAND_INCOMPLETE or COMMAND_COMPLETE).
+		Each string contains [GeneralCommandID] as the first byte, indicating the type of packet it is (Either COMMAND_INCOMPLETE or COMMAND_COMPLETE),
+		followed by the fragment header.
 		ACK and JOIN_RESPONSE aren't sent this way, as they only need to be sent once without needing to be ACK'd.
 		Ensure packets confirm to MAX_PAYLOAD_SIZE (not MAX_PACKET_SIZE).
 	*/
 	std::queue<std::string> messages_to_send{};
+	/*
+		Latest message to send on the sequenced channel, sent once then cleared.
+		Excludes [COMMAND_SEQUENCED] and the sequence number, as they will be automatically added.
+	*/
+	std::string sequenced_message_to_send{};
 };
 
+/*
+	Every player session, stored so that finding a player's session is O(1) however many players there are.
+	- Sessions are packed in one array without gaps, so passes over every session walk straight through memory.
+	- slot_of_player maps a player ID (handed out in order from 0) to the session's slot in the array, for the player ID in every message.
+	- address_index maps a player's address to their ID, for JOIN_REQUESTs from players who may already have a session.
+	Erasing a session moves the last session into its slot, so the order of the sessions isn't kept.
+	One per socket shard, guarded by the lock of its shard.
+*/
+class Session_Table
+{
+public:
+	using iterator = std::vector<Player_Session>::iterator;
+
+	iterator begin() { return sessions.begin(); }
+	iterator end() { return sessions.end(); }
+	size_t size() const { return sessions.size(); }
+
+	/*
+		Returns the session of the player, nullptr if there is none.
+	*/
+	Player_Session* Find(int player_id)
+	{
+		if (player_id < 0 || static_cast<size_t>(player_id) >= slot_of_player.size()) return nullptr;
+		int slot = slot_of_player[player_id];
+		return slot == -1 ? nullptr : &sessions[slot];
+	}
+
+	/*
+		Returns the session of the player at the address, nullptr if there is none.
+	*/
+	Player_Session* FindByAddress(const sockaddr_storage& addr)
+	{
+		return Find(address_index.Find(addr));
+	}
+
+	/*
+		Adds the session of a new player, whose ID and address must not have a session yet.
+	*/
+	Player_Session& Insert(Player_Session session)
+	{
+		size_t player_id = static_cast<size_t>(session.player_ID);
+		if (player_id >= slot_of_player.size()) slot_of_player.resize(player_id + 1, -1);
+		slot_of_player[player_id] = static_cast<int>(sessions.size());
+		address_index.Insert(session.addrDest, session.player_ID);
+		sessions.push_back(std::move(session));
+		return sessions.back();
+	}
+
+	/*
+		Removes the session of the player, if there is one.
+	*/
+	void Erase(int player_id)
+	{
+		Player_Session* session = Find(player_id);
+		if (session != nullptr) Erase(sessions.begin() + (session - sessions.data()));
+	}
+
+	/*
+		Removes the session, moving the last session into its slot.
+		Returns an iterator to the session now in that slot (end() if it was the last), to carry on iterating from.
+	*/
+	iterator Erase(iterator iter)
+	{
+		size_t slot = static_cast<size_t>(iter - sessions.begin());
+		slot_of_player[iter->player_ID] = -1;
+		address_index.Erase(iter->addrDest);
+		if (slot != sessions.size() - 1)
+		{
+			*iter = std::move(sessions.back());
+			slot_of_player[iter->player_ID] = static_cast<int>(slot);
+		}
+		sessions.pop_back();
+		return sessions.begin() + slot;
+	}
+
+private:
+	std::vector<Player_Session> sessions{};
+	//Slot in sessions of each player ID, -1 if the player has no session.
+	std::vector<int> slot_of_player{};
+	Address_Index address_index{};
+};
+
+/*
+	Something that happened to a session, queued by the handling thread of its shard for the game loop.
+*/
+struct Session_Event
+{
+	enum Type
+	{
+		PLAYER_JOINED, //New session.
+		PLAYER_LEFT, //Session removed, after AUTOMATIC_DISCONNECTION_TIMER without a packet.
+		PLAYER_MESSAGE //Complete message, or latest transform, from the player.
+	};
+
+	Type type{ PLAYER_MESSAGE };
+	int player_ID{ -1 };
+	//PLAYER_MESSAGE only, starting with its Command ID.
+	std::string message{};
+	//PLAYER_MESSAGE only, the player's clock estimate when the message arrived, for converting its timestamps.
+	Clock_Sync clock_sync{};
+};
+
+/*
+	The sessions of one socket shard, and everything its threads share, behind a lock of its own so the shards never wait on each other.
+	The kernel sends every datagram from an address to the same socket, so a player's session only lives in the shard
+	that received their JOIN_REQUEST, and only that shard's threads look it up.
+	The game loop takes the shard's events once a tick, and locks it again to send the tick's messages.
+	Guarded by lock.
+*/
+struct Session_Shard
+{
+	Session_Shard()
+		: send_timers{ GetMonotonicTime() }, sync_timers{ GetMonotonicTime() }, disconnect_timers{ GetMonotonicTime() }
+	{
+	}
+
+	std::mutex lock{};
+	Session_Table sessions{};
+	//Players joined and left, and messages received, since the game loop last took them, in the order they happened.
+	std::vector<Session_Event> events{};
+	//Player IDs of the sessions with something new to send (a message added, or packets or ACKs received), each listed once.
+	std::vector<int> sessions_to_send{};
+	//Next retransmission or standalone ACK deadline of each of the shard's sessions, by player ID.
+	Timer_Wheel send_timers;
+	//Next clock synchronization ping to each of the shard's sessions, by player ID.
+	Timer_Wheel sync_timers;
+	//Disconnection deadline of each of the shard's sessions, by player ID. Checked again when it fires, as packets received since push it back.
+	Timer_Wheel disconnect_timers;
+};
+
+// Defined with the other globals below.
+extern std::vector<std::unique_ptr<Session_Shard>> session_shards;
+
+void Player_Session::MarkSendPending()
+{
+	if (is_send_pending) return;
+	is_send_pending = true;
+	session_shards[shard]->sessions_to_send.push_back(player_ID);
+}
+
 /*
 	Represents a packet received from socket, used so they can be added to a queue.
 */
@@ -138,7 +300,8 @@ struct Packet
 {
 	sockaddr_storage senderAddr{};
 	std::string data{};
-	int seq_or_ack_number{}; //Either sequence number or ACK.
+	Packet_Header header{}; //ACKs of the datagram the packet came in.
+	int sequence_number{ -1 };
 };
 
 /*
@@ -183,7 +346,7 @@ struct Player {
 
 };//add new asteroid to the map 
 
-// asteroid collision and player transform data structs
+// player transform data struct
 struct PlayerTransform {
 	float Position_X, Position_Y;
 	float Velocity_X, Velocity_Y;
@@ -191,59 +354,89 @@ struct PlayerTransform {
 	float Rotation;
 };
 
-struct AsteroidCollision {
-	unsigned int playerID;
-	unsigned int objectID;
-	unsigned int asteroidID;
-	float timestamp;
+/*
+	One game between the players who were in the lobby when one of them sent START_GAME.
+	Players who join are put in the lobby (a match that hasn't started), and a match takes no new players once started,
+	so one server runs any number of matches side by side. Every match is moved forward on each tick of the game loop.
+	Only used by the game loop.
+*/
+struct Match
+{
+	//Set once START_GAME has been sent to its players. Until then, it's the lobby.
+	bool is_started{ false };
+	//A player in the lobby sent START_GAME on this tick, so it's sent to every player and the match starts.
+	bool is_start_requested{ false };
+	std::vector<int> player_IDs{};
+	std::map<unsigned short, std::vector<Bullet>> bulletMap; // map to store bullet, asteroid and player info
+	std::vector<Asteroids> newAsteroids; // Created since the last message, sent with the next one.
+	std::map<unsigned int, PlayerTransform> playerTransforms;
+	World_Simulation world{}; // Asteroids, bullets and ships as the server sees them, moved every tick.
+	std::vector<Destruction_Event> asteroidDestructions; // Asteroids destroyed on this tick, sent to every player.
+	unsigned int asteroidCount = 0;
+	std::chrono::steady_clock::time_point lastAsteroidSpawn{}; // to keep track of time for asteroid spawn
+	//Messages of the tick, to send to every player of the match.
+	std::string message{}, transform_message{};
 };
 
 
 // Constants
-constexpr float AUTOMATIC_DISCONNECTION_TIMER = 2.f; // Time before server stops waiting for player response, and disconnects them.
+constexpr Ticks AUTOMATIC_DISCONNECTION_TIMER = 2 * TICKS_PER_SECOND; // Time before server stops waiting for player response, and disconnects them.
+constexpr size_t MAX_SOCKET_SHARDS = 32; // Max sockets sharing the port, each with three threads of its own.
+constexpr int DEFAULT_TICK_RATE = 30; // Game ticks per second, if Config.txt doesn't give one.
+constexpr int MAX_TICK_RATE = 240;
+constexpr Ticks TICK_REPORT_INTERVAL = 10 * TICKS_PER_SECOND; // Time between reports of how the game ticks are keeping up.
 const float			ASTEROID_MIN_SCALE_X = 10.0f;		// asteroid minimum scale x
 const float			ASTEROID_MAX_SCALE_X = 60.0f;		// asteroid maximum scale x
 const float			ASTEROID_MIN_SCALE_Y = 10.0f;		// asteroid minimum scale y
 const float			ASTEROID_MAX_SCALE_Y = 60.0f;		// asteroid maximum scale y
-const float			COLLISION_RADIUS_NDC = 0.9f;		// asteroid maximum scale y
+const float			ASTEROID_SPAWN_CLEARANCE = 100.0f;	// asteroids don't spawn closer than this to a player (if there's room)
+const int			ASTEROID_SPAWN_ATTEMPTS = 16;		// positions tried before spawning near a player anyway
+const double		MAX_BULLET_AGE = 0.25;				// most a new bullet is moved forward, for how long ago it was fired
+const size_t		MAX_ASTEROIDS = 500;				// no more spawn while this many are alive, well under the client's GAME_OBJ_INST_NUM_MAX
 
 // Containers
-std::map<int, Player_Session> player_Session_Map{}; // Used to manage interactions with players, including sending/receiving, automatic disconnection, reliable data transfer.
-std::mutex session_map_lock{};
 std::array<unsigned char, 4> server_ip_addr{}; // Server information, set and forget in main().
-std::map<unsigned short, std::vector<Bullet>> bulletMap; // map to store bullet, asteroid and player info
-std::queue<Asteroids> newAsteroidQueue;
-std::queue<Packet> packet_recv_queue{}; // For temporarily storing packets received.
-std::map<unsigned int, PlayerTransform> playerTransforms;
-std::map<unsigned int, AsteroidCollision> asteroidCollisions;
+// Every match by match ID, including the lobby. Only used by the game loop.
+std::map<int, Match> matches{};
+// Match of every player by player ID, from their PLAYER_JOINED to their PLAYER_LEFT. Only used by the game loop.
+std::map<int, int> match_of_player{};
+// Match new players are put in, -1 if there's none until the next player joins.
+int lobby_match_ID = -1;
+int next_match_ID = 0;
 
 // Global vars
 int server_tcp_port_number{}, server_udp_port_number{};
-static unsigned int asteroidCount = 0;
-// Controls what the next player's ID should be, to prevent players from having the same ID.
+int tick_rate{ DEFAULT_TICK_RATE };
+// Controls what the next player's ID should be, to prevent players from having the same ID, across every shard.
 // Reconnecting players will reconnect via sending the player_ID, letting the server know which session to reassume.
-int player_id = 0;
+std::atomic<int> player_id{ 0 };
 
-// For any sending/receiving, set at the start.
-SOCKET udp_socket{};
-std::mutex socket_lock{};
-std::mutex packet_queue_lock{};
+// For any sending/receiving, set at the start. One socket per shard, all bound to the same port.
+std::vector<SOCKET> udp_sockets{};
+/*
+	One Datagram_IO per socket, each with its own receiving, handling and sending threads.
+	With more than one shard (SO_REUSEPORT), the kernel spreads the players between the sockets by address,
+	so a single receiving thread doesn't cap how many datagrams the server can take in.
+*/
+std::vector<std::unique_ptr<Datagram_IO>> socket_shards{};
+// Sessions of each shard, same index as socket_shards.
+std::vector<std::unique_ptr<Session_Shard>> session_shards{};
 
 
 // Indicates if the game has ended, so0 the multi-threaded functions can end too.
 bool isGameRunning{ true };
 
 // Forward declarations:
-void ReadPlayerTransforms(std::istream& input, unsigned short playerID);
-void WritePlayerTransforms(std::ostream& output);
-void ReadAsteroidCollisions(std::istream& input, unsigned short playerID);
-void WriteAsteroidCollision(std::ostream& output);
+void ReadPlayerTransforms(Match& match, Bit_Reader& input, unsigned short playerID);
+void WritePlayerTransforms(Match& match, Bit_Writer& output);
+void WriteAsteroidCollision(Match& match, Bit_Writer& output);
 
-void ReadBullet(std::istream& input, unsigned short playerID);
-void WriteBullet(std::ostream& output);
-void CreateNewAsteroid();
-void WriteNewAsteroids(std::ostream& output);
-void HandleStartGame();
+void ReadBullet(Match& match, Bit_Reader& input, unsigned short playerID, const Clock_Sync& player_clock);
+void WriteBullet(Match& match, Bit_Writer& output);
+void CreateNewAsteroid(Match& match);
+void WriteNewAsteroids(Match& match, Bit_Writer& output);
+void HandleSessionEvent(const Session_Event& event);
+void PrintTickStats(const Tick_Scheduler& tick_scheduler);
 
 // ------------------------------------------------Entry Point--------------------------------------------------------
 /*
@@ -258,200 +451,269 @@ void PrintString(const std::string& message_to_print)
 #endif
 }
 
+/*
+	\brief
+	Writes a message with write(output), doubling buffer and writing it again until it fits.
+	The buffer is kept by the caller, so it only grows on the ticks with more to send than ever before.
+	\return
+	The message written.
+*/
+template <typename Write>
+std::string ComposeMessage(std::vector<char>& buffer, Write&& write)
+{
+	while (true)
+	{
+		Bit_Writer output{ buffer.data(), buffer.size() };
+		write(output);
+		if (!output.HasOverflowed()) return std::string(buffer.data(), output.GetBytesWritten());
+		buffer.resize(buffer.size() * 2);
+	}
+}
+
 /*
 	\brief
 	The starting point where server-player interactions are managed.
-	Called in main after udp_socket has been created and binded.
-	Return (without closing udp_socket) when server-player interactions are completed.
+	Called in main after udp_sockets have been created and binded.
+	Return (without closing udp_sockets) when server-player interactions are completed.
 */
 void GameProgram()
 {
-	
-	//Wait for players to join.
-	HandleStartGame();
-	PrintString("Game Started\n");
-	// to keep track of time for asteroid spawn
-	using Clock = std::chrono::steady_clock;
-	auto lastAsteroidSpawn = Clock::now();
+	std::vector<Timer_Wheel::Timer> expired_timers{};
+	std::vector<Session_Event> events{};
+	//Each tick's messages are written into these.
+	std::vector<char> message_buffer(MAX_BUFFER_SIZE), transform_buffer(MAX_BUFFER_SIZE);
+	Tick_Scheduler tick_scheduler{ tick_rate };
+	Ticks last_tick_deadline = GetMonotonicTime();
+	Ticks next_report_time = GetMonotonicTime() + TICK_REPORT_INTERVAL;
 	while (isGameRunning)
 	{
 
 		/*
 			Structure of Program:
-			It first receives the message, and checks which client sent it (session ID).
-			It then waits for other clients, then after all clients are done it checks for a few things.
-			It stops waiting after a few seconds, and clients who haven�t responded back means they disconnected, so remove them from client list and don�t wait for them.
-			Check who collided with asteroid first, based on their sent timestamps.
-			Send message back to clients
-			- New player transforms (from other players).
+			Runs one tick every 1/tick_rate seconds, without waiting for any player.
+			Each tick takes the events each shard has queued since the last tick: players joining and leaving, and their messages (maybe none).
+			Joining players wait in the lobby, which becomes a match of its own when one of them sends START_GAME.
+			A player whose input hasn't arrived keeps their last known transform, so a laggy player doesn't hold up the others.
+			Players that haven't sent anything for AUTOMATIC_DISCONNECTION_TIMER are disconnected.
+			Every started match then moves its world forward by the tick, destroying every asteroid a bullet or ship touched (earliest hit first).
+			Send message back to the clients of each match
+			- Player transforms (last known of every player).
 			- New bullet creations (from other players)
 			- Asteroid creations.
 			- Asteroid destruction (who destroyed what).
 		*/
-		//==Ensure all messages received and ACK'd.
-		
-
-		/*
-			Spawning of Asteroids, 3 every 2s.
-		*/
-		auto now = Clock::now();
-		auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - lastAsteroidSpawn);
-
-		if (elapsed.count() >= 2) {
-			for (int i = 0; i < 3; ++i)
-				CreateNewAsteroid();
-			lastAsteroidSpawn = now;
+		Ticks tick_deadline = tick_scheduler.WaitForNextTick();
+		//Covers any ticks skipped after an overrun too, so the world keeps up with real time.
+		float delta_time = static_cast<float>(TicksToSeconds(tick_deadline - last_tick_deadline));
+		last_tick_deadline = tick_deadline;
+		Ticks current_time = UpdateCachedTime();
+		if (current_time >= next_report_time)
+		{
+			PrintTickStats(tick_scheduler);
+			tick_scheduler.ResetStats();
+			next_report_time += TICK_REPORT_INTERVAL;
 		}
 
-		bool hasReceivedAllMessage = true;
-		// Waits until it receives all messages from clients
+		//One shard locked at a time, only for as long as it takes to move its events out.
+		for (std::unique_ptr<Session_Shard>& shard : session_shards)
 		{
-			std::lock_guard<std::mutex> map_lock{ session_map_lock };
-			for (auto iter = player_Session_Map.begin(); iter != player_Session_Map.end(); )
+			std::lock_guard<std::mutex> shard_lock{ shard->lock };
+			//Only the players whose disconnection timer has run out are checked, not every player.
+			expired_timers.clear();
+			shard->disconnect_timers.Advance(current_time, expired_timers);
+			for (const Timer_Wheel::Timer& timer : expired_timers)
 			{
-				//If any player has an incomplete message, or an empty buffer, it means not all client messages have been received.
-
-				auto currTime = GetTime() - iter->second.time_last_packet_received;
-				if (currTime >= AUTOMATIC_DISCONNECTION_TIMER) {
-					iter = player_Session_Map.erase(iter);
+				Player_Session* session = shard->sessions.Find(timer.id);
+				if (session == nullptr) continue;
+				if (current_time - session->time_last_packet_received >= AUTOMATIC_DISCONNECTION_TIMER) {
+					shard->sessions.Erase(timer.id);
+					shard->events.push_back(Session_Event{ Session_Event::PLAYER_LEFT, timer.id });
 					continue;
 				}
-
-				if (!iter->second.is_recv_message_complete) {
-					hasReceivedAllMessage = false;
-					break;
-				}
-				if (iter->second.recv_buffer.empty()) {
-					hasReceivedAllMessage = false;
-					break;
-				}
-				
-				iter++;
+				//Packets have come in since, so wait from the last one.
+				shard->disconnect_timers.Schedule(session->time_last_packet_received + AUTOMATIC_DISCONNECTION_TIMER, timer.id);
 			}
+			events.insert(events.end(), std::make_move_iterator(shard->events.begin()), std::make_move_iterator(shard->events.end()));
+			shard->events.clear();
 		}
-		
-		//Wait to receive all	 messages.
-		if (!hasReceivedAllMessage) continue;
-		std::vector<std::pair<int, std::string>> player_messages{};
+		/*
+			Handled without any shard locked, so the shards' threads carry on meanwhile.
+			Events are only in order within a shard, so every join is handled first.
+			Otherwise a player who joined before a START_GAME taken from an earlier shard would miss the match.
+		*/
+		for (const Session_Event& event : events)
 		{
-			std::lock_guard<std::mutex> map_lock{ session_map_lock };
-			for (auto& player_pair : player_Session_Map) {
-				if (!player_pair.second.is_recv_message_complete) {
-					continue;
-				}
-				player_messages.push_back(std::pair{ player_pair.first, player_pair.second.recv_buffer });
-				//Since it's been read, clear it. Since it's cleared, set completed to false.
-				player_pair.second.recv_buffer.clear();
-				player_pair.second.is_recv_message_complete = false;	
-			}
+			if (event.type == Session_Event::PLAYER_JOINED) HandleSessionEvent(event);
 		}
-		//Separate from the map iteration, to not hog the map mutex.
-		for (const auto& player_pair : player_messages)
+		for (const Session_Event& event : events)
 		{
-			if (player_pair.second.empty()) continue;
-			char commandID;
-			std::stringstream msgStream(player_pair.second);
-			while (msgStream.rdbuf()->in_avail()) {
-				msgStream.read(reinterpret_cast<char*>(&commandID), sizeof(char));
-				switch (commandID) {
-				case CLIENT_BULLET_CREATION:
-					ReadBullet(msgStream, player_pair.first);
-					break;
-				case CLIENT_PLAYER_TRANSFORM:
-					ReadPlayerTransforms(msgStream, player_pair.first);
-					break;
-				case CLIENT_COLLISION:
-					ReadAsteroidCollisions(msgStream, player_pair.first);
-					break;
-				default:
-					break;
-				}
-			}
+			if (event.type != Session_Event::PLAYER_JOINED) HandleSessionEvent(event);
 		}
+		events.clear();
 
-		// Send Message to all clients 
+		for (auto& [match_ID, match] : matches)
 		{
-			std::ostringstream messageStream(std::ios::binary);
+			if (!match.is_started) continue;
+			/*
+				Spawning of Asteroids, 3 every 2s.
+			*/
+			auto now = std::chrono::steady_clock::now();
+			auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - match.lastAsteroidSpawn);
+
+			if (elapsed.count() >= 2) {
+				for (int i = 0; i < 3; ++i)
+					CreateNewAsteroid(match);
+				match.lastAsteroidSpawn = now;
+			}
+
+			match.world.Step(delta_time, match.asteroidDestructions);
 
 			// Compose message content
-			WritePlayerTransforms(messageStream);
-			WriteBullet(messageStream);
-			WriteNewAsteroids(messageStream);
-			WriteAsteroidCollision(messageStream);
-			
-
-			std::string message = messageStream.str();
-			std::lock_guard<std::mutex> map_lock{ session_map_lock };
-			for (auto& [_, session] : player_Session_Map) {
-				session.SendLongMessage(message);  // queues packet for reliable sending
+			match.message = ComposeMessage(message_buffer, [&match](Bit_Writer& output) {
+				WriteBullet(match, output);
+				WriteNewAsteroids(match, output);
+				WriteAsteroidCollision(match, output);
+			});
+			//Transforms are sent separately, since a newer transform replaces an older one.
+			match.transform_message = ComposeMessage(transform_buffer, [&match](Bit_Writer& output) { WritePlayerTransforms(match, output); });
+			//Only cleared once written, as a message that doesn't fit is written again into a larger buffer.
+			match.bulletMap.clear();
+			match.newAsteroids.clear();
+			match.asteroidDestructions.clear();
+		}
+
+		// Send Message to all clients, one shard locked at a time.
+		for (std::unique_ptr<Session_Shard>& shard : session_shards)
+		{
+			std::lock_guard<std::mutex> shard_lock{ shard->lock };
+			for (Player_Session& session : shard->sessions) {
+				//Players who joined after the events were taken are handled on the next tick.
+				auto match_iter = match_of_player.find(session.player_ID);
+				if (match_iter == match_of_player.end()) continue;
+				const Match& match = matches.at(match_iter->second);
+				if (match.is_start_requested) {
+					//Send back a start game command to all players of the match using RDT.
+					session.SendLongMessage(std::string(1, (char)START_GAME));
+					continue;
+				}
+				if (!match.is_started) continue;
+				session.SendSequencedMessage(match.transform_message); // sent once, not resent if lost
+				session.SendLongMessage(match.message);  // queues packet for reliable sending
 			}
 		}
-		//ReceiveAllMessages();
-		
+		//Started from the next tick, so START_GAME reaches the players before any game message.
+		for (auto& [match_ID, match] : matches)
+		{
+			if (!match.is_start_requested) continue;
+			match.is_start_requested = false;
+			match.is_started = true;
+			match.lastAsteroidSpawn = std::chrono::steady_clock::now();
+			PrintString("Match " + std::to_string(match_ID) + " started with " + std::to_string(match.player_IDs.size()) + " player(s)");
+#ifndef _DEBUG
+			std::cout << "Match " + std::to_string(match_ID) + " started with " + std::to_string(match.player_IDs.size()) + " player(s)" << std::endl;
+#endif
+		}
 	}
 }
 
 /*
 	\brief
-	Continually get join requests from players, adding them as new players to the map.
-	This happens until the START command is given, which is then echoed to all players and then the game starts (the function returns).
+	Applies something that happened to a player's session to their match.
+	- PLAYER_JOINED: the player is put in the lobby, which is created if there's none.
+	- PLAYER_LEFT: the player is taken out of their match, which ends once it has no players left.
+	- PLAYER_MESSAGE: in the lobby, only START_GAME is read, which starts the match. In a started match, the commands are read into its world.
 */
-void HandleStartGame()
+void HandleSessionEvent(const Session_Event& event)
 {
-	bool isStartGame = false;
-	while (!isStartGame)
+	if (event.type == Session_Event::PLAYER_JOINED)
 	{
-		/*
-			Loops until a player sends a start command.
-			As the start command will be the first command of the game (besides JOIN_REQUEST/ACK),
-			just check for anything in the buffer and see if it's the start command.
-		*/
+		if (lobby_match_ID == -1) lobby_match_ID = next_match_ID++;
+		matches[lobby_match_ID].player_IDs.push_back(event.player_ID);
+		match_of_player[event.player_ID] = lobby_match_ID;
+		return;
+	}
+
+	auto match_iter = match_of_player.find(event.player_ID);
+	if (match_iter == match_of_player.end()) return;
+	int match_ID = match_iter->second;
+	Match& match = matches.at(match_ID);
+
+	if (event.type == Session_Event::PLAYER_LEFT)
+	{
+		match_of_player.erase(match_iter);
+		match.player_IDs.erase(std::find(match.player_IDs.begin(), match.player_IDs.end(), event.player_ID));
+		//Disconnected players are no longer sent to the others.
+		match.playerTransforms.erase(event.player_ID);
+		match.world.RemoveShip(event.player_ID);
+		if (match.player_IDs.empty())
 		{
-			std::lock_guard<std::mutex> map_lock{ session_map_lock };
-			for (auto& session_pair : player_Session_Map)
+			if (match.is_started)
 			{
-				auto& session = session_pair.second;
-				//check if the items in the buffer are readable and completed.
-				if (!session.is_recv_message_complete || session.recv_buffer.empty()) continue;
-				char command_ID = session.recv_buffer[0];
-				//See if the command received is a start command.
-				if (command_ID != START_GAME)
-				{
-					//There shouldn't be any command that is not start game, so this is jic.
-					session.recv_buffer.clear();
-					//Since buffer is cleared.
-					session.is_recv_message_complete = false;
-					continue;
-				}
-				/*
-					Start game command received from one player, so send to every player for them to start.
-					Clear all the recvbuffers as well.
-					Set isStart to true.
-				*/
-				isStartGame = true;
-				break;
+				PrintString("Match " + std::to_string(match_ID) + " ended");
+#ifndef _DEBUG
+				std::cout << "Match " + std::to_string(match_ID) + " ended" << std::endl;
+#endif
 			}
+			matches.erase(match_ID);
+			if (lobby_match_ID == match_ID) lobby_match_ID = -1;
 		}
+		return;
 	}
-	/*
-		Start game command received from one player, so send to every player for them to start.
-		Clear all the recvbuffers as well.
-	*/
-	//Hardcoded way to wait for other packets to come in first, just in case multiple players press START at the same time, so all buffers can be properly cleared.
-	std::this_thread::sleep_for(std::chrono::milliseconds(100));
-	std::lock_guard<std::mutex> map_lock{ session_map_lock };
-	for (auto& session_pair : player_Session_Map)
+
+	if (!match.is_started)
 	{
-		auto& session = session_pair.second;
-		//Clear before moving to start of game, to ensure no additional START_GAME command is mistakenly read as a game command.
-		session.recv_buffer.clear();
-		//Since buffer is cleared.
-		session.is_recv_message_complete = false;
-
-		std::string start_game{ (char)START_GAME };
-		//Send back a start game command to all players using RDT.
-		session.SendLongMessage(start_game);
+		/*
+			As the start command will be the first command of the game (besides JOIN_REQUEST/ACK),
+			just check if it's the start command. Anything else in the lobby is dropped.
+			Players who join from here on are put in a new lobby.
+		*/
+		if (!event.message.empty() && event.message[0] == START_GAME && !match.is_start_requested)
+		{
+			match.is_start_requested = true;
+			lobby_match_ID = -1;
+		}
+		return;
 	}
+
+	//Every command starts on a byte, [Command ID, 1] followed by its bit-packed fields.
+	Bit_Reader input{ event.message.data(), event.message.size() };
+	bool is_known_command = true;
+	while (is_known_command && input.GetBytesLeft() > 0 && !input.HasFailed()) {
+		uint8_t commandID = static_cast<uint8_t>(input.ReadBits(8));
+		switch (commandID) {
+		case CLIENT_BULLET_CREATION:
+			ReadBullet(match, input, static_cast<unsigned short>(event.player_ID), event.clock_sync);
+			break;
+		case CLIENT_PLAYER_TRANSFORM:
+			ReadPlayerTransforms(match, input, static_cast<unsigned short>(event.player_ID));
+			break;
+		default:
+			//Where an unknown command ends can't be told (e.g. an extra START_GAME), so the rest of the message is dropped.
+			is_known_command = false;
+			break;
+		}
+		input.AlignToByte();
+	}
+}
+
+/*
+	\brief
+	Prints how the game ticks have kept up since the last report: how long their work took, and how many ran past the next deadline.
+*/
+void PrintTickStats(const Tick_Scheduler& tick_scheduler)
+{
+	const Tick_Stats& stats = tick_scheduler.GetStats();
+	if (stats.tick_count == 0) return;
+	auto to_ms = [](Ticks ticks) { return TicksToSeconds(ticks) * 1000; };
+	std::ostringstream report{};
+	report << std::fixed << std::setprecision(2) << "Ticks: " << stats.tick_count << " at " << to_ms(tick_scheduler.GetInterval()) << " ms"
+		<< ", work mean " << to_ms(stats.total_work) / stats.tick_count << " ms max " << to_ms(stats.max_work) << " ms"
+		<< ", overruns " << stats.overrun_count << " (" << stats.skipped_count << " ticks skipped)"
+		<< ", woke up late by up to " << to_ms(stats.max_lateness) << " ms";
+	PrintString(report.str());
+#ifndef _DEBUG
+	std::cout << report.str() << std::endl;
+#endif
 }
 
 ///*
@@ -513,36 +775,37 @@ void HandleStartGame()
 //	}
 //}
 
-namespace {
-	//Just used to shift writing of socket to outside the map, to prevent locking of 2 mutexes (which may lead to deadlock if not done well).
-	struct WriteData
-	{
-		sockaddr_storage addrDest;
-		std::string data;
-	};
-}
-
 
 /*
-		It should be called in a separate thread.
-		Will continually read messages from the udp socket, adding them to the packet queue for another function to handle.
-		Will write messages to socket as needed (for messages that require ACK) based on toSend and timeout.
+		It should be called in a separate thread, the only thread that writes to the socket of its shard.
+		Will write messages to socket as needed (for messages that require ACK) based on the send window and timeout,
+		for the sessions pinned to the shard.
+		Also writes the datagrams queued by other threads (e.g. JOIN_RESPONSE).
+		Sleeps until the nearest retransmission or ACK deadline of any of its sessions, or until woken because there is something new to send.
+		Each pass only visits the sessions listed in sessions_to_send and those whose send timer has fired, not every session,
+		with one clock read for the whole pass.
 
 		Note:
-		- Only messages that require an ACK should be sent in this method. Otherwise, just write as per normal (note need to use mutex lock)
-		- To Send: Set the send buffer to the message (excluding checksum and sequence number). Set toSend to be true.
-		- Packet data in the queue has their checksum and sequence number stripped away. They are all confirmed to be uncorrupted,
-		and the number is a separate variable from the data.
-		- Only access the queue through a mutex.
+		- Only messages that require an ACK should be sent in this method. Otherwise, queue them with QueueSend() on the session's shard.
+		- To Send: Add the message (excluding header) to messages_to_send.
+		- ACKs for received packets are carried in the header of the packets sent, or sent on their own after ACK_DELAY.
 	*/
-void ReceiveSendMessages()
+void SendMessages(size_t shard)
 {
-	//Buffer used for receiving data.
-	char buffer[MAX_BUFFER_SIZE]{};
-
+	Datagram_IO& socket_io = *socket_shards[shard];
+	Session_Shard& sender = *session_shards[shard];
+	//Earliest time a send timer has something to do, from the last pass.
+	Ticks next_send_time = 0;
+	std::vector<int> sessions_to_visit{};
+	std::vector<Timer_Wheel::Timer> expired_timers{};
 	while (isGameRunning)
 	{
-		std::vector<WriteData> data_to_write{};
+		//Sleeps until the next deadline, or until another thread queues a datagram or adds a message.
+		socket_io.WaitForQueuedSends((std::min)(TicksToSeconds(next_send_time - GetMonotonicTime()), IDLE_WAIT_INTERVAL));
+		socket_io.FlushSends();
+
+		//Written after the lock is released, so the socket is never written while holding the shard's lock.
+		std::vector<Outgoing_Datagram> data_to_write{};
 		/*
 			Send all pending messages
 			- Timeout has run out
@@ -551,312 +814,333 @@ void ReceiveSendMessages()
 			Ensure send buffer isn't empty.
 		*/
 		{
-			std::lock_guard<std::mutex> map_lock{ session_map_lock };
-			for (auto& player_pair : player_Session_Map)
+			std::lock_guard<std::mutex> shard_lock{ sender.lock };
+			Ticks current_time = UpdateCachedTime();
+			//Sessions with something new to send, then those whose deadline has passed.
+			sessions_to_visit.swap(sender.sessions_to_send);
+			expired_timers.clear();
+			sender.send_timers.Advance(current_time, expired_timers);
+			for (const Timer_Wheel::Timer& timer : expired_timers)
 			{
-				auto& session = player_pair.second;
-				//Ensure that data being written is not empty.
-				if (session.messages_to_send.empty()) continue;
-				if (session.messages_to_send.front().empty())
+				Player_Session* session = sender.sessions.Find(timer.id);
+				//Player gone, or the deadline has moved since this timer was scheduled.
+				if (session == nullptr || session->scheduled_send_time != timer.deadline) continue;
+				session->scheduled_send_time = TICKS_NEVER;
+				if (session->is_send_pending) continue; //Already listed.
+				session->is_send_pending = true;
+				sessions_to_visit.push_back(timer.id);
+			}
+			for (int player_ID : sessions_to_visit)
+			{
+				Player_Session* session_to_visit = sender.sessions.Find(player_ID);
+				if (session_to_visit == nullptr) continue;
+				Player_Session& session = *session_to_visit;
+				session.is_send_pending = false;
+				std::vector<Encoded_Frame*> frames{};
+				//Let more packets into the window if there's space, then send the new and timed out packets.
+				session.reliable_transfer.FillSendWindow(session.messages_to_send);
+				session.reliable_transfer.GetFramesToSend(current_time, frames);
+				//Sequenced message is sent once without waiting for the window.
+				//Format: [COMMAND_SEQUENCED, 1][Sequence Number, 4][Command ID]...
+				Encoded_Frame sequenced_frame{};
+				if (!session.sequenced_message_to_send.empty())
 				{
-					session.messages_to_send.pop();
-					continue;
+					std::string sequenced_message = (char)COMMAND_SEQUENCED + session.sequenced_transfer.EncodeMessage(session.sequenced_message_to_send);
+					sequenced_frame = EncodeFrame(-1, sequenced_message);
+					frames.push_back(&sequenced_frame);
+					session.sequenced_message_to_send.clear();
+				}
+				//Nothing is going out to carry the ACKs of the packets received, so send them on their own.
+				//Format: [ACK command ID, 1]
+				Encoded_Frame ack_frame{};
+				if (frames.empty() && session.reliable_transfer.IsStandaloneAckDue(current_time))
+				{
+					ack_frame = EncodeFrame(-1, std::string(1, (char)ACK));
+					frames.push_back(&ack_frame);
+				}
+				//Pack the frames into as few datagrams as possible, each carrying the ACKs in its header.
+				for (std::string& data : session.reliable_transfer.AssembleDatagrams(frames))
+				{
+					PrintString("MESSAGE SENT, Player ID: " + std::to_string(session.player_ID) + " Data: " + data);
+					data_to_write.push_back({ session.addrDest, std::move(data) });
 				}
-				if (GetTime() - session.reliable_transfer.time_last_packet_sent > TIMEOUT_TIMER)
+				//Only schedule a timer if it's earlier than the one already waiting, the later one is ignored when it fires.
+				Ticks deadline = session.reliable_transfer.GetNextSendTime();
+				if (deadline < session.scheduled_send_time)
 				{
-					session.reliable_transfer.toSend = true;
+					session.scheduled_send_time = deadline;
+					sender.send_timers.Schedule(deadline, player_ID);
 				}
-				if (!session.reliable_transfer.toSend) continue;
-				//Below here, packet is to be sent.
-				std::string message_to_send = session.messages_to_send.front();
-				//Don't pop unless ACK'd
-
-				//Add sequence number to the send.
-				uint32_t network_sequence_number = htonl(session.reliable_transfer.current_sequence_number);
-				char number_buffer[4]{};
-				memcpy_s(number_buffer, 4, &network_sequence_number, 4);
-				std::string sequence_number(number_buffer, number_buffer + 4); //Casting the number to a string.
-
-				std::string data = sequence_number + message_to_send;
-
-				//Add in checksum, convert to network order.
-				uint16_t checksum = htons(CalculateChecksum(data.size(), data.data()));
-				//Collate everything into a single string.
-				memcpy_s(number_buffer, 2, &checksum, 2); //overwrite the previous data in buffer for 0 and 1 byte.
-				std::string checksum_string(number_buffer, number_buffer + 2); //Convert checksum to number.
-				data = checksum_string + data; //checksum in front of data.
-
-				//Reset timeout.
-				session.reliable_transfer.time_last_packet_sent = GetTime();
-				session.reliable_transfer.toSend = false;
-				data_to_write.push_back({ session.addrDest, data });
-
-				PrintString("MESSAGE SENT, Seq Num: " + std::to_string(session.reliable_transfer.current_sequence_number) + " Data: " + data);
 			}
-		}
-		{
-			std::lock_guard<std::mutex> socket_locker{ socket_lock };
-			for (WriteData& write_data : data_to_write)
+			sessions_to_visit.clear();
+
+			//Clock synchronization pings, each on its own datagram so nothing else delays it.
+			expired_timers.clear();
+			sender.sync_timers.Advance(current_time, expired_timers);
+			for (const Timer_Wheel::Timer& timer : expired_timers)
 			{
-				//Send data over
-				WriteToSocket(udp_socket, write_data.addrDest, write_data.data.data(), write_data.data.size());
+				Player_Session* session = sender.sessions.Find(timer.id);
+				if (session == nullptr) continue;
+				//Format: [CLOCK_SYNC_REQUEST, 1][Server Send Time, 8], the time is echoed back as is.
+				char sync_request[9]{};
+				sync_request[0] = CLOCK_SYNC_REQUEST;
+				memcpy_s(sync_request + 1, 8, &current_time, 8);
+				Encoded_Frame sync_frame = EncodeFrame(-1, std::string(sync_request, sync_request + 9));
+				data_to_write.push_back({ session->addrDest, session->reliable_transfer.AssembleDatagrams({ &sync_frame }).front() });
+				Ticks interval = session->clock_sync.SampleCount() < CLOCK_SYNC_WINDOW ? CLOCK_SYNC_FAST_INTERVAL : CLOCK_SYNC_INTERVAL;
+				sender.sync_timers.Schedule(current_time + interval, timer.id);
 			}
+			next_send_time = (std::min)(sender.send_timers.GetNextDeadline(), sender.sync_timers.GetNextDeadline());
 		}
+		//Send data over, every session's datagrams in as few syscalls as possible.
+		socket_io.SendBatch(data_to_write);
+	}
+}
 
-		memset(buffer, 0, MAX_BUFFER_SIZE);
-		/*
-			Receive all messages.
-			Upon receiving, add the packet to the queue.
-		*/
-		//==Read any incoming message.
-		sockaddr_storage sender_addr{}; //temporarily store sender's address.
-		int size_sockaddr = sizeof(sender_addr);
-		int bytes_read{};
-		{
-			std::lock_guard<std::mutex> socket_locker{ socket_lock };
-			bytes_read = recvfrom(udp_socket, buffer, MAX_BUFFER_SIZE, 0, (sockaddr*)&sender_addr, &size_sockaddr);
-		}
-		if (bytes_read <= 0) continue; //Since it is a non-blocking socket read.
-
-
-		//==Check if valid.
-		//Do not accept any message that doesn't have both a checksum and a sequence number
-		//since the game always uses RDT protocol for all messages.
-		if (bytes_read < 6) continue;
-		int number = ReadChecksumAndNumber(buffer, bytes_read);
-		if (number == -1) continue; //Checksum failed.
-
-		//==Add to queue
-		//Exclude checksum and sequence number from the data.
-		std::string data_recv(buffer + 6, buffer + bytes_read);
-		std::lock_guard<std::mutex> packet_locker{ packet_queue_lock };
-		packet_recv_queue.push(Packet{ sender_addr, data_recv, number });
+/*
+		It should be called in a separate thread, the only thread that reads from the socket of its shard.
+		Will continually read messages from the udp socket, adding them to the shard's received ring for HandleReceivedPackets() to handle.
+		Sleeps in epoll/poll while there is nothing to read.
+	*/
+void ReceiveMessages(size_t shard)
+{
+	while (isGameRunning)
+	{
+		socket_shards[shard]->ReceiveDatagrams(IDLE_WAIT_INTERVAL);
 	}
 }
 
 /*
 	\brief
-	Should be called in a separate thread.
-	Will continually read the packet queue and act on it
+	Should be called in a separate thread, one per shard.
+	Will continually read the packet queue of the shard and act on it
 */
-void HandleReceivedPackets()
+void HandleReceivedPackets(size_t shard)
 {
 	/*
-		All packets in the queue are data only (without sequence number/ack/checksum).
-		All packets in the queue are uncorrupted (checksum check has passed).
-		Sequence number/Ack number is located under Packet, as a separate variable.
+		Datagrams are taken from the ring in batches, then checked and split into packets (one per frame).
+		Packets are data only (without header), and uncorrupted (integrity check has passed).
+		Sequence number and ACKs are located under Packet, as a separate variable.
 		Size of packets may start from 0, don't assume there is data inside.
 
-		Use mutex to pop packets from the queue, one at a time.
+		Sleeps while the ring is empty, instead of spinning.
 	*/
+	Packet_Ring& received = socket_shards[shard]->received;
+	//Every session this thread touches is in this shard, as the kernel sends every datagram from an address to the same socket.
+	Session_Shard& session_shard = *session_shards[shard];
+	std::vector<Packet> packets{};
 	while (isGameRunning)
 	{
-		Packet packet;
+		//Wakes up now and then even if nothing arrives, to check if the game has ended.
+		if (!received.WaitForDatagrams(IDLE_WAIT_INTERVAL)) continue;
+		Queued_Datagram* datagrams[PACKET_BATCH_SIZE]{};
+		size_t datagram_count = received.PeekBatch(datagrams, PACKET_BATCH_SIZE);
+		packets.clear();
+		for (size_t i = 0; i < datagram_count; i++)
 		{
-			std::lock_guard<std::mutex> packet_locker{ packet_queue_lock };
-			if (packet_recv_queue.empty()) continue;
-			packet = packet_recv_queue.front();
-			packet_recv_queue.pop();
+			Queued_Datagram& datagram = *datagrams[i];
+			Packet_Header header{};
+			std::vector<Frame> frames{};
+			if (!ReadDatagram(datagram.data, datagram.length, header, frames)) continue; //Too short or integrity check failed.
+			for (Frame& frame : frames)
+			{
+				packets.push_back(Packet{ datagram.addr, std::move(frame.message), header, frame.sequence_number });
+			}
 		}
-		/*
-			Types of packets
-			- ACK: [General Command ID (ACK) unsigned char][2 bytes unsigned, player id]
-			- Non ACK: Reply with ACK [Checksum][ACK number][General Command ID (ACK) unsigned char]
-				- player in map: [General Command ID unsigned char][2 bytes unsigned, player id]
-				- player not in map: [General Command ID unsigned char]
-		*/
-
-		//Just discard empty packets since no command ID.
-		if (packet.data.empty()) continue;
-		unsigned char command_ID = packet.data[0];
-
+		received.PopBatch(datagram_count);
+		//The whole batch is handled with one clock reading.
+		Ticks current_time = UpdateCachedTime();
 
-		if (command_ID == ACK)
+		//Set if a session was touched by this batch, to wake the shard's sending thread once it's handled.
+		bool is_send_needed = false;
+		for (Packet& packet : packets)
 		{
-			//Not enough data since no player ID.
-			if (packet.data.size() < 3) continue;
-			//Get the player ID, for checking against the map.
-			uint16_t player_id{};
-			memcpy_s(&player_id, 2, packet.data.data() + 1, 2);
-			player_id = ntohs(player_id);
-
-			//Find the player in the map.
-			std::lock_guard<std::mutex> map_lock{ session_map_lock };
-			auto iter = player_Session_Map.find((int)player_id);
-			PrintString(std::string("ACK RECV, Seq Num: ") + std::to_string(packet.seq_or_ack_number) + " Player ID: " + std::to_string(player_id));
-
-			//Can't be found in map, so ignore the packet.
-			if (iter == player_Session_Map.end()) continue;
-			Player_Session& session = iter->second;
-
 			/*
-				Using ACK number, decide what to do with ACK.
-				If ACK == current sequence number, packet has been received successfully
-				- Increment sequence number, get rid of the current packet to send the next packet.
-				- Reset timeout to infinity.
-				- If there's buffer left, set isSend to true.
+				Types of packets
+				- ACK: [General Command ID (ACK) unsigned char][2 bytes unsigned, player id]
+				- Non ACK: ACK'd through the header of the next packet sent to the player (or a standalone ACK if there's none).
+					- player in map: [General Command ID unsigned char][2 bytes unsigned, player id]
+					- player not in map: [General Command ID unsigned char]
 			*/
-			//==ACK number is less than packet sent out, so ignore.
-			if (packet.seq_or_ack_number < session.reliable_transfer.current_sequence_number) continue;
-			//==ACK matches packet sent out, meaning packet received successfully.
-			session.reliable_transfer.current_sequence_number++;
-			//Clear all data that has been sent successfully.
-			if (!session.messages_to_send.empty()) session.messages_to_send.pop();
-
-			//Reset timers
-			session.time_last_packet_received = GetTime();
-			session.reliable_transfer.time_last_packet_sent = 20000000000000; //Reset to some time in the future to effectively set timeout to infinity.
-			//Send the remaining data in the buffer, if any.
-			if (!session.messages_to_send.empty()) session.reliable_transfer.toSend = true;
-			continue; //Handling of packet finished.
-		}
-		
-		/*
-			Two scenarios
-			1. Player looking to join --> [General Command ID] only
-			- Send back [General Command ID][Player ID, 2] as JOIN_RESPONSE
-			2. Existing player --> [General Command ID][Player ID][Length of message][Command ID]...
-			- Send back ACK.
-			- Add to recv buffer if necessary.
-			In both cases, increment ack_last_packet_received if it's higher.
-		*/
-		if (command_ID == JOIN_REQUEST)
-		{
+
+			//Just discard empty packets since no command ID.
+			if (packet.data.empty()) continue;
+			unsigned char command_ID = packet.data[0];
+
 			/*
-				Check if it's a duplicate message, like if they're an existing player but don't know yet.
-				1. Check if player in map
-				If so, then don't assign a new entry and player id. instead reuse the player id.
-				2. Send back join response using rdt (set send buffer).
-				[Checksum, 2][ACK, 4][Command ID][Player_ID, 2].
-				Player repeatedly sends JOIN request to server until JOIN_RESPONSE is sent back.
-				Since server receives the JOIN request, it should also increment its ack of last packet received when it first receives.
+				Two scenarios
+				1. Player looking to join --> [General Command ID][Supported Integrity Modes, 1]
+				- Send back [General Command ID][Player ID, 2][Integrity Mode, 1] as JOIN_RESPONSE
+				2. Existing player --> [General Command ID][Player ID][Length of message][Command ID]...
+				- ACKs in the header are read.
+				- Add to recv buffer if necessary.
 			*/
-			char ack_buffer[9]{};
+			if (command_ID == JOIN_REQUEST)
 			{
-				std::lock_guard<std::mutex> map_lock{ session_map_lock };
-
-
 				/*
-					After receiving request, get its existing or new player id.
+					Check if it's a duplicate message, like if they're an existing player but don't know yet.
+					1. Check if player in map
+					If so, then don't assign a new entry and player id. instead reuse the player id.
+					2. Pick the integrity mode for the session, from the modes the player supports.
+					3. Send back join response, which ACKs the JOIN_REQUEST through its header.
+					[Header][Command ID][Player_ID, 2][Integrity Mode, 1].
+					Player repeatedly sends JOIN request to server until JOIN_RESPONSE is sent back.
+					Since server receives the JOIN request, it should also count it as received when it first receives.
 				*/
-				int client_player_id = -1; //-1 to indicate it doesn't have a player id yet.
-				//Iterate over the map, to see if the player already is in the game (maybe they never received the JOIN_RESPONSE).
-				for (auto& player_entry : player_Session_Map)
+				std::string join_response{};
 				{
-					//Check if they're already in the map.
-					if (!Compare_SockAddr(&packet.senderAddr, &player_entry.second.addrDest)) continue;
-					//They are already in the map.
-					client_player_id = player_entry.first;
-				}
+					std::lock_guard<std::mutex> shard_lock{ session_shard.lock };
+
 
-				//No player entry found for this ip address, so add in a new entry.
-				if (client_player_id == -1)
-				{
-					client_player_id = player_id;
 					/*
-						Store new player information into the map.
+						After receiving request, get its existing or new player id.
 					*/
-					player_Session_Map.emplace(player_id++, Player_Session{ packet.senderAddr });
-				}
-
-				//Send the information back to the player as a JOIN_RESPONSE, [Checksum, 2][ACK, 4][Command ID][Player_ID, 2].
-				uint16_t network_player_id = htons((uint16_t)client_player_id);
-
-
-				//Add in ACK number and command ID.
-				uint32_t network_response_ACK = htonl(packet.seq_or_ack_number);
-				memcpy_s(ack_buffer + 2, 4, &network_response_ACK, 4);
-				ack_buffer[6] = JOIN_RESPONSE;
-				memcpy_s(ack_buffer + 7, 2, &network_player_id, 2);
-				//Calculate and add in checksum.
-				uint16_t network_checksum = htons(CalculateChecksum(7, ack_buffer + 2));
-				memcpy_s(ack_buffer, 2, &network_checksum, 2);
-
-
-				Player_Session& session = player_Session_Map.find(client_player_id)->second;
-				//session.time_last_packet_received = GetTime();
-				//Increment ack of last packet received.
-				if (session.reliable_transfer.ack_last_packet_received < packet.seq_or_ack_number)
-				{
-					session.reliable_transfer.ack_last_packet_received = packet.seq_or_ack_number;
-				}
-				PrintString("JOIN_REQUEST RECV, Seq Num: " + std::to_string(packet.seq_or_ack_number) + " Player ID: " + std::to_string(client_player_id));
+					//Look up the address, to see if the player already is in the game (maybe they never received the JOIN_RESPONSE).
+					Player_Session* existing_session = session_shard.sessions.FindByAddress(packet.senderAddr);
+
+					//No player entry found for this ip address, so add in a new entry.
+					if (existing_session == nullptr)
+					{
+						/*
+							Store new player information into the table.
+						*/
+						existing_session = &session_shard.sessions.Insert(Player_Session{ player_id++, packet.senderAddr, shard });
+						//The JOIN_REQUEST counts as the first packet, so a player who never sends anything else is still disconnected.
+						existing_session->time_last_packet_received = current_time;
+						session_shard.disconnect_timers.Schedule(existing_session->time_last_packet_received + AUTOMATIC_DISCONNECTION_TIMER, existing_session->player_ID);
+						session_shard.sync_timers.Schedule(current_time, existing_session->player_ID);
+						//Handed to the game loop, which puts the player in the lobby.
+						session_shard.events.push_back(Session_Event{ Session_Event::PLAYER_JOINED, existing_session->player_ID });
+					}
+
+					Player_Session& session = *existing_session;
+					int client_player_id = session.player_ID;
+					//Count the JOIN_REQUEST as received, so that it's ACK'd. It carries no game data, so nothing is delivered.
+					std::vector<std::string> packets_in_order{};
+					session.reliable_transfer.ReceivePacket(packet.sequence_number, packet.data, packets_in_order, current_time);
+
+					//Players that don't send their supported modes only support the 16 bit checksum.
+					uint8_t supported_modes = packet.data.size() >= 2 ? static_cast<uint8_t>(packet.data[1]) : (1 << INTEGRITY_SUM16);
+					session.reliable_transfer.integrity_mode = ChooseIntegrityMode(supported_modes);
+					//The JOIN_REQUEST now needs its ACK, which its sending thread picks up on its next pass.
+					session.MarkSendPending();
+
+					//Send the information back to the player as a JOIN_RESPONSE, [Header][Command ID][Player_ID, 2][Integrity Mode, 1].
+					uint16_t network_player_id = htons((uint16_t)client_player_id);
+					char response_message[4]{};
+					response_message[0] = JOIN_RESPONSE;
+					memcpy_s(response_message + 1, 2, &network_player_id, 2);
+					response_message[3] = static_cast<char>(session.reliable_transfer.integrity_mode);
+					//JOIN_RESPONSE isn't ACK'd, so it doesn't need a sequence number.
+					Encoded_Frame join_response_frame = EncodeFrame(-1, std::string(response_message, response_message + 4));
+					join_response = session.reliable_transfer.AssembleDatagrams({ &join_response_frame }).front();
+
+					PrintString("JOIN_REQUEST RECV, Seq Num: " + std::to_string(packet.sequence_number) + " Player ID: " + std::to_string(client_player_id));
 #ifndef _DEBUG
-				std::cout << "JOIN_REQUEST RECV, Seq Num: " + std::to_string(packet.seq_or_ack_number) + " Player ID: " + std::to_string(client_player_id) << std::endl;
+					std::cout << "JOIN_REQUEST RECV, Seq Num: " + std::to_string(packet.sequence_number) + " Player ID: " + std::to_string(client_player_id) << std::endl;
 #endif
+				}
+				//Send back JOIN response to sender, through the sending thread of this shard (woken after the batch).
+				socket_shards[shard]->QueueSend(packet.senderAddr, join_response.data(), join_response.size(), false);
+				is_send_needed = true;
+				continue;
 			}
-			//Send back JOIN response to sender.
-			{
-				std::lock_guard<std::mutex> socket_locker{ socket_lock };
-				WriteToSocket(udp_socket, packet.senderAddr, ack_buffer, 9);
-			}
-			continue;
-		}
 
 
-		/*
-			COMMAND_INCOMPLETE or COMMAND_COMPLETE.
-
-			Just add their message (whatever it is) to the map.
-			Set messageIncomplete to false or true depending on the general command.
-		*/
-		/*
-			*Send back an ACK for the packet received. Don't need to for JOIN_REQUEST, as JOIN_RESPONSE is already an ACK.
-			*Format: [Checksum, 2][ACK, 4][ACK command ID, 1]
-		*/
-		char ack_buffer[7]{};
-		//Add in ACK number and command ID.
-		uint32_t network_response_ACK = htonl(packet.seq_or_ack_number);
-		memcpy_s(ack_buffer + 2, 4, &network_response_ACK, 4);
-		ack_buffer[6] = ACK;
-		//Calculate and add in checksum.
-		uint16_t network_checksum = htons(CalculateChecksum(5, ack_buffer + 2));
-		memcpy_s(ack_buffer, 2, &network_checksum, 2);
-
-		//Send back ACK response to sender.
-		{
-			std::lock_guard<std::mutex> socket_locker{ socket_lock };
-			WriteToSocket(udp_socket, packet.senderAddr, ack_buffer, 7);
-		}
+			/*
+				ACK, COMMAND_SEQUENCED, COMMAND_INCOMPLETE, COMMAND_COMPLETE or CLOCK_SYNC_RESPONSE.
 
-		/*
-			In both cases, add to the recv buffer. Set message complete to be true or false depending.
-		*/
-		if (command_ID == COMMAND_COMPLETE || command_ID == COMMAND_INCOMPLETE)
-		{
+				Read the ACKs in the header, for the packets sent to the player.
+				For clock synchronization responses, add the ping to the player's clock estimate.
+				For sequenced commands, keep the message only if it's the latest.
+				For commands, just add their message (whatever it is) to the map.
+				Set messageIncomplete to false or true depending on the general command.
+			*/
+			if (command_ID != ACK && command_ID != COMMAND_SEQUENCED && command_ID != COMMAND_COMPLETE && command_ID != COMMAND_INCOMPLETE && command_ID != CLOCK_SYNC_RESPONSE) continue;
 			//Message format: [General Command = COMMAND][Player ID, 2][Command ID]...[Command ID 2]
 			//Not enough data since no player ID.
 			if (packet.data.size() < 3) continue;
-			std::lock_guard<std::mutex> map_lock{ session_map_lock };
+			std::lock_guard<std::mutex> shard_lock{ session_shard.lock };
 			//Get the player ID, for checking against the map.
 			uint16_t player_id{};
 			memcpy_s(&player_id, 2, packet.data.data() + 1, 2);
 			player_id = ntohs(player_id);
-			auto player_session_iter = player_Session_Map.find(player_id);
-			//Invalid player ID, no such player.
-			if (player_session_iter == player_Session_Map.end()) continue;
+			Player_Session* player_session = session_shard.sessions.Find(player_id);
+			//Invalid player ID, no such player (in this shard).
+			if (player_session == nullptr) continue;
 
 			//==From here, player is valid. 
 
-			Player_Session& session = player_session_iter->second;
-			session.time_last_packet_received = GetTime(); //Reset timer.
-			//==Check if it's a new message, by comparing packet number with the last successful packet.
-			if (session.reliable_transfer.ack_last_packet_received >= packet.seq_or_ack_number) continue;
-			//it's a new packet, so update the stored ack number.
-			session.reliable_transfer.ack_last_packet_received = packet.seq_or_ack_number;
+			Player_Session& session = *player_session;
+			//Datagram wasn't checked with the mode negotiated for the player, so it can't be trusted.
+			if (packet.header.integrity_mode != session.reliable_transfer.integrity_mode) continue;
+			//ACKs may open up the send window, and packets received need their ACKs sent.
+			session.MarkSendPending();
+			is_send_needed = true;
+			session.time_last_packet_received = current_time; //Reset timer.
+			/*
+				Using the ACKs in the header, mark the packets in the send window as received.
+				The window slides forward once the packets in front are all ACK'd, letting new packets be sent.
+			*/
+			session.reliable_transfer.ReceiveAckBits(packet.header.ack_number, packet.header.ack_bits, current_time);
+			//Handling of packet finished, standalone ACKs carry nothing else.
+			if (command_ID == ACK) continue;
+			//Format: [CLOCK_SYNC_RESPONSE][Player ID, 2][Server Send Time, 8][Client Receive Time, 4][Client Send Time, 4]
+			//Not ACK'd, a lost ping is just a missing sample.
+			if (command_ID == CLOCK_SYNC_RESPONSE)
+			{
+				if (packet.data.size() < 19) continue;
+				Ticks server_send_time{};
+				memcpy_s(&server_send_time, 8, packet.data.data() + 3, 8);
+				float client_times[2]{};
+				for (int i = 0; i < 2; i++)
+				{
+					uint32_t net_time{};
+					memcpy_s(&net_time, 4, packet.data.data() + 11 + 4 * i, 4);
+					net_time = ntohl(net_time);
+					memcpy_s(&client_times[i], 4, &net_time, 4);
+				}
+				//Only answers to pings already sent can be trusted, anything else is corrupt or forged.
+				if (server_send_time <= 0 || server_send_time > current_time) continue;
+				session.clock_sync.AddSample(server_send_time, client_times[0], client_times[1], current_time);
+				continue;
+			}
+			//Format: [COMMAND_SEQUENCED][Player ID, 2][Sequence Number, 4][Command ID]...
+			//Not ACK'd, older messages are dropped.
+			if (command_ID == COMMAND_SEQUENCED)
+			{
+				if (session.sequenced_transfer.ReceiveMessage(packet.data.data() + 3, packet.data.size() - 3))
+				{
+					session_shard.events.push_back(Session_Event{ Session_Event::PLAYER_MESSAGE, session.player_ID,
+						session.sequenced_transfer.TakeLatestMessage(), session.clock_sync });
+				}
+				continue;
+			}
 
+			/*
+				Buffer the packet, getting back every packet that is now in order (may be none if there's a gap in front).
+				Packets too far ahead of the window are dropped without an ACK, so they get resent later.
+				The ACK is sent with the next packet to the player (or a standalone ACK after ACK_DELAY).
+			*/
+			std::vector<std::string> packets_in_order{};
+			if (!session.reliable_transfer.ReceivePacket(packet.sequence_number, packet.data, packets_in_order, current_time)) continue;
 
 			/*
-				Add to the player's recv buffer after removing [General Command ID] and [Player ID]
+				Reassemble the fragments after removing [General Command ID] and [Player ID]
 				This is because both general command ID and player ID are no longer necessary (any message in the player recvbuffer is both a COMMAND and belongs to that player).
-				Doing this also helps to chain incomplete packets together.
+				Once every fragment of a message is received, hand it to the game loop.
 			*/
-			session.recv_buffer.insert(session.recv_buffer.end(), packet.data.begin() + 3, packet.data.end());
-			if (command_ID == COMMAND_COMPLETE) session.is_recv_message_complete = true;
-			else session.is_recv_message_complete = false; //Still need to wait for more packets.
+			for (const std::string& data : packets_in_order)
+			{
+				std::string complete_message{};
+				if (data.size() < 3 || !session.reassembler.ReceiveFragment(data.data() + 3, data.size() - 3, complete_message)) continue;
+				session_shard.events.push_back(Session_Event{ Session_Event::PLAYER_MESSAGE, session.player_ID, std::move(complete_message), session.clock_sync });
+			}
 
-			PrintString("MESSAGE RECV, Seq Num: " + std::to_string(packet.seq_or_ack_number) + " Data: " + packet.data);
+			PrintString("MESSAGE RECV, Seq Num: " + std::to_string(packet.sequence_number) + " Data: " + packet.data);
 		}
+		//ACKs may have opened up send windows, and received packets need their ACKs sent, so the sending thread has new deadlines.
+		if (is_send_needed) socket_shards[shard]->WakeSender();
 	}
 }
 
@@ -864,23 +1148,80 @@ void HandleReceivedPackets()
 
 
 
+/*
+	\brief
+	Reads "Key: value" lines, in any order, with spaces around the key and value ignored.
+	Lines without a ':' are ignored. If a key is given twice, the last one is kept.
+	\return
+	Value of each key.
+*/
+std::map<std::string, std::string> ReadConfig(std::istream& config_file)
+{
+	auto trim = [](const std::string& text) {
+		size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos) return std::string{};
+		return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+		};
+
+	std::map<std::string, std::string> values{};
+	std::string line{};
+	while (std::getline(config_file, line))
+	{
+		size_t colon = line.find(':');
+		if (colon == std::string::npos) continue;
+		values[trim(line.substr(0, colon))] = trim(line.substr(colon + 1));
+	}
+	return values;
+}
+
+/*
+	\brief
+	Gets the whole number from min_value to max_value set for key in config.
+	If key isn't there, it's default_value. If it isn't such a number (e.g. "abc", "-1" or "60x"), it's default_value with a warning.
+*/
+int GetConfigNumber(const std::map<std::string, std::string>& config, const std::string& key, int min_value, int max_value, int default_value)
+{
+	auto iter = config.find(key);
+	if (iter == config.end()) return default_value;
+
+	const std::string& text = iter->second;
+	int value{};
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (error != std::errc{} || end != text.data() + text.size() || value < min_value || value > max_value)
+	{
+		std::cerr << "Config.txt: " << key << " \"" << text << "\" isn't a whole number from " << min_value << " to " << max_value
+			<< ", using " << default_value << "." << std::endl;
+		return default_value;
+	}
+	return value;
+}
+
 /*
 	\brief
 	Entry point of this program, which creates a server that handles server-player communication and interactions.
 */
 int main(int argc, char* argv[])
 {
-	std::string temp;
-	std::string udp_port_string{};
 	std::ifstream config_file{ "Config.txt" };
 	if (!config_file.is_open())
 	{
 		PrintString("Unable to open Config.txt. Add to project directory and executable directory.");
 		return -1;
 	}
-	config_file >> std::ws >> temp >> std::ws >> udp_port_string;
-	server_udp_port_number = std::stoi(udp_port_string);
+	std::map<std::string, std::string> config = ReadConfig(config_file);
 	config_file.close();
+	//"Server_Port_Number: P" is required, as there's no port to fall back on.
+	server_udp_port_number = GetConfigNumber(config, "Server_Port_Number", 1, 65535, 0);
+	if (server_udp_port_number == 0)
+	{
+		std::cerr << "Config.txt needs a Server_Port_Number from 1 to 65535." << std::endl;
+		return -1;
+	}
+	std::string udp_port_string = std::to_string(server_udp_port_number);
+	//Optional "Socket_Shards: K", for K sockets sharing the port.
+	size_t socket_shard_count = static_cast<size_t>(GetConfigNumber(config, "Socket_Shards", 1, static_cast<int>(MAX_SOCKET_SHARDS), 1));
+	//Optional "Tick_Rate: N", for N game ticks per second.
+	tick_rate = GetConfigNumber(config, "Tick_Rate", 1, MAX_TICK_RATE, DEFAULT_TICK_RATE);
 	/*
 		1. Create a UDP socket with port number based on client input
 		2. Bind the UDP socket to the machine
@@ -890,52 +1231,27 @@ int main(int argc, char* argv[])
 	*/
 
 	// -------------------------------------------------------------------------
-	// Start up Winsock, asking for version 2.2.
+	// Start up the socket library (Winsock 2.2 on Windows, nothing on POSIX).
 	//
-	// WSAStartup()
+	// StartupSockets()
 	// -------------------------------------------------------------------------
 
-	// This object holds the information about the version of Winsock that we
-	// are using, which is not necessarily the version that we requested.
-	WSADATA wsaData{};
-
-	// Initialize Winsock. You must call WSACleanup when you are finished.
-	// As this function uses a reference counter, for each call to WSAStartup,
-	// you must call WSACleanup or suffer memory issues.
-	int errorCode = WSAStartup(MAKEWORD(2, 2), &wsaData);
+	// Each successful StartupSockets() must be matched by a CleanupSockets().
+	int errorCode = StartupSockets();
 	if (errorCode != NO_ERROR)
 	{
-		std::cerr << "WSAStartup() failed." << std::endl;
+		std::cerr << "StartupSockets() failed." << std::endl;
 		return errorCode;
 	}
 
 	char host[1000];
 	gethostname(host, 1000);
 
-	/*=====
-	* Creation of UDP file download socket.
-
-
-	*/
 	/*
-		Creation of UDP socket.
-	*/
-	udp_socket = socket(
-		AF_INET, //IPV4
-		SOCK_DGRAM, //UDP.
-		IPPROTO_UDP);
-	if (udp_socket == INVALID_SOCKET)
-	{
-		std::cerr << "socket() failed." << std::endl;
-		WSACleanup();
-		return 1;
-	}
-
-	/*
-		Get address information and bind udp socket.
+		Get address information for the udp sockets.
 	*/
 	addrinfo hints_udp{};
-	SecureZeroMemory(&hints_udp, sizeof(hints_udp));
+	memset(&hints_udp, 0, sizeof(hints_udp));
 	hints_udp.ai_family = AF_INET;
 	// For UDP use SOCK_DGRAM instead of SOCK_STREAM.
 	hints_udp.ai_socktype = SOCK_DGRAM;
@@ -947,23 +1263,54 @@ int main(int argc, char* argv[])
 	if ((NO_ERROR != errorCode) || (nullptr == info_udp))
 	{
 		std::cerr << "getaddrinfo() failed." << std::endl;
-		WSACleanup();
+		CleanupSockets();
 		return errorCode;
 	}
 
 	/*
-		Binding of UDP socket to current ip address
+		Creation of UDP sockets, one per shard, all binded to the same ip address and port.
+		Sharing the port needs SO_REUSEPORT, without it there is only one shard.
 	*/
-	if (bind(udp_socket, info_udp->ai_addr, static_cast<int>(info_udp->ai_addrlen)) != NO_ERROR) {
-		std::cerr << "Bind failed" << std::endl;
-		closesocket(udp_socket);
-		udp_socket = INVALID_SOCKET;
-		WSACleanup();
-		return errorCode;
+	for (size_t shard = 0; shard < socket_shard_count; shard++)
+	{
+		SOCKET udp_socket = socket(
+			AF_INET, //IPV4
+			SOCK_DGRAM, //UDP.
+			IPPROTO_UDP);
+		if (udp_socket == INVALID_SOCKET)
+		{
+			std::cerr << "socket() failed." << std::endl;
+			for (SOCKET shard_socket : udp_sockets) CloseSocket(shard_socket);
+			CleanupSockets();
+			return 1;
+		}
+		if (socket_shard_count > 1 && !SetReusePort(udp_socket))
+		{
+			//Only the sockets binded so far can share the port, or just this one if it's the first.
+			socket_shard_count = (std::max)(shard, size_t{ 1 });
+			std::cerr << "SO_REUSEPORT failed, using " << socket_shard_count << " socket shard(s)." << std::endl;
+			if (shard > 0)
+			{
+				CloseSocket(udp_socket);
+				break;
+			}
+		}
+
+		/*
+			Binding of UDP socket to current ip address
+		*/
+		if (bind(udp_socket, info_udp->ai_addr, static_cast<int>(info_udp->ai_addrlen)) != NO_ERROR) {
+			std::cerr << "Bind failed" << std::endl;
+			CloseSocket(udp_socket);
+			for (SOCKET shard_socket : udp_sockets) CloseSocket(shard_socket);
+			udp_sockets.clear();
+			CleanupSockets();
+			return 1;
+		}
+		// Enable non-blocking I/O on the socket.
+		SetNonBlocking(udp_socket);
+		udp_sockets.push_back(udp_socket);
 	}
-	// Enable non-blocking I/O on the download socket.
-	u_long enable = 1;
-	ioctlsocket(udp_socket, FIONBIO, &enable);
 
 
 	/* PRINT SERVER IP ADDRESS AND PORT NUMBER */
@@ -973,41 +1320,53 @@ int main(int argc, char* argv[])
 	getnameinfo(info_udp->ai_addr, static_cast <socklen_t> (info_udp->ai_addrlen), serverIPAddr, sizeof(serverIPAddr), nullptr, 0, NI_NUMERICHOST);
 	std::cerr << "Server IP Address: " << serverIPAddr << std::endl;
 	std::cerr << "Server UDP Port Number: " << udp_port_string << std::endl;
+	std::cerr << "Socket Shards: " << udp_sockets.size() << std::endl;
 
-	/*
-		1st thread.
-		Will continually read messages from the udp socket, adding them to the packet queue for another function to handle.
-		Will write messages to socket as needed (for messages that require ACK) based on toSend and timeout.
+	std::vector<std::thread> network_threads{};
+	for (size_t shard = 0; shard < udp_sockets.size(); shard++)
+	{
+		socket_shards.push_back(std::make_unique<Datagram_IO>());
+		socket_shards[shard]->Attach(udp_sockets[shard]);
+		session_shards.push_back(std::make_unique<Session_Shard>());
+	}
+	for (size_t shard = 0; shard < socket_shards.size(); shard++)
+	{
+		/*
+			1st thread of the shard.
+			Will write messages to socket as needed (for messages that require ACK) based on the send window and timeout.
+			The only thread that writes to the shard's socket, other threads queue their datagrams through its Datagram_IO.
+		*/
+		network_threads.emplace_back(SendMessages, shard);
 
-		Note:
-		- Only messages that require an ACK should be sent in this method. Otherwise, just write as per normal (note need to use mutex lock)
-		- To Send: Set the send buffer to the message (excluding checksum and sequence number). Set toSend to be true.
-		- Packet data in the queue has their checksum and sequence number stripped away. They are all confirmed to be uncorrupted,
-		and the number is a separate variable from the data.
-		- Only access the queue through a mutex.
-	*/
-	std::thread thread_to_receive_and_send_message(ReceiveSendMessages);
+		/*
+			2nd thread of the shard.
+			Will continually read messages from the shard's udp socket, adding them to the queue for the handling thread.
+			The only thread that reads from the shard's socket.
+		*/
+		network_threads.emplace_back(ReceiveMessages, shard);
 
-	/*
-		\brief
-		Should be called in a separate thread.
-		Will continually read the packet queue and act on it
-	*/
-	std::thread thread_to_handle_messages(HandleReceivedPackets);
+		/*
+			3rd thread of the shard.
+			Will continually read the shard's packet queue and act on it
+		*/
+		network_threads.emplace_back(HandleReceivedPackets, shard);
+	}
 	//Will run until game program closes (server-player interaction stops).
 	GameProgram();
 
 
 	// -------------------------------------------------------------------------
-	// Clean-up after Winsock.
+	// Clean-up after the socket library.
 	//
-	// WSACleanup()
+	// CleanupSockets()
 	// -------------------------------------------------------------------------
-	if (thread_to_receive_and_send_message.joinable()) thread_to_receive_and_send_message.join();
-	if (thread_to_handle_messages.joinable()) thread_to_handle_messages.join();
-	closesocket(udp_socket); //Shutdown not necessary.
-	udp_socket = INVALID_SOCKET;
-	WSACleanup();
+	for (std::thread& network_thread : network_threads)
+	{
+		if (network_thread.joinable()) network_thread.join();
+	}
+	for (SOCKET udp_socket : udp_sockets) CloseSocket(udp_socket); //Shutdown not necessary.
+	udp_sockets.clear();
+	CleanupSockets();
 }
 
 
@@ -1017,145 +1376,101 @@ int main(int argc, char* argv[])
 Reads bullet spawn message from the client and store them in the map to write
 back to the players
 format: everything after command id
-[2 bytes, number of bullets][4bytes, int Object ID][4 bytes, float X position]
-[4 bytes, float Y position][8 bytes, vec2 velocity][4 bytes, float rotation]
-[4 bytes, float timestamp]...
+[varint, number of bullets][zigzag varint, Object ID - previous Object ID (0 for the first)]
+[16 bits, X position][16 bits, Y position][12 bits, X velocity][12 bits, Y velocity][10 bits, rotation]
+[32 bits, float timestamp]...
+Positions, velocities and rotations are fixed point, as set in Utility.hpp (POSITION_QUANTIZATION and so on).
+The bullets are also added to the world, moved forward by how long ago they were fired (timestamp, on the player's clock).
 */
 /******************************************************************************/
-void ReadBullet(std::istream& input, unsigned short playerID)
+void ReadBullet(Match& match, Bit_Reader& input, unsigned short playerID, const Clock_Sync& player_clock)
 {
-	uint16_t numBulletsNet = 0;
-	input.read(reinterpret_cast<char*>(&numBulletsNet), sizeof(uint16_t));
-	uint16_t numBullets = ntohs(numBulletsNet);
-
-	for (int i = 0; i < numBullets; ++i)
+	uint32_t numBullets = input.ReadVarUInt();
+	int objectID = 0;
+	for (uint32_t i = 0; i < numBullets && !input.HasFailed(); ++i)
 	{
-		uint32_t netObjectID, netPosX, netPosY, netVelX, netVelY, netRotation, netTimestamp;
-
-		input.read(reinterpret_cast<char*>(&netObjectID), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netPosX), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netPosY), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netVelX), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netVelY), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netRotation), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netTimestamp), sizeof(uint32_t));
-
-		int objectID = ntohl(netObjectID);
-		float posX, posY, velX, velY, rotation, timestamp;
-
-		netPosX = ntohl(netPosX); memcpy(&posX, &netPosX, sizeof(float));
-		netPosY = ntohl(netPosY); memcpy(&posY, &netPosY, sizeof(float));
-		netVelX = ntohl(netVelX); memcpy(&velX, &netVelX, sizeof(float));
-		netVelY = ntohl(netVelY); memcpy(&velY, &netVelY, sizeof(float));
-		netRotation = ntohl(netRotation); memcpy(&rotation, &netRotation, sizeof(float));
-		netTimestamp = ntohl(netTimestamp); memcpy(&timestamp, &netTimestamp, sizeof(float));
+		objectID += input.ReadVarInt();
+		float posX = input.ReadQuantized(POSITION_QUANTIZATION);
+		float posY = input.ReadQuantized(POSITION_QUANTIZATION);
+		float velX = input.ReadQuantized(VELOCITY_QUANTIZATION);
+		float velY = input.ReadQuantized(VELOCITY_QUANTIZATION);
+		float rotation = input.ReadAngle(ANGLE_BITS);
+		float timestamp = input.ReadFloat();
+		//A bullet cut off by the end of the message isn't added.
+		if (input.HasFailed()) break;
 
 		Bullet newBullet = { objectID, posX, posY, velX, velY, rotation, timestamp };
-		bulletMap[playerID].push_back(newBullet);
+		match.bulletMap[playerID].push_back(newBullet);
+
+		double age = std::clamp(GetTime() - player_clock.ToLocalTime(timestamp), 0.0, MAX_BULLET_AGE);
+		match.world.AddBullet(Sim_Bullet{ playerID, static_cast<unsigned int>(objectID), { posX, posY }, { velX, velY } }, static_cast<float>(age));
 	}
 }
 
 /******************************************************************************/
 /*!
 \brief
-writes the bullet message back into the output stream
+writes the bullet message back into the output
 format:
-[Player ID1][All the bullets of player 1][Player ID 2][All the bullets of player 2]...
+[0x5][varint, number of players][varint, Player ID1][All the bullets of player 1, as ReadBullet() reads them]
+[varint, Player ID 2][All the bullets of player 2]...
 */
 /******************************************************************************/
-void WriteBullet(std::ostream& output)
+void WriteBullet(Match& match, Bit_Writer& output)
 {
-	char commandID = SERVER_BULLET_CREATION;
-	output.write(reinterpret_cast<const char*>(&commandID), sizeof(char));
+	output.WriteBits(SERVER_BULLET_CREATION, 8);
 
-	uint16_t numPlayers = static_cast<uint16_t>(player_Session_Map.size());
-	uint16_t netNumPlayers = htons(numPlayers);
-	output.write(reinterpret_cast<const char*>(&netNumPlayers), sizeof(uint16_t));
-
-	std::vector<int> list_of_player_ids{};
+	output.WriteVarUInt(static_cast<uint32_t>(match.player_IDs.size()));
+	for (int p_id : match.player_IDs)
 	{
-		std::lock_guard<std::mutex> map_lock{ session_map_lock };
-		for (auto iter_pair : player_Session_Map)
-		{
-			list_of_player_ids.push_back(iter_pair.first);
-		}
-	}
-	for (int p_id : list_of_player_ids)
-	{
-		uint16_t netPlayerID = htons(p_id);
-		output.write(reinterpret_cast<const char*>(&netPlayerID), sizeof(uint16_t));
+		output.WriteVarUInt(static_cast<uint32_t>(p_id));
 
-		auto iter = bulletMap.find(p_id);
-		if (iter == bulletMap.end())
+		auto iter = match.bulletMap.find(p_id);
+		if (iter == match.bulletMap.end())
 		{
-			uint16_t numBullets = 0;
-			uint16_t netNumBullets = htons(numBullets);
-			output.write(reinterpret_cast<const char*>(&netNumBullets), sizeof(uint16_t));
+			output.WriteVarUInt(0);
 			continue;
 		}
-		uint16_t numBullets = iter->second.size();
-		uint16_t netNumBullets = htons(numBullets);
-		output.write(reinterpret_cast<const char*>(&netNumBullets), sizeof(uint16_t));
 		auto& bullets = iter->second;
+		output.WriteVarUInt(static_cast<uint32_t>(bullets.size()));
+		//IDs of a player's bullets go up one at a time, so their differences fit in a byte.
+		int previousID = 0;
 		for (const Bullet& bullet : bullets)
 		{
-
-			uint32_t netObjectID = htonl(bullet.objectID);
-			output.write(reinterpret_cast<const char*>(&netObjectID), sizeof(uint32_t));
-
-			uint32_t netPosX, netPosY, netVelX, netVelY, netRotation, netTimeStamp;
-
-			memcpy(&netPosX, &bullet.posX, sizeof(float));
-			netPosX = htonl(netPosX);
-			output.write(reinterpret_cast<const char*>(&netPosX), sizeof(uint32_t));
-
-			memcpy(&netPosY, &bullet.posY, sizeof(float));
-			netPosY = htonl(netPosY);
-			output.write(reinterpret_cast<const char*>(&netPosY), sizeof(uint32_t));
-
-			memcpy(&netVelX, &bullet.velocityX, sizeof(float));
-			netVelX = htonl(netVelX);
-			output.write(reinterpret_cast<const char*>(&netVelX), sizeof(uint32_t));
-
-			memcpy(&netVelY, &bullet.velocityY, sizeof(float));
-			netVelY = htonl(netVelY);
-			output.write(reinterpret_cast<const char*>(&netVelY), sizeof(uint32_t));
-
-			memcpy(&netRotation, &bullet.rotation, sizeof(float));
-			netRotation = htonl(netRotation);
-			output.write(reinterpret_cast<const char*>(&netRotation), sizeof(uint32_t));
-
-			memcpy(&netTimeStamp, &bullet.timeStamp, sizeof(float));
-			netTimeStamp = htonl(netTimeStamp);
-			output.write(reinterpret_cast<const char*>(&netTimeStamp), sizeof(uint32_t));
+			output.WriteVarInt(bullet.objectID - previousID);
+			previousID = bullet.objectID;
+			output.WriteQuantized(bullet.posX, POSITION_QUANTIZATION);
+			output.WriteQuantized(bullet.posY, POSITION_QUANTIZATION);
+			output.WriteQuantized(bullet.velocityX, VELOCITY_QUANTIZATION);
+			output.WriteQuantized(bullet.velocityY, VELOCITY_QUANTIZATION);
+			output.WriteAngle(bullet.rotation, ANGLE_BITS);
+			output.WriteFloat(bullet.timeStamp);
 		}
 	}
-
-	bulletMap.clear();
+	output.AlignToByte();
 }
 
 
 /******************************************************************************/
 /*!
 \brief
-Create asteriods and push them into the queue for writing later
-format:
-[0x6][2 bytes, number of asteroids][4bytes Asteroid ID][8bytes vec2 pos]
-[8 bytes vec2 velocity][4 bytes float rotation][8 bytes vec2 scale]
-[4 bytes, float timestamp][4 bytes Asteroid ID2...]
+Create asteriods in the match and push them into its newAsteroids for writing later
+Does nothing while MAX_ASTEROIDS are alive in the match.
 */
 /******************************************************************************/
-void CreateNewAsteroid()
+void CreateNewAsteroid(Match& match)
 {
+	if (match.world.GetAsteroids().size() >= MAX_ASTEROIDS) return;
+
 	//static lambda to only run once.
 	static auto once = []() {
 		srand((unsigned int)GetTime());
 		};
 
 	auto playerCollision = [&](float x, float y) {
-		for (const auto& [_, player] : playerTransforms) {
-			if (x > player.Position_X - COLLISION_RADIUS_NDC && x < player.Position_X + COLLISION_RADIUS_NDC &&
-				y > player.Position_Y - COLLISION_RADIUS_NDC && y < player.Position_Y + COLLISION_RADIUS_NDC) {
+		for (const auto& [_, player] : match.playerTransforms) {
+			if (x > player.Position_X - ASTEROID_SPAWN_CLEARANCE && x < player.Position_X + ASTEROID_SPAWN_CLEARANCE &&
+				y > player.Position_Y - ASTEROID_SPAWN_CLEARANCE && y < player.Position_Y + ASTEROID_SPAWN_CLEARANCE) {
 				return true;
 			}
 		}
@@ -1169,15 +1484,14 @@ void CreateNewAsteroid()
 	float scaleX;
 	float scaleY;
 
-	//Set it so that it doesn't spawn on the player.
-
+	//Set it so that it doesn't spawn on the player, unless the players leave no room for it.
+	int attempts = 0;
 	do
 	{
-		// ndc coordinates, to be converted to scale in client side
-		posX = (static_cast<float>(rand()) / RAND_MAX) * 2.0f - 1.0f;
-		posY = (static_cast<float>(rand()) / RAND_MAX) * 2.0f - 1.0f;
-		//std::cout << "Position x: " << posX << "Position y: " << posY << std::endl;
-	} while (playerCollision(posX, posY));
+		// world coordinates, same as the client's window
+		posX = (static_cast<float>(rand()) / RAND_MAX) * (WORLD_MAX_X - WORLD_MIN_X) + WORLD_MIN_X;
+		posY = (static_cast<float>(rand()) / RAND_MAX) * (WORLD_MAX_Y - WORLD_MIN_Y) + WORLD_MIN_Y;
+	} while (playerCollision(posX, posY) && ++attempts < ASTEROID_SPAWN_ATTEMPTS);
 
 	velX = (float)(rand() % 200) - 100.f;
 	velY = (float)(rand() % 200) - 100.f;
@@ -1185,13 +1499,20 @@ void CreateNewAsteroid()
 	scaleX = (float)(rand() % (int)(ASTEROID_MAX_SCALE_X - ASTEROID_MIN_SCALE_X) + ASTEROID_MIN_SCALE_X);
 	scaleY = (float)(rand() % (int)(ASTEROID_MAX_SCALE_Y - ASTEROID_MIN_SCALE_Y) + ASTEROID_MIN_SCALE_Y);
 
-	Asteroids asteroid{ asteroidCount++, posX, posY, velX, velY, scaleX, scaleY, 0.0f, static_cast<float>(GetTime()) };
+	//Snapped to what the players read, so the server simulates the asteroid exactly where they see it.
+	//Otherwise the rounding of its velocity would add up over the asteroid's life.
+	posX = Quantize(posX, POSITION_QUANTIZATION);
+	posY = Quantize(posY, POSITION_QUANTIZATION);
+	velX = Quantize(velX, VELOCITY_QUANTIZATION);
+	velY = Quantize(velY, VELOCITY_QUANTIZATION);
+	scaleX = Quantize(scaleX, SCALE_QUANTIZATION);
+	scaleY = Quantize(scaleY, SCALE_QUANTIZATION);
 
-	if (asteroidCount >= 1000) {
-		asteroidCount = 0;
-	}
+	// IDs aren't reused, so a new asteroid can't take the ID of one that's still alive.
+	Asteroids asteroid{ match.asteroidCount++, posX, posY, velX, velY, scaleX, scaleY, 0.0f, static_cast<float>(GetTime()) };
 
-	newAsteroidQueue.push(asteroid);
+	match.newAsteroids.push_back(asteroid);
+	match.world.AddAsteroid(Sim_Asteroid{ asteroid.id, { posX, posY }, { velX, velY }, { scaleX, scaleY } });
 }
 
 
@@ -1199,213 +1520,101 @@ void CreateNewAsteroid()
 /*!
 \brief
 Write the asteroids into the output buffer
+format:
+[0x6][varint, number of asteroids][zigzag varint, Asteroid ID - previous Asteroid ID (0 for the first)]
+[2 x 16 bits, pos][2 x 12 bits, velocity][10 bits, rotation][2 x 6 bits, scale]
+[32 bits, float timestamp][zigzag varint, Asteroid ID2 - Asteroid ID]...
+Everything but the timestamp is fixed point, as set in Utility.hpp.
 */
 /******************************************************************************/
-void WriteNewAsteroids(std::ostream& output)
+void WriteNewAsteroids(Match& match, Bit_Writer& output)
 {
-	char commandID = SERVER_ASTEROID_CREATION;
-	output.write(reinterpret_cast<const char*>(&commandID), sizeof(char));
-
-	uint16_t numAsteroids = static_cast<uint16_t>(newAsteroidQueue.size());
-	uint16_t netNumAsteroids = htons(numAsteroids);
-	output.write(reinterpret_cast<const char*>(&netNumAsteroids), sizeof(uint16_t));
-
-	while (!newAsteroidQueue.empty())
+	output.WriteBits(SERVER_ASTEROID_CREATION, 8);
+	output.WriteVarUInt(static_cast<uint32_t>(match.newAsteroids.size()));
+	//Created one after another, so their IDs usually go up by 1.
+	unsigned int previousID = 0;
+	for (const Asteroids& asteroid : match.newAsteroids)
 	{
-		Asteroids asteroid = newAsteroidQueue.front();
-		newAsteroidQueue.pop();
-
-		uint32_t netID = htonl(asteroid.id);
-		output.write(reinterpret_cast<const char*>(&netID), sizeof(uint32_t));
-
-		uint32_t netPosX, netPosY, netVelX, netVelY, netRotation, netScaleX, netScaleY, netTimeCreated;
-
-
-		memcpy(&netPosX, &asteroid.Position_x, sizeof(float));
-		netPosX = htonl(netPosX);
-		output.write(reinterpret_cast<const char*>(&netPosX), sizeof(uint32_t));
-
-		memcpy(&netPosY, &asteroid.Position_y, sizeof(float));
-		netPosY = htonl(netPosY);
-		output.write(reinterpret_cast<const char*>(&netPosY), sizeof(uint32_t));
-
-		memcpy(&netVelX, &asteroid.Velocity_x, sizeof(float));
-		netVelX = htonl(netVelX);
-		output.write(reinterpret_cast<const char*>(&netVelX), sizeof(uint32_t));
-
-		memcpy(&netVelY, &asteroid.Velocity_y, sizeof(float));
-		netVelY = htonl(netVelY);
-		output.write(reinterpret_cast<const char*>(&netVelY), sizeof(uint32_t));
-
-		memcpy(&netRotation, &asteroid.Rotation, sizeof(float));
-		netRotation = htonl(netRotation);
-		output.write(reinterpret_cast<const char*>(&netRotation), sizeof(uint32_t));
-
-		memcpy(&netScaleX, &asteroid.Scale_x, sizeof(float));
-		netScaleX = htonl(netScaleX);
-		output.write(reinterpret_cast<const char*>(&netScaleX), sizeof(uint32_t));
-
-		memcpy(&netScaleY, &asteroid.Scale_y, sizeof(float));
-		netScaleY = htonl(netScaleY);
-		output.write(reinterpret_cast<const char*>(&netScaleY), sizeof(uint32_t));
-
-		memcpy(&netTimeCreated, &asteroid.time_of_creation, sizeof(float));
-		netTimeCreated = htonl(netTimeCreated);
-		output.write(reinterpret_cast<const char*>(&netTimeCreated), sizeof(uint32_t));
-		//std::cout << "Read asteroid info with position (" << asteroid.Position_x << ", " << asteroid.Position_y << ")" << std::endl;
+		output.WriteVarInt(static_cast<int32_t>(asteroid.id - previousID));
+		previousID = asteroid.id;
+		output.WriteQuantized(asteroid.Position_x, POSITION_QUANTIZATION);
+		output.WriteQuantized(asteroid.Position_y, POSITION_QUANTIZATION);
+		output.WriteQuantized(asteroid.Velocity_x, VELOCITY_QUANTIZATION);
+		output.WriteQuantized(asteroid.Velocity_y, VELOCITY_QUANTIZATION);
+		output.WriteAngle(asteroid.Rotation, ANGLE_BITS);
+		output.WriteQuantized(asteroid.Scale_x, SCALE_QUANTIZATION);
+		output.WriteQuantized(asteroid.Scale_y, SCALE_QUANTIZATION);
+		output.WriteFloat(asteroid.time_of_creation);
 	}
+	output.AlignToByte();
 }
 
 /*
 	\brief
-	Reads player transform data from input stream and updates player information
+	Reads player transform data from input and updates player information
+	format: everything after command id
+	[16 bits, X position][16 bits, Y position][2 x 12 bits, velocity][2 x 12 bits, acceleration][10 bits, rotation]
+	All fixed point, as set in Utility.hpp.
 */
-void ReadPlayerTransforms(std::istream& input, unsigned short playerID) {
+void ReadPlayerTransforms(Match& match, Bit_Reader& input, unsigned short playerID) {
 
 	PlayerTransform transform;
-	uint32_t netVal;
-
-	input.read(reinterpret_cast<char*>(&netVal), sizeof(uint32_t));
-	netVal = ntohl(netVal); memcpy(&transform.Position_X, &netVal, sizeof(float));
-
-	input.read(reinterpret_cast<char*>(&netVal), sizeof(uint32_t));
-	netVal = ntohl(netVal); memcpy(&transform.Position_Y, &netVal, sizeof(float));
-
-	input.read(reinterpret_cast<char*>(&netVal), sizeof(uint32_t));
-	netVal = ntohl(netVal); memcpy(&transform.Velocity_X, &netVal, sizeof(float));
-
-	input.read(reinterpret_cast<char*>(&netVal), sizeof(uint32_t));
-	netVal = ntohl(netVal); memcpy(&transform.Velocity_Y, &netVal, sizeof(float));
-
-	input.read(reinterpret_cast<char*>(&netVal), sizeof(uint32_t));
-	netVal = ntohl(netVal); memcpy(&transform.Acceleration_X, &netVal, sizeof(float));
-
-	input.read(reinterpret_cast<char*>(&netVal), sizeof(uint32_t));
-	netVal = ntohl(netVal); memcpy(&transform.Acceleration_Y, &netVal, sizeof(float));
-
-	input.read(reinterpret_cast<char*>(&netVal), sizeof(uint32_t));
-	netVal = ntohl(netVal); memcpy(&transform.Rotation, &netVal, sizeof(float));
-
-	playerTransforms[playerID] = transform;
+	transform.Position_X = input.ReadQuantized(POSITION_QUANTIZATION);
+	transform.Position_Y = input.ReadQuantized(POSITION_QUANTIZATION);
+	transform.Velocity_X = input.ReadQuantized(VELOCITY_QUANTIZATION);
+	transform.Velocity_Y = input.ReadQuantized(VELOCITY_QUANTIZATION);
+	transform.Acceleration_X = input.ReadQuantized(ACCELERATION_QUANTIZATION);
+	transform.Acceleration_Y = input.ReadQuantized(ACCELERATION_QUANTIZATION);
+	transform.Rotation = input.ReadAngle(ANGLE_BITS);
+	//A transform cut off by the end of the message is dropped, keeping the last one.
+	if (input.HasFailed()) return;
+
+	match.playerTransforms[playerID] = transform;
+	match.world.SetShip(playerID, { transform.Position_X, transform.Position_Y }, { transform.Velocity_X, transform.Velocity_Y });
 	
 }
 
 /*
 	\brief
-	Writes all player transform data to output stream
+	Writes all player transform data to output
+	format: [0x4][varint, number of players][varint, Player ID][transform, as ReadPlayerTransforms() reads it]...
 */
-void WritePlayerTransforms(std::ostream& output) {
-
-	// command id
-	char commandID = SERVER_PLAYER_TRANSFORM;
-	output.write(reinterpret_cast<const char*>(&commandID), sizeof(char));
-
-	// num of players
-	uint16_t numPlayers = static_cast<uint16_t>(playerTransforms.size());
-	uint16_t netNumPlayers = htons(numPlayers);
-	//std::cout << "netNumPlayers: " << netNumPlayers << std::endl;
-	output.write(reinterpret_cast<const char*>(&netNumPlayers), sizeof(uint16_t));
-
-	for (const auto& [playerID, transform] : playerTransforms) {
-
-		uint16_t netPlayerID = htons(playerID);
-		output.write(reinterpret_cast<const char*>(&netPlayerID), sizeof(uint16_t));
+void WritePlayerTransforms(Match& match, Bit_Writer& output) {
 
-		uint32_t netVal;
+	output.WriteBits(SERVER_PLAYER_TRANSFORM, 8);
+	output.WriteVarUInt(static_cast<uint32_t>(match.playerTransforms.size()));
 
-		memcpy(&netVal, &transform.Position_X, sizeof(float));
-		netVal = htonl(netVal);
-		output.write(reinterpret_cast<const char*>(&netVal), sizeof(uint32_t));
+	for (const auto& [playerID, transform] : match.playerTransforms) {
 
-		memcpy(&netVal, &transform.Position_Y, sizeof(float));
-		netVal = htonl(netVal);
-		output.write(reinterpret_cast<const char*>(&netVal), sizeof(uint32_t));
-
-		memcpy(&netVal, &transform.Velocity_X, sizeof(float));
-		netVal = htonl(netVal);
-		output.write(reinterpret_cast<const char*>(&netVal), sizeof(uint32_t));
-
-		memcpy(&netVal, &transform.Velocity_Y, sizeof(float));
-		netVal = htonl(netVal);
-		output.write(reinterpret_cast<const char*>(&netVal), sizeof(uint32_t));
-
-		memcpy(&netVal, &transform.Acceleration_X, sizeof(float));
-		netVal = htonl(netVal);
-		output.write(reinterpret_cast<const char*>(&netVal), sizeof(uint32_t));
-
-		memcpy(&netVal, &transform.Acceleration_Y, sizeof(float));
-		netVal = htonl(netVal);
-		output.write(reinterpret_cast<const char*>(&netVal), sizeof(uint32_t));
-
-		memcpy(&netVal, &transform.Rotation, sizeof(float));
-		netVal = htonl(netVal);
-		output.write(reinterpret_cast<const char*>(&netVal), sizeof(uint32_t));
+		output.WriteVarUInt(playerID);
+		output.WriteQuantized(transform.Position_X, POSITION_QUANTIZATION);
+		output.WriteQuantized(transform.Position_Y, POSITION_QUANTIZATION);
+		output.WriteQuantized(transform.Velocity_X, VELOCITY_QUANTIZATION);
+		output.WriteQuantized(transform.Velocity_Y, VELOCITY_QUANTIZATION);
+		output.WriteQuantized(transform.Acceleration_X, ACCELERATION_QUANTIZATION);
+		output.WriteQuantized(transform.Acceleration_Y, ACCELERATION_QUANTIZATION);
+		output.WriteAngle(transform.Rotation, ANGLE_BITS);
 	}
-
-	playerTransforms.clear();
+	output.AlignToByte();
+	//Kept, so a player whose input doesn't arrive in time for a tick is sent at their last known transform.
 }
 
 /*
 	\brief
-	Reads asteroid collision data from input stream
+	Writes the asteroids destroyed on this tick to output, and who destroyed them.
+	format: [0x7][varint, number of collisions][varint, Player ID][varint, Object ID (0 for the ship)][varint, Asteroid ID]...
 */
-void ReadAsteroidCollisions(std::istream& input, unsigned short playerID) {
-
-	// number of collisions
-	uint16_t netNumCollisions;
-	input.read(reinterpret_cast<char*>(&netNumCollisions), sizeof(uint16_t));
-	uint16_t numCollisions = ntohs(netNumCollisions);
-
-	for (unsigned short i = 0; i < numCollisions; ++i) {
-		uint32_t netObjectID, netAsteroidID, netTimestamp;
- 		input.read(reinterpret_cast<char*>(&netObjectID), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netAsteroidID), sizeof(uint32_t));
-		input.read(reinterpret_cast<char*>(&netTimestamp), sizeof(uint32_t));
-
-		AsteroidCollision collision;
-		collision.playerID = playerID;
-		netObjectID = ntohl(netObjectID);
-		memcpy(&collision.objectID, &netObjectID, sizeof(unsigned int));
-		netAsteroidID = ntohl(netAsteroidID);
-		memcpy(&collision.asteroidID, &netAsteroidID, sizeof(unsigned int));
-		netTimestamp = ntohl(netTimestamp);
-		memcpy(&collision.timestamp, &netTimestamp, sizeof(float));
-
-		// Store to map with asteroidID as key for earliest timestamp comparison
-		auto& existing = asteroidCollisions[collision.asteroidID];
-		if (existing.timestamp == 0.0f || collision.timestamp < existing.timestamp) {
-			collision.playerID = playerID;
-			asteroidCollisions[collision.asteroidID] = collision;
-		}
-	}
-}
-
-/*
-	\brief
-	Writes asteroid collision data to output stream
-*/
-void WriteAsteroidCollision(std::ostream& output) {
-
-	// command id
-	char commandID = SERVER_COLLISION;
-	output.write(reinterpret_cast<const char*>(&commandID), sizeof(char));
-
-	uint16_t numCollisions = static_cast<uint16_t>(asteroidCollisions.size()); 
-	uint16_t netNumCollisions = htons(numCollisions);
-	output.write(reinterpret_cast<const char*>(&netNumCollisions), sizeof(uint16_t));
-
-	for (const auto& [asteroidID, collisionData] : asteroidCollisions) {
-		uint16_t netPlayerID = htons(collisionData.playerID);
-		output.write(reinterpret_cast<const char*>(&netPlayerID), sizeof(uint16_t));
-
-		uint32_t netObjectID = htonl(collisionData.objectID);
-		output.write(reinterpret_cast<const char*>(&netObjectID), sizeof(uint32_t));
+void WriteAsteroidCollision(Match& match, Bit_Writer& output) {
 
-		uint32_t netAsteroidID = htonl(collisionData.asteroidID);
-		output.write(reinterpret_cast<const char*>(&netAsteroidID), sizeof(uint32_t));
+	output.WriteBits(SERVER_COLLISION, 8);
+	output.WriteVarUInt(static_cast<uint32_t>(match.asteroidDestructions.size()));
 
+	for (const Destruction_Event& destruction : match.asteroidDestructions) {
+		output.WriteVarUInt(static_cast<uint32_t>(destruction.player_ID));
+		output.WriteVarUInt(destruction.object_ID);
+		output.WriteVarUInt(destruction.asteroid_ID);
 	}
-	asteroidCollisions.clear();
+	output.AlignToByte();
 }
 
 
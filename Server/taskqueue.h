@@ -8,6 +8,7 @@
 #include <vector>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <optional>
 #include <thread>
 
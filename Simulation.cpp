@@ -0,0 +1,354 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file Simulation.cpp
+\author Joel Lee Jie
+\date 16 October 2026
+\brief
+This file implements the headless world simulation the server runs every tick,
+the swept AABB collision test it decides hits with, and the spatial hash broadphase that finds the pairs to test.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#include "Simulation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+Sim_AABB GetBoundingBox(Sim_Vec2 position, Sim_Vec2 scale)
+{
+	return Sim_AABB{ { position.x - scale.x / 2.0f, position.y - scale.y / 2.0f },
+		{ position.x + scale.x / 2.0f, position.y + scale.y / 2.0f } };
+}
+
+/*
+	\brief
+	Checks each axis in turn, narrowing the time both boxes overlap on every axis checked so far.
+	Box 2 is treated as stationary, with box 1 moving at their relative velocity.
+*/
+bool SweepAABB(const Sim_AABB& box1, Sim_Vec2 vel1, const Sim_AABB& box2, Sim_Vec2 vel2, float max_time, float& time_of_collision)
+{
+	//Time the boxes start overlapping on every axis, and stop overlapping on any.
+	float t_first = 0.0f, t_last = max_time;
+	const float min1[2]{ box1.min.x, box1.min.y }, max1[2]{ box1.max.x, box1.max.y };
+	const float min2[2]{ box2.min.x, box2.min.y }, max2[2]{ box2.max.x, box2.max.y };
+	const float velocity[2]{ vel1.x - vel2.x, vel1.y - vel2.y };
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (velocity[axis] == 0.0f)
+		{
+			//Not moving on this axis, so they never overlap unless they already do.
+			if (max1[axis] < min2[axis] || min1[axis] > max2[axis]) return false;
+			continue;
+		}
+		float t_enter, t_exit;
+		if (velocity[axis] > 0.0f)
+		{
+			t_enter = (min2[axis] - max1[axis]) / velocity[axis];
+			t_exit = (max2[axis] - min1[axis]) / velocity[axis];
+		}
+		else
+		{
+			t_enter = (max2[axis] - min1[axis]) / velocity[axis];
+			t_exit = (min2[axis] - max1[axis]) / velocity[axis];
+		}
+		t_first = (std::max)(t_first, t_enter);
+		t_last = (std::min)(t_last, t_exit);
+		if (t_first > t_last) return false;
+	}
+	time_of_collision = t_first;
+	return true;
+}
+
+float WrapValue(float x, float x0, float x1)
+{
+	if (x < x0) return x + (x1 - x0);
+	if (x > x1) return x - (x1 - x0);
+	return x;
+}
+
+namespace
+{
+	/*
+		Box covering box over its whole movement at velocity for time.
+	*/
+	Sim_AABB GetSweptBox(const Sim_AABB& box, Sim_Vec2 velocity, float time)
+	{
+		Sim_Vec2 distance{ velocity.x * time, velocity.y * time };
+		return Sim_AABB{ { box.min.x + (std::min)(distance.x, 0.0f), box.min.y + (std::min)(distance.y, 0.0f) },
+			{ box.max.x + (std::max)(distance.x, 0.0f), box.max.y + (std::max)(distance.y, 0.0f) } };
+	}
+
+	bool IsOutsideWorld(Sim_Vec2 position)
+	{
+		return position.x < WORLD_MIN_X || position.x > WORLD_MAX_X || position.y < WORLD_MIN_Y || position.y > WORLD_MAX_Y;
+	}
+
+	void Move(Sim_Vec2& position, Sim_Vec2 velocity, float time)
+	{
+		position.x += velocity.x * time;
+		position.y += velocity.y * time;
+	}
+}
+
+Spatial_Hash::Spatial_Hash(Sim_Vec2 origin, Sim_Vec2 size, float cell_size)
+	: origin{ origin }, cell_size{ cell_size },
+	column_count{ (std::max)(static_cast<int>(std::ceil(size.x / cell_size)), 1) },
+	row_count{ (std::max)(static_cast<int>(std::ceil(size.y / cell_size)), 1) }
+{
+	cells.resize(static_cast<size_t>(column_count) * row_count);
+}
+
+uint32_t Spatial_Hash::Insert(const Sim_AABB& box, uint32_t user_data)
+{
+	uint32_t proxy;
+	if (free_proxies.empty())
+	{
+		proxy = static_cast<uint32_t>(proxies.size());
+		proxies.emplace_back();
+	}
+	else
+	{
+		proxy = free_proxies.back();
+		free_proxies.pop_back();
+	}
+	proxies[proxy].user_data = user_data;
+	proxies[proxy].range = GetCellRange(box);
+	AddToCells(proxy);
+	return proxy;
+}
+
+void Spatial_Hash::Update(uint32_t proxy, const Sim_AABB& box)
+{
+	Cell_Range range = GetCellRange(box);
+	//Most objects stay within the same cells from one tick to the next.
+	if (range == proxies[proxy].range) return;
+	RemoveFromCells(proxy);
+	proxies[proxy].range = range;
+	AddToCells(proxy);
+}
+
+void Spatial_Hash::Remove(uint32_t proxy)
+{
+	RemoveFromCells(proxy);
+	free_proxies.push_back(proxy);
+}
+
+Spatial_Hash::Cell_Range Spatial_Hash::GetCellRange(const Sim_AABB& box) const
+{
+	Cell_Range range{
+		static_cast<int>(std::floor((box.min.x - origin.x) / cell_size)),
+		static_cast<int>(std::floor((box.min.y - origin.y) / cell_size)),
+		static_cast<int>(std::floor((box.max.x - origin.x) / cell_size)),
+		static_cast<int>(std::floor((box.max.y - origin.y) / cell_size)) };
+	//A box wider than the grid would wrap around onto cells it already covers.
+	range.max_column = (std::min)(range.max_column, range.min_column + column_count - 1);
+	range.max_row = (std::min)(range.max_row, range.min_row + row_count - 1);
+	return range;
+}
+
+size_t Spatial_Hash::GetCellIndex(int column, int row) const
+{
+	column %= column_count;
+	if (column < 0) column += column_count;
+	row %= row_count;
+	if (row < 0) row += row_count;
+	return static_cast<size_t>(row) * column_count + column;
+}
+
+void Spatial_Hash::AddToCells(uint32_t proxy)
+{
+	const Cell_Range& range = proxies[proxy].range;
+	for (int row = range.min_row; row <= range.max_row; row++)
+	{
+		for (int column = range.min_column; column <= range.max_column; column++)
+		{
+			cells[GetCellIndex(column, row)].push_back(proxy);
+		}
+	}
+}
+
+void Spatial_Hash::RemoveFromCells(uint32_t proxy)
+{
+	const Cell_Range& range = proxies[proxy].range;
+	for (int row = range.min_row; row <= range.max_row; row++)
+	{
+		for (int column = range.min_column; column <= range.max_column; column++)
+		{
+			std::vector<uint32_t>& cell = cells[GetCellIndex(column, row)];
+			auto found = std::find(cell.begin(), cell.end(), proxy);
+			if (found == cell.end()) continue;
+			*found = cell.back();
+			cell.pop_back();
+		}
+	}
+}
+
+/*
+	\brief
+	The grid covers the world with a cell to spare on each side, for objects that are partly past the edge before wrapping.
+*/
+World_Simulation::World_Simulation()
+	: broadphase{ { WORLD_MIN_X - BROADPHASE_CELL_SIZE, WORLD_MIN_Y - BROADPHASE_CELL_SIZE },
+		{ WORLD_MAX_X - WORLD_MIN_X + 2 * BROADPHASE_CELL_SIZE, WORLD_MAX_Y - WORLD_MIN_Y + 2 * BROADPHASE_CELL_SIZE }, BROADPHASE_CELL_SIZE }
+{
+}
+
+template <typename T>
+void World_Simulation::RemoveObject(std::vector<T>& objects, std::vector<uint32_t>& object_proxies, size_t index, Object_Kind kind)
+{
+	broadphase.Remove(object_proxies[index]);
+	objects[index] = objects.back();
+	object_proxies[index] = object_proxies.back();
+	objects.pop_back();
+	object_proxies.pop_back();
+	//The object moved into its place has a new index.
+	if (index < objects.size()) broadphase.SetUserData(object_proxies[index], ToUserData(index, kind));
+}
+
+void World_Simulation::AddAsteroid(const Sim_Asteroid& asteroid)
+{
+	asteroid_proxies.push_back(broadphase.Insert(GetBoundingBox(asteroid.position, asteroid.scale), ToUserData(asteroids.size(), KIND_ASTEROID)));
+	asteroids.push_back(asteroid);
+}
+
+void World_Simulation::AddBullet(const Sim_Bullet& bullet, float age)
+{
+	Sim_Bullet moved = bullet;
+	Move(moved.position, moved.velocity, age);
+	if (IsOutsideWorld(moved.position)) return;
+	bullet_proxies.push_back(broadphase.Insert(GetBoundingBox(moved.position, BULLET_SCALE), ToUserData(bullets.size(), KIND_BULLET)));
+	bullets.push_back(moved);
+}
+
+void World_Simulation::SetShip(int player_ID, Sim_Vec2 position, Sim_Vec2 velocity)
+{
+	for (Sim_Ship& ship : ships)
+	{
+		if (ship.player_ID != player_ID) continue;
+		ship.position = position;
+		ship.velocity = velocity;
+		return;
+	}
+	ship_proxies.push_back(broadphase.Insert(GetBoundingBox(position, SHIP_SCALE), ToUserData(ships.size(), KIND_SHIP)));
+	ships.push_back(Sim_Ship{ player_ID, position, velocity });
+}
+
+void World_Simulation::RemoveShip(int player_ID)
+{
+	for (size_t s = 0; s < ships.size(); s++)
+	{
+		if (ships[s].player_ID != player_ID) continue;
+		RemoveObject(ships, ship_proxies, s, KIND_SHIP);
+		return;
+	}
+}
+
+/*
+	\brief
+	Finds every hit during the step first, then applies them earliest first, skipping any whose asteroid or object is already gone.
+	Each bullet and ship only tests the asteroids that share a broadphase cell with its swept box.
+	Then everything left moves, with asteroids and ships wrapping like on the client, and bullets leaving the window removed.
+*/
+void World_Simulation::Step(float delta_time, std::vector<Destruction_Event>& destroyed)
+{
+	//Every object covers its whole movement for the step, so pairs that only meet partway through are still found.
+	for (size_t a = 0; a < asteroids.size(); a++)
+	{
+		broadphase.Update(asteroid_proxies[a], GetSweptBox(GetBoundingBox(asteroids[a].position, asteroids[a].scale), asteroids[a].velocity, delta_time));
+	}
+	for (size_t b = 0; b < bullets.size(); b++)
+	{
+		broadphase.Update(bullet_proxies[b], GetSweptBox(GetBoundingBox(bullets[b].position, BULLET_SCALE), bullets[b].velocity, delta_time));
+	}
+	for (size_t s = 0; s < ships.size(); s++)
+	{
+		broadphase.Update(ship_proxies[s], GetSweptBox(GetBoundingBox(ships[s].position, SHIP_SCALE), ships[s].velocity, delta_time));
+	}
+
+	hits.clear();
+	auto find_hits = [&](Sim_Vec2 position, Sim_Vec2 scale, Sim_Vec2 velocity, size_t object_index, bool is_ship) {
+		Sim_AABB object_box = GetBoundingBox(position, scale);
+		broadphase.Query(GetSweptBox(object_box, velocity, delta_time), [&](uint32_t user_data) {
+			if ((user_data & 3) != KIND_ASTEROID) return;
+			size_t a = user_data >> 2;
+			const Sim_Asteroid& asteroid = asteroids[a];
+			float time{};
+			if (SweepAABB(GetBoundingBox(asteroid.position, asteroid.scale), asteroid.velocity, object_box, velocity, delta_time, time))
+			{
+				hits.push_back(Hit{ time, a, object_index, is_ship });
+			}
+		});
+	};
+	for (size_t b = 0; b < bullets.size(); b++)
+	{
+		find_hits(bullets[b].position, BULLET_SCALE, bullets[b].velocity, b, false);
+	}
+	for (size_t s = 0; s < ships.size(); s++)
+	{
+		find_hits(ships[s].position, SHIP_SCALE, ships[s].velocity, s, true);
+	}
+
+	is_asteroid_destroyed.assign(asteroids.size(), false);
+	is_bullet_destroyed.assign(bullets.size(), false);
+	is_ship_hit.assign(ships.size(), false);
+	//Hits at the same time are ordered by what they hit, not where the broadphase or removals left the objects in their vectors.
+	auto get_hit_key = [this](const Hit& hit) {
+		const Sim_Ship* ship = hit.is_ship ? &ships[hit.object_index] : nullptr;
+		const Sim_Bullet* bullet = hit.is_ship ? nullptr : &bullets[hit.object_index];
+		return std::make_tuple(hit.time, asteroids[hit.asteroid_index].id, hit.is_ship,
+			ship ? ship->player_ID : bullet->player_ID, ship ? 0u : bullet->bullet_ID);
+	};
+	std::sort(hits.begin(), hits.end(), [&](const Hit& lhs, const Hit& rhs) { return get_hit_key(lhs) < get_hit_key(rhs); });
+	for (const Hit& hit : hits)
+	{
+		if (is_asteroid_destroyed[hit.asteroid_index]) continue;
+		std::vector<bool>& is_object_gone = hit.is_ship ? is_ship_hit : is_bullet_destroyed;
+		if (is_object_gone[hit.object_index]) continue;
+		is_asteroid_destroyed[hit.asteroid_index] = true;
+		is_object_gone[hit.object_index] = true;
+		if (hit.is_ship)
+		{
+			Sim_Ship& ship = ships[hit.object_index];
+			destroyed.push_back(Destruction_Event{ ship.player_ID, 0, asteroids[hit.asteroid_index].id });
+			ship.position = Sim_Vec2{};
+			ship.velocity = Sim_Vec2{};
+		}
+		else
+		{
+			const Sim_Bullet& bullet = bullets[hit.object_index];
+			destroyed.push_back(Destruction_Event{ bullet.player_ID, bullet.bullet_ID, asteroids[hit.asteroid_index].id });
+		}
+	}
+	//From the back, so the objects moved into the place of removed ones have already been checked.
+	for (size_t a = asteroids.size(); a-- > 0;)
+	{
+		if (is_asteroid_destroyed[a]) RemoveObject(asteroids, asteroid_proxies, a, KIND_ASTEROID);
+	}
+	for (size_t b = bullets.size(); b-- > 0;)
+	{
+		if (is_bullet_destroyed[b]) RemoveObject(bullets, bullet_proxies, b, KIND_BULLET);
+	}
+
+	for (Sim_Asteroid& asteroid : asteroids)
+	{
+		Move(asteroid.position, asteroid.velocity, delta_time);
+		asteroid.position.x = WrapValue(asteroid.position.x, WORLD_MIN_X - asteroid.scale.x, WORLD_MAX_X + asteroid.scale.x);
+		asteroid.position.y = WrapValue(asteroid.position.y, WORLD_MIN_Y - asteroid.scale.y, WORLD_MAX_Y + asteroid.scale.y);
+	}
+	for (size_t b = bullets.size(); b-- > 0;)
+	{
+		Move(bullets[b].position, bullets[b].velocity, delta_time);
+		if (IsOutsideWorld(bullets[b].position)) RemoveObject(bullets, bullet_proxies, b, KIND_BULLET);
+	}
+	for (Sim_Ship& ship : ships)
+	{
+		Move(ship.position, ship.velocity, delta_time);
+		ship.position.x = WrapValue(ship.position.x, WORLD_MIN_X - SHIP_SCALE.x, WORLD_MAX_X + SHIP_SCALE.x);
+		ship.position.y = WrapValue(ship.position.y, WORLD_MIN_Y - SHIP_SCALE.y, WORLD_MAX_Y + SHIP_SCALE.y);
+	}
+}
@@ -0,0 +1,256 @@
+/* Start Header
+*****************************************************************/
+/*!
+\file Simulation.hpp
+\author Joel Lee Jie
+\date 16 October 2026
+\brief
+This file declares the headless world simulation the server runs every tick: asteroids, bullets and ships
+moving with the same wrap rules as the client, and swept AABB collision between them.
+The server decides every hit, so clients only apply the destruction events it sends.
+It doesn't depend on AlphaEngine.
+
+Copyright (C) 2025 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the
+prior written consent of DigiPen Institute of Technology is prohibited.
+*/
+/* End Header
+*******************************************************************/
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Sim_Vec2
+{
+	float x{}, y{};
+};
+
+//Axis aligned bounding box.
+struct Sim_AABB
+{
+	Sim_Vec2 min{}, max{};
+};
+
+//The client's 800x600 window, centred on the origin (AEGfxGetWinMinX() to AEGfxGetWinMaxX() and so on).
+constexpr float WORLD_MIN_X = -400.0f;
+constexpr float WORLD_MAX_X = 400.0f;
+constexpr float WORLD_MIN_Y = -300.0f;
+constexpr float WORLD_MAX_Y = 300.0f;
+//Same sizes as the client draws, for their bounding boxes.
+constexpr Sim_Vec2 SHIP_SCALE{ 16.0f, 16.0f };
+constexpr Sim_Vec2 BULLET_SCALE{ 20.0f, 3.0f };
+//Width and height of each broadphase cell, a little over the largest asteroid.
+constexpr float BROADPHASE_CELL_SIZE = 64.0f;
+
+struct Sim_Asteroid
+{
+	unsigned int id{};
+	Sim_Vec2 position{}, velocity{}, scale{};
+};
+
+struct Sim_Bullet
+{
+	int player_ID{}; //Player that fired it.
+	unsigned int bullet_ID{}; //Only unique per player, starting from 1.
+	Sim_Vec2 position{}, velocity{};
+};
+
+struct Sim_Ship
+{
+	int player_ID{};
+	Sim_Vec2 position{}, velocity{};
+};
+
+/*
+	An asteroid destroyed on a tick, and what destroyed it.
+	object_ID is the ID of player_ID's bullet, or 0 if it hit player_ID's ship.
+*/
+struct Destruction_Event
+{
+	int player_ID{};
+	unsigned int object_ID{};
+	unsigned int asteroid_ID{};
+};
+
+/*
+	\brief
+	Bounding box of an object at position, scale wide and tall (as the client computes it).
+*/
+Sim_AABB GetBoundingBox(Sim_Vec2 position, Sim_Vec2 scale);
+/*
+	\brief
+	Checks if two moving boxes touch within max_time, from box1 moving at vel1 and box2 moving at vel2.
+	Same test as CollisionIntersection_RectRect() on the client, without AlphaEngine.
+	\return
+	true if they do, with time_of_collision set to when they first touch (0 if they already overlap).
+*/
+bool SweepAABB(const Sim_AABB& box1, Sim_Vec2 vel1, const Sim_AABB& box2, Sim_Vec2 vel2, float max_time, float& time_of_collision);
+/*
+	\brief
+	Wraps x that has gone past x0 or x1 to the other end, like AEWrap().
+*/
+float WrapValue(float x, float x0, float x1);
+
+/*
+	Uniform grid broadphase, which finds the objects near a box without testing every object.
+	Each object is listed in every cell its box covers. Cell coordinates wrap around the grid (toroidally),
+	so objects that have wrapped past the edge of the world still land in a cell instead of piling up in the edge cells.
+	Boxes are usually swept boxes (covering the whole movement of the step), so every pair that can collide during it shares a cell.
+	Updates are incremental: an object only moves between cells when the range of cells it covers changes.
+*/
+class Spatial_Hash
+{
+public:
+	/*
+		\brief
+		Covers size from origin with cells cell_size wide and tall (at least one of each).
+	*/
+	Spatial_Hash(Sim_Vec2 origin, Sim_Vec2 size, float cell_size);
+
+	/*
+		\brief
+		Adds an object covering box, with user_data given back when it is found by Query().
+		\return
+		Handle of the object, for updating and removing it. Handles of removed objects are reused.
+	*/
+	uint32_t Insert(const Sim_AABB& box, uint32_t user_data);
+	//Moves the object to the cells box covers, if they differ from the cells it's in.
+	void Update(uint32_t proxy, const Sim_AABB& box);
+	void Remove(uint32_t proxy);
+	void SetUserData(uint32_t proxy, uint32_t user_data) { proxies[proxy].user_data = user_data; }
+
+	/*
+		\brief
+		Calls visit(user_data) once for every object that shares a cell with box.
+		Objects found may not overlap box, so they still need an exact test.
+	*/
+	template <typename Visitor>
+	void Query(const Sim_AABB& box, Visitor&& visit)
+	{
+		//Stamped on each object found, so objects in more than one of the cells are only visited once.
+		query_stamp++;
+		Cell_Range range = GetCellRange(box);
+		for (int row = range.min_row; row <= range.max_row; row++)
+		{
+			for (int column = range.min_column; column <= range.max_column; column++)
+			{
+				for (uint32_t proxy : cells[GetCellIndex(column, row)])
+				{
+					Proxy& found = proxies[proxy];
+					if (found.stamp == query_stamp) continue;
+					found.stamp = query_stamp;
+					visit(found.user_data);
+				}
+			}
+		}
+	}
+
+	size_t GetCellCount() const { return cells.size(); }
+
+private:
+	//Unwrapped cell coordinates covered by a box, capped so they never cover the same cell twice.
+	struct Cell_Range
+	{
+		int min_column, min_row, max_column, max_row;
+		bool operator==(const Cell_Range& rhs) const
+		{
+			return min_column == rhs.min_column && min_row == rhs.min_row && max_column == rhs.max_column && max_row == rhs.max_row;
+		}
+	};
+	struct Proxy
+	{
+		uint32_t user_data{};
+		Cell_Range range{};
+		uint32_t stamp{};
+	};
+
+	Cell_Range GetCellRange(const Sim_AABB& box) const;
+	size_t GetCellIndex(int column, int row) const;
+	void AddToCells(uint32_t proxy);
+	void RemoveFromCells(uint32_t proxy);
+
+	Sim_Vec2 origin{};
+	float cell_size{};
+	int column_count{}, row_count{};
+	//Handles of the objects in each cell, row by row.
+	std::vector<std::vector<uint32_t>> cells{};
+	std::vector<Proxy> proxies{};
+	std::vector<uint32_t> free_proxies{};
+	uint32_t query_stamp{ 0 };
+};
+
+/*
+	The world as the server sees it.
+	Asteroids are only created by the server. Bullets are added as players fire them.
+	Ships follow the latest transform their player sent, carrying on at its velocity until the next one.
+	Collision pairs come from a Spatial_Hash, so a step costs about the number of objects, not asteroids times bullets.
+*/
+class World_Simulation
+{
+public:
+	World_Simulation();
+
+	void AddAsteroid(const Sim_Asteroid& asteroid);
+	/*
+		Adds a bullet fired age seconds ago, moved forward to where it should be now.
+		Dropped if it has already left the window.
+	*/
+	void AddBullet(const Sim_Bullet& bullet, float age);
+	//Moves the ship to the transform its player sent, adding it if it isn't in the world yet.
+	void SetShip(int player_ID, Sim_Vec2 position, Sim_Vec2 velocity);
+	void RemoveShip(int player_ID);
+	/*
+		\brief
+		Moves the world forward by delta_time seconds.
+		Every asteroid that a bullet or ship touches during it is destroyed, along with the bullet.
+		A ship that is hit goes back to the centre of the window, as the client does.
+		When one object could hit several asteroids (or the reverse), the earliest hit wins.
+		Pairs are found with the broadphase, then checked with SweepAABB().
+		\param[out] destroyed
+		Appended with an event for each asteroid destroyed.
+	*/
+	void Step(float delta_time, std::vector<Destruction_Event>& destroyed);
+
+	const std::vector<Sim_Asteroid>& GetAsteroids() const { return asteroids; }
+	size_t GetBulletCount() const { return bullets.size(); }
+
+private:
+	/*
+		A bullet or ship (object_index into bullets or ships) that touches asteroid_index during the step.
+	*/
+	struct Hit
+	{
+		float time;
+		size_t asteroid_index;
+		size_t object_index;
+		bool is_ship;
+	};
+
+	//What a broadphase entry is, kept in its user data with the object's index: (index << 2) | kind.
+	enum Object_Kind : uint32_t
+	{
+		KIND_ASTEROID,
+		KIND_BULLET,
+		KIND_SHIP
+	};
+	static uint32_t ToUserData(size_t index, Object_Kind kind) { return static_cast<uint32_t>(index << 2) | kind; }
+	/*
+		Removes the object at index (of the kind given) and its broadphase entry, moving the last object into its place.
+	*/
+	template <typename T>
+	void RemoveObject(std::vector<T>& objects, std::vector<uint32_t>& object_proxies, size_t index, Object_Kind kind);
+
+	std::vector<Sim_Asteroid> asteroids{};
+	std::vector<Sim_Bullet> bullets{};
+	std::vector<Sim_Ship> ships{};
+	//Broadphase entry of each object, same index as the objects.
+	std::vector<uint32_t> asteroid_proxies{}, bullet_proxies{}, ship_proxies{};
+	Spatial_Hash broadphase;
+	//Kept between steps, so they don't allocate every tick.
+	std::vector<Hit> hits{};
+	std::vector<bool> is_asteroid_destroyed{}, is_bullet_destroyed{}, is_ship_hit{};
+};
+
+#endif
@@ -18,6 +18,13 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 #include <fstream>
 #include <array>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 /*
 	\brief
 	Write to UDP socket. Shouldn't be called by multiple threads at the same time.
@@ -32,18 +39,18 @@ int WriteToSocket(SOCKET udp_socket, sockaddr_storage& addrDest, char* data, siz
 	{
 		//All data sent.
 		if (offset >= num_bytes) break;
-		int num_bytes_sent = sendto(udp_socket, data + offset, static_cast<int>(num_bytes - offset), 0, (sockaddr*)&addrDest, sizeof(addrDest));
+		int num_bytes_sent = static_cast<int>(sendto(udp_socket, data + offset, static_cast<int>(num_bytes - offset), 0, (sockaddr*)&addrDest, GetSockAddrLength(addrDest)));
 		//Operation could be blocking, check to see what is the error.
 		if (num_bytes_sent == SOCKET_ERROR)
 		{
-			size_t errorCode = WSAGetLastError();
+			int errorCode = GetLastSocketError();
 			//Blocking, just sleep and continue.
-			if (errorCode == WSAEWOULDBLOCK)
+			if (IsWouldBlockError(errorCode))
 			{
 				continue;
 			}
 			//Gracefully closed
-			else if (errorCode == WSAESHUTDOWN)
+			else if (IsShutdownError(errorCode))
 			{
 				return 0;
 			}
@@ -63,27 +70,1257 @@ int WriteToSocket(SOCKET udp_socket, sockaddr_storage& addrDest, char* data, siz
 
 /*
 	\brief
-	Checks and returns if packet checksum is valid, and the sequence number of the packet.
-	Returns -1 if checksum is invalid, sequence number if it is valid.
-
-	Do not pass in if data is < 6 bytes.
+	Checks if datagram checksum is valid, then reads the header and splits the datagram into its frames.
+	Returns false if checksum is invalid, the datagram is too short to have a header, or a frame runs past the end.
 
 	\param data
-	The entire data inclusive of checksum.
+	The entire data inclusive of header.
 	\param length_of_data
-	The length of the entire data inclusive of checksum
+	The length of the entire data inclusive of header.
+*/
+bool ReadDatagram(char* data, size_t length_of_data, Packet_Header& header, std::vector<Frame>& frames)
+{
+	if (length_of_data < DATAGRAM_HEADER_SIZE) return false;
+	uint8_t integrity_mode = static_cast<uint8_t>(data[0]);
+	if (integrity_mode >= INTEGRITY_MODE_COUNT) return false;
+	uint32_t integrity_value{};
+	memcpy_s(&integrity_value, 4, data + 1, 4);
+	integrity_value = ntohl(integrity_value);
+	header.integrity_mode = static_cast<IntegrityMode>(integrity_mode);
+	if (!ValidateIntegrity(header.integrity_mode, length_of_data - INTEGRITY_COVERAGE_OFFSET, data + INTEGRITY_COVERAGE_OFFSET, integrity_value)) return false;
+
+	uint32_t ack_number{}, ack_bits{};
+	memcpy_s(&ack_number, 4, data + INTEGRITY_COVERAGE_OFFSET, 4);
+	memcpy_s(&ack_bits, 4, data + INTEGRITY_COVERAGE_OFFSET + 4, 4);
+	header.ack_number = static_cast<int>(ntohl(ack_number));
+	header.ack_bits = ntohl(ack_bits);
+
+	//Split the rest of the datagram into its frames, [Length, 2][Sequence Number, 4][message].
+	size_t offset = DATAGRAM_HEADER_SIZE;
+	while (offset < length_of_data)
+	{
+		if (length_of_data - offset < FRAME_HEADER_SIZE) return false;
+		uint16_t length{};
+		uint32_t sequence_number{};
+		memcpy_s(&length, 2, data + offset, 2);
+		memcpy_s(&sequence_number, 4, data + offset + 2, 4);
+		length = ntohs(length);
+		offset += FRAME_HEADER_SIZE;
+		//Integrity check passed, so this shouldn't happen unless the sender is faulty.
+		if (length_of_data - offset < length) return false;
+
+		Frame frame{};
+		frame.sequence_number = static_cast<int>(ntohl(sequence_number));
+		frame.message.assign(data + offset, data + offset + length);
+		frames.push_back(std::move(frame));
+		offset += length;
+	}
+	return true;
+}
+
+/*
+	\brief
+	Encodes the message as a frame, in a datagram of its own with space reserved for the datagram header.
+	Format: [Integrity Mode, 1][Integrity Value, 4][ACK, 4][ACK Bits, 4][Length, 2][Sequence Number, 4][message]
+*/
+Encoded_Frame EncodeFrame(int sequence_number, const std::string& message)
+{
+	Encoded_Frame frame{};
+	frame.datagram.assign(DATAGRAM_HEADER_SIZE + FRAME_HEADER_SIZE + message.size(), '\0');
+	char* data = frame.datagram.data();
+	uint16_t network_length = htons(static_cast<uint16_t>(message.size()));
+	uint32_t network_sequence_number = htonl(sequence_number);
+	memcpy_s(data + DATAGRAM_HEADER_SIZE, 2, &network_length, 2);
+	memcpy_s(data + DATAGRAM_HEADER_SIZE + 2, 4, &network_sequence_number, 4);
+	memcpy_s(data + DATAGRAM_HEADER_SIZE + FRAME_HEADER_SIZE, message.size(), message.data(), message.size());
+	frame.frame_sum = CalculateChecksumSum(frame.datagram.size() - DATAGRAM_HEADER_SIZE, data + DATAGRAM_HEADER_SIZE);
+
+	//Checksum of the datagram with the ACK fields still zero, so only the ACKs need to be added in when sent.
+	data[0] = static_cast<char>(INTEGRITY_SUM16);
+	uint32_t checksum = htonl(static_cast<uint16_t>(~frame.frame_sum));
+	memcpy_s(data + 1, 4, &checksum, 4);
+	return frame;
+}
+
+/*
+	\brief
+	Moves messages from the queue into the send window, giving each one a sequence number.
+	Stops when the window is full.
+*/
+void Reliable_Transfer::FillSendWindow(std::queue<std::string>& messages_to_send, int window_size)
+{
+	while (!messages_to_send.empty() && static_cast<int>(send_window.size()) < window_size)
+	{
+		//Nothing to send for empty messages, so don't waste a sequence number.
+		if (!messages_to_send.front().empty())
+		{
+			Packet_In_Flight packet{};
+			packet.sequence_number = next_sequence_number++;
+			//Encoded once here, so resending it only needs the ACKs to be updated.
+			packet.encoded = EncodeFrame(packet.sequence_number, messages_to_send.front());
+			send_window.push_back(std::move(packet));
+		}
+		messages_to_send.pop();
+	}
+}
+
+/*
+	\brief
+	Adds every packet in the window that is new or has timed out to frames, and resets their timeout.
+*/
+void Reliable_Transfer::GetFramesToSend(Ticks current_time, std::vector<Encoded_Frame*>& frames)
+{
+	bool has_timed_out = false;
+	for (Packet_In_Flight& packet : send_window)
+	{
+		if (packet.is_acked) continue;
+		//Only resend the packets that have timed out, the rest are still waiting for their ACK.
+		if (packet.times_sent > 0 && current_time - packet.time_last_sent > retransmission_timeout)
+		{
+			packet.toSend = true;
+			has_timed_out = true;
+		}
+		if (!packet.toSend) continue;
+
+		packet.toSend = false;
+		packet.time_last_sent = current_time;
+		packet.times_sent++;
+		frames.push_back(&packet.encoded);
+	}
+	//Back off once per pass (not per packet), since the packets were likely lost to the same congestion.
+	if (has_timed_out)
+	{
+		retransmission_timeout = (std::min)(retransmission_timeout * 2, MAX_TIMEOUT_TIMER);
+	}
+}
+
+/*
+	\brief
+	Marks the packet with the ACK number as received, then slides the window past every ACK'd packet in front.
+	Returns false if no packet in the window has this ACK number (e.g. duplicate ACK).
+*/
+bool Reliable_Transfer::ReceiveAck(int ack_number, Ticks current_time)
+{
+	if (send_window.empty()) return false;
+	//Sequence numbers in the window are contiguous, so the packet can be found by its offset from the base.
+	int index = ack_number - send_window.front().sequence_number;
+	if (index < 0 || index >= static_cast<int>(send_window.size())) return false;
+	Packet_In_Flight& packet = send_window[index];
+	if (packet.is_acked) return false;
+	packet.is_acked = true;
+	//Can't tell which send a resent packet's ACK belongs to, so only measure packets that were sent once.
+	if (packet.times_sent == 1) AddRTTSample(current_time - packet.time_last_sent);
+
+	//Slide the window forward, so that new packets can be sent.
+	while (!send_window.empty() && send_window.front().is_acked)
+	{
+		send_window.pop_front();
+	}
+	return true;
+}
+
+/*
+	\brief
+	Marks every packet ACK'd by a received header (the ACK number and the ACK bits) as received.
+*/
+void Reliable_Transfer::ReceiveAckBits(int ack_number, uint32_t ack_bits, Ticks current_time)
+{
+	//Other side hasn't received anything yet.
+	if (ack_number < 0) return;
+	ReceiveAck(ack_number, current_time);
+	for (int i = 0; i < 32; i++)
+	{
+		if (ack_bits & (1u << i)) ReceiveAck(ack_number - 1 - i, current_time);
+	}
+}
+
+/*
+	\brief
+	Updates the smoothed RTT and RTT variance with a new sample, then recalculates the timeout.
+*/
+void Reliable_Transfer::AddRTTSample(Ticks rtt_sample)
+{
+	if (smoothed_rtt < 0)
+	{
+		//First sample.
+		smoothed_rtt = rtt_sample;
+		rtt_variance = rtt_sample / 2;
+	}
+	else
+	{
+		//Variance is updated first, as it uses the previous smoothed RTT.
+		//Gains of 1/4 and 1/8, rounding to the nearest tick.
+		Ticks deviation = smoothed_rtt > rtt_sample ? smoothed_rtt - rtt_sample : rtt_sample - smoothed_rtt;
+		rtt_variance = (3 * rtt_variance + deviation + 2) / 4;
+		smoothed_rtt = (7 * smoothed_rtt + rtt_sample + 4) / 8;
+	}
+	//A new sample also undoes any backoff.
+	retransmission_timeout = smoothed_rtt + (std::max)(CLOCK_GRANULARITY, 4 * rtt_variance);
+	retransmission_timeout = (std::max)(retransmission_timeout, MIN_TIMEOUT_TIMER);
+	retransmission_timeout = (std::min)(retransmission_timeout, MAX_TIMEOUT_TIMER);
+}
+
+/*
+	\brief
+	Buffers a received packet, and moves every packet that is now in order into packets_in_order.
+	Duplicates are ignored, but still set the ACK to be sent since the previous ACK might have been lost.
+	\return
+	false if the packet is too far ahead of the window, in which case it should be dropped without an ACK.
+*/
+bool Reliable_Transfer::ReceivePacket(int sequence_number, const std::string& data, std::vector<std::string>& packets_in_order, Ticks current_time)
+{
+	if (sequence_number > ack_last_packet_received + RECV_WINDOW_SIZE) return false;
+	//Start the delay from the first packet that hasn't been ACK'd, so the delay isn't pushed back by every new packet.
+	if (!is_ack_pending) time_ack_pending = current_time;
+	is_ack_pending = true;
+	//Already delivered.
+	if (sequence_number <= ack_last_packet_received) return true;
+	highest_sequence_received = (std::max)(highest_sequence_received, sequence_number);
+	//emplace does nothing if it's a duplicate of a buffered packet.
+	out_of_order_packets.emplace(sequence_number, data);
+
+	//Deliver every packet that is now in order.
+	auto iter = out_of_order_packets.begin();
+	while (iter != out_of_order_packets.end() && iter->first == ack_last_packet_received + 1)
+	{
+		packets_in_order.push_back(std::move(iter->second));
+		ack_last_packet_received++;
+		iter = out_of_order_packets.erase(iter);
+	}
+	return true;
+}
+
+/*
+	\brief
+	Returns true if a received packet has waited ACK_DELAY without any outgoing packet to carry its ACK.
+	A standalone ACK should then be sent.
 */
-int ReadChecksumAndNumber(char* data, size_t length_of_data_with_checksum)
+bool Reliable_Transfer::IsStandaloneAckDue(Ticks current_time) const
 {
-	if (length_of_data_with_checksum < 6) return -1;
-	uint16_t checksum{};
-	memcpy_s(&checksum, 2, data, 2);
-	uint32_t sequence_number{};
-	memcpy_s(&sequence_number, 4, data + 2, 4);
-	checksum = ntohs(checksum);
-	sequence_number = ntohl(sequence_number);
-	if (ValidateChecksum(length_of_data_with_checksum - 2, data + 2, checksum)) return sequence_number;
-	return -1;
+	return is_ack_pending && current_time - time_ack_pending >= ACK_DELAY;
+}
+
+/*
+	\brief
+	Returns the earliest of the packets' send or resend times and the standalone ACK time.
+*/
+Ticks Reliable_Transfer::GetNextSendTime() const
+{
+	Ticks next_send_time = TICKS_NEVER;
+	if (is_ack_pending) next_send_time = time_ack_pending + ACK_DELAY;
+	for (const Packet_In_Flight& packet : send_window)
+	{
+		if (packet.is_acked) continue;
+		//Not sent yet, so it's due straight away.
+		if (packet.toSend || packet.times_sent == 0) return 0;
+		next_send_time = (std::min)(next_send_time, packet.time_last_sent + retransmission_timeout);
+	}
+	return next_send_time;
+}
+
+/*
+	\brief
+	Packs the frames in order into as few datagrams as possible (each up to MAX_PACKET_SIZE),
+	with the ACKs of every packet received so far in each header.
+	For INTEGRITY_SUM16, checksums are built from the header and the sum of each frame, so no frame is summed again.
+	CRC32C and the hash can't be combined like that, so they are calculated over each datagram as it is sent.
+*/
+std::vector<std::string> Reliable_Transfer::AssembleDatagrams(const std::vector<Encoded_Frame*>& frames)
+{
+	std::vector<std::string> datagrams{};
+	if (frames.empty()) return datagrams;
+
+	Packet_Header header{};
+	header.ack_number = highest_sequence_received;
+	//Everything up till ack_last_packet_received has been received, the rest have to be checked against the buffered packets.
+	for (int i = 0; i < 32; i++)
+	{
+		int number = highest_sequence_received - 1 - i;
+		if (number < 0) break;
+		if (number <= ack_last_packet_received || out_of_order_packets.count(number))
+		{
+			header.ack_bits |= (1u << i);
+		}
+	}
+	is_ack_pending = false;
+
+	//[ACK, 4][ACK Bits, 4], the part of the header after the integrity value.
+	constexpr int ACK_FIELDS_SIZE = DATAGRAM_HEADER_SIZE - INTEGRITY_COVERAGE_OFFSET;
+	char ack_fields[ACK_FIELDS_SIZE]{};
+	uint32_t network_ack_number = htonl(header.ack_number);
+	uint32_t network_ack_bits = htonl(header.ack_bits);
+	memcpy_s(ack_fields, 4, &network_ack_number, 4);
+	memcpy_s(ack_fields + 4, 4, &network_ack_bits, 4);
+
+	size_t begin = 0;
+	while (begin < frames.size())
+	{
+		//Take as many frames as fit in the datagram (at least one).
+		size_t end = begin;
+		size_t datagram_size = DATAGRAM_HEADER_SIZE;
+		while (end < frames.size())
+		{
+			size_t frame_size = frames[end]->datagram.size() - DATAGRAM_HEADER_SIZE;
+			if (end > begin && datagram_size + frame_size > MAX_PACKET_SIZE) break;
+			datagram_size += frame_size;
+			end++;
+		}
+
+		std::string datagram{};
+		if (end - begin == 1)
+		{
+			/*
+				Frame is sent on its own, so reuse its datagram.
+				For INTEGRITY_SUM16, only the ACK fields change, so update the checksum for each changed word instead of summing the whole datagram (RFC 1624).
+			*/
+			std::string& frame_datagram = frames[begin]->datagram;
+			unsigned char* data = reinterpret_cast<unsigned char*>(frame_datagram.data());
+			if (integrity_mode == INTEGRITY_SUM16 && data[0] == INTEGRITY_SUM16)
+			{
+				uint16_t checksum = static_cast<uint16_t>((data[3] << 8) | data[4]);
+				for (int i = 0; i < ACK_FIELDS_SIZE; i += 2)
+				{
+					unsigned char* field = data + INTEGRITY_COVERAGE_OFFSET + i;
+					uint16_t old_value = static_cast<uint16_t>((field[0] << 8) | field[1]);
+					uint16_t new_value = static_cast<uint16_t>((static_cast<unsigned char>(ack_fields[i]) << 8) | static_cast<unsigned char>(ack_fields[i + 1]));
+					if (old_value != new_value) checksum = UpdateChecksum(checksum, old_value, new_value);
+				}
+				data[3] = static_cast<unsigned char>(checksum >> 8);
+				data[4] = static_cast<unsigned char>(checksum & 0xFF);
+				memcpy_s(data + INTEGRITY_COVERAGE_OFFSET, ACK_FIELDS_SIZE, ack_fields, ACK_FIELDS_SIZE);
+				datagrams.push_back(frame_datagram);
+				begin = end;
+				continue;
+			}
+			//Otherwise the integrity value is calculated below, on a copy so the cached checksum stays valid.
+			datagram = frame_datagram;
+			memcpy_s(datagram.data() + INTEGRITY_COVERAGE_OFFSET, ACK_FIELDS_SIZE, ack_fields, ACK_FIELDS_SIZE);
+		}
+		else
+		{
+			//Copy each frame after the header.
+			datagram.assign(datagram_size, '\0');
+			memcpy_s(datagram.data() + INTEGRITY_COVERAGE_OFFSET, ACK_FIELDS_SIZE, ack_fields, ACK_FIELDS_SIZE);
+			size_t offset = DATAGRAM_HEADER_SIZE;
+			for (size_t i = begin; i < end; i++)
+			{
+				const std::string& frame_datagram = frames[i]->datagram;
+				size_t frame_size = frame_datagram.size() - DATAGRAM_HEADER_SIZE;
+				memcpy_s(datagram.data() + offset, frame_size, frame_datagram.data() + DATAGRAM_HEADER_SIZE, frame_size);
+				offset += frame_size;
+			}
+		}
+
+		uint32_t integrity_value{};
+		if (integrity_mode == INTEGRITY_SUM16)
+		{
+			//Add the sum of each frame to the sum of the ACK fields. The frame is offset by a byte if it starts at an odd offset from the covered part.
+			uint16_t sum = CalculateChecksumSum(ACK_FIELDS_SIZE, ack_fields);
+			size_t offset = DATAGRAM_HEADER_SIZE;
+			for (size_t i = begin; i < end; i++)
+			{
+				sum = AddChecksumSums(sum, frames[i]->frame_sum, (offset - INTEGRITY_COVERAGE_OFFSET) % 2 == 1);
+				offset += frames[i]->datagram.size() - DATAGRAM_HEADER_SIZE;
+			}
+			integrity_value = static_cast<uint16_t>(~sum);
+		}
+		else
+		{
+			integrity_value = CalculateIntegrity(integrity_mode, datagram.size() - INTEGRITY_COVERAGE_OFFSET, datagram.data() + INTEGRITY_COVERAGE_OFFSET);
+		}
+		datagram[0] = static_cast<char>(integrity_mode);
+		uint32_t network_integrity_value = htonl(integrity_value);
+		memcpy_s(datagram.data() + 1, 4, &network_integrity_value, 4);
+		datagrams.push_back(std::move(datagram));
+		begin = end;
+	}
+	return datagrams;
+}
+
+/*
+	\brief
+	Adds the sequence number in front of the message.
+*/
+std::string Sequenced_Transfer::EncodeMessage(const std::string& message)
+{
+	char sequence_buffer[4]{};
+	uint32_t network_sequence_number = htonl(next_sequence_number++);
+	memcpy_s(sequence_buffer, 4, &network_sequence_number, 4);
+	return std::string(sequence_buffer, sequence_buffer + 4) + message;
+}
+
+/*
+	\brief
+	Keeps the message only if it's newer than the latest one, since older state is already out of date.
+*/
+bool Sequenced_Transfer::ReceiveMessage(const char* data, size_t length_of_data)
+{
+	if (length_of_data < 4) return false;
+	uint32_t network_sequence_number{};
+	memcpy_s(&network_sequence_number, 4, data, 4);
+	int sequence_number = (int)ntohl(network_sequence_number);
+	//Duplicate or arrived after a newer message.
+	if (sequence_number <= last_sequence_received) return false;
+
+	last_sequence_received = sequence_number;
+	latest_message.assign(data + 4, data + length_of_data);
+	is_latest_message_new = true;
+	return true;
+}
+
+/*
+	\brief
+	Each message is only taken once, so the same state isn't applied twice.
+*/
+std::string Sequenced_Transfer::TakeLatestMessage()
+{
+	if (!is_latest_message_new) return std::string{};
+	is_latest_message_new = false;
+	return latest_message;
+}
+
+/*
+	\brief
+	Copies the fragment into its message at (index * FRAGMENT_DATA_SIZE), returning the message once it's complete.
+	A fragment of a newer message drops the partial messages that are now more than MESSAGE_ID_WINDOW behind,
+	and a new message past MAX_PARTIAL_MESSAGES drops the oldest one.
+*/
+bool Message_Reassembler::ReceiveFragment(const char* data, size_t length_of_data, std::string& complete_message)
+{
+	if (length_of_data < FRAGMENT_HEADER_SIZE) return false;
+	uint16_t message_id{}, fragment_index{}, fragment_count{};
+	memcpy_s(&message_id, 2, data, 2);
+	memcpy_s(&fragment_index, 2, data + 2, 2);
+	memcpy_s(&fragment_count, 2, data + 4, 2);
+	message_id = ntohs(message_id);
+	fragment_index = ntohs(fragment_index);
+	fragment_count = ntohs(fragment_count);
+	size_t fragment_size = length_of_data - FRAGMENT_HEADER_SIZE;
+	bool is_last_fragment = (fragment_index + 1 == fragment_count);
+	//Only the last fragment can be shorter than FRAGMENT_DATA_SIZE.
+	if (fragment_index >= fragment_count || fragment_count > MAX_FRAGMENT_COUNT || fragment_size > FRAGMENT_DATA_SIZE) return false;
+	if (!is_last_fragment && fragment_size != FRAGMENT_DATA_SIZE) return false;
+
+	//How far a message ID is behind the newest, 0 for the newest itself.
+	auto distance_behind = [this](uint16_t id) { return static_cast<uint16_t>(next_message_id - 1 - id); };
+	//Newer than every message so far (within half the ID range, as IDs wrap around).
+	if (static_cast<uint16_t>(message_id - next_message_id) < 0x8000)
+	{
+		next_message_id = static_cast<uint16_t>(message_id + 1);
+		for (auto iter = partial_messages.begin(); iter != partial_messages.end(); )
+		{
+			if (distance_behind(iter->first) > MESSAGE_ID_WINDOW) iter = partial_messages.erase(iter);
+			else iter++;
+		}
+	}
+	else if (distance_behind(message_id) > MESSAGE_ID_WINDOW) return false;
+
+	if (partial_messages.find(message_id) == partial_messages.end() && partial_messages.size() >= MAX_PARTIAL_MESSAGES)
+	{
+		auto oldest = partial_messages.begin();
+		for (auto iter = partial_messages.begin(); iter != partial_messages.end(); iter++)
+		{
+			if (distance_behind(iter->first) > distance_behind(oldest->first)) oldest = iter;
+		}
+		partial_messages.erase(oldest);
+	}
+	Partial_Message& message = partial_messages[message_id];
+	if (message.is_fragment_received.empty())
+	{
+		//First fragment of the message to arrive, so make space for all of them.
+		message.data.resize(static_cast<size_t>(fragment_count) * FRAGMENT_DATA_SIZE);
+		message.is_fragment_received.resize(fragment_count, false);
+	}
+	//Fragment count doesn't match the other fragments of the message.
+	if (message.is_fragment_received.size() != fragment_count) return false;
+	if (message.is_fragment_received[fragment_index]) return false;
+
+	message.is_fragment_received[fragment_index] = true;
+	message.fragments_received++;
+	memcpy_s(message.data.data() + static_cast<size_t>(fragment_index) * FRAGMENT_DATA_SIZE, fragment_size, data + FRAGMENT_HEADER_SIZE, fragment_size);
+	if (is_last_fragment) message.size = static_cast<size_t>(fragment_index) * FRAGMENT_DATA_SIZE + fragment_size;
+	if (message.fragments_received < fragment_count) return false;
+
+	//All fragments received.
+	message.data.resize(message.size);
+	complete_message = std::move(message.data);
+	partial_messages.erase(message_id);
+	return true;
+}
+
+static_assert((PACKET_RING_CAPACITY & (PACKET_RING_CAPACITY - 1)) == 0, "PACKET_RING_CAPACITY must be a power of 2.");
+
+/*
+	\brief
+	Allocates every slot, each free for its position in the first lap.
+*/
+Packet_Ring::Packet_Ring() : slots{ new Slot[PACKET_RING_CAPACITY] }
+{
+	for (size_t i = 0; i < PACKET_RING_CAPACITY; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+/*
+	\brief
+	Claims the slot at push_position (if it's free), copies the datagram in, then marks it as holding a datagram.
+	Wakes the handling thread if it's asleep (unless told not to).
+*/
+bool Packet_Ring::Push(const sockaddr_storage& addr, const char* data, int length, bool wake_consumer)
+{
+	if (length < 0 || length > MAX_BUFFER_SIZE) return false;
+	size_t position = push_position.load(std::memory_order_relaxed);
+	Slot* slot{};
+	while (true)
+	{
+		slot = &slots[position & (PACKET_RING_CAPACITY - 1)];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		if (sequence == position)
+		{
+			//Slot is free, claim it unless another thread claimed it first.
+			if (push_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+		}
+		//Slot still holds a datagram from the last lap, so the ring is full.
+		else if (sequence < position) return false;
+		//Another thread pushed here first, so try the next position.
+		else position = push_position.load(std::memory_order_relaxed);
+	}
+
+	slot->datagram.addr = addr;
+	slot->datagram.length = length;
+	memcpy_s(slot->datagram.data, MAX_BUFFER_SIZE, data, length);
+	slot->sequence.store(position + 1, std::memory_order_release);
+	if (!wake_consumer) return true;
+
+	//The fence pairs with the one in WaitForDatagrams(), so either the handler sees the datagram or this sees the handler waiting.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (is_handler_waiting.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock{ wait_lock };
+		wait_condition.notify_one();
+	}
+	return true;
+}
+
+/*
+	\brief
+	Collects the slots from pop_position that hold a datagram, stopping at the first that doesn't.
+*/
+size_t Packet_Ring::PeekBatch(Queued_Datagram** datagrams, size_t max_count)
+{
+	size_t count = 0;
+	while (count < max_count)
+	{
+		Slot& slot = slots[(pop_position + count) & (PACKET_RING_CAPACITY - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != pop_position + count + 1) break;
+		datagrams[count++] = &slot.datagram;
+	}
+	return count;
+}
+
+/*
+	\brief
+	Marks the slots as free for their position in the next lap.
+*/
+void Packet_Ring::PopBatch(size_t count)
+{
+	for (size_t i = 0; i < count; i++, pop_position++)
+	{
+		slots[pop_position & (PACKET_RING_CAPACITY - 1)].sequence.store(pop_position + PACKET_RING_CAPACITY, std::memory_order_release);
+	}
+}
+
+/*
+	\brief
+	Checks if the slot at pop_position holds a datagram.
+*/
+bool Packet_Ring::IsDatagramReady() const
+{
+	return slots[pop_position & (PACKET_RING_CAPACITY - 1)].sequence.load(std::memory_order_acquire) == pop_position + 1;
+}
+
+/*
+	\brief
+	Returns straight away if there is a datagram, otherwise marks the handler as waiting and sleeps.
+*/
+bool Packet_Ring::WaitForDatagrams(double timeout)
+{
+	if (is_notified.exchange(false, std::memory_order_acquire) || IsDatagramReady()) return IsDatagramReady();
+	if (timeout <= 0) return false;
+	std::unique_lock<std::mutex> lock{ wait_lock };
+	is_handler_waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	wait_condition.wait_for(lock, std::chrono::duration<double>(timeout), [this]() { return is_notified.load(std::memory_order_relaxed) || IsDatagramReady(); });
+	is_handler_waiting.store(false, std::memory_order_relaxed);
+	is_notified.store(false, std::memory_order_relaxed);
+	return IsDatagramReady();
+}
+
+/*
+	\brief
+	Sets the notified flag, then wakes the consuming thread the same way Push() does.
+*/
+void Packet_Ring::Notify()
+{
+	is_notified.store(true, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (is_handler_waiting.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock{ wait_lock };
+		wait_condition.notify_one();
+	}
+}
+
+#ifdef __linux__
+struct Datagram_IO::Socket_Batch
+{
+	//Receiving thread: recvmmsg() writes datagram i and its sender's address straight into buffers[i] and addrs[i].
+	char buffers[SOCKET_BATCH_SIZE][MAX_BUFFER_SIZE];
+	sockaddr_storage addrs[SOCKET_BATCH_SIZE];
+	iovec receive_vectors[SOCKET_BATCH_SIZE];
+	mmsghdr receive_headers[SOCKET_BATCH_SIZE];
+	//Sending thread: pointed at the datagrams being written, which stay where they are (no copy). On its own cache line.
+	alignas(64) iovec send_vectors[SOCKET_BATCH_SIZE];
+	mmsghdr send_headers[SOCKET_BATCH_SIZE];
+};
+
+/*
+	\brief
+	Points a sendmmsg() message header at a datagram and its destination.
+*/
+static void SetSendHeader(mmsghdr& header, iovec& vector, sockaddr_storage& addr_dest, char* data, size_t length)
+{
+	vector.iov_base = data;
+	vector.iov_len = length;
+	header.msg_hdr = msghdr{};
+	header.msg_hdr.msg_name = &addr_dest;
+	header.msg_hdr.msg_namelen = GetSockAddrLength(addr_dest);
+	header.msg_hdr.msg_iov = &vector;
+	header.msg_hdr.msg_iovlen = 1;
+	header.msg_len = 0;
+}
+#else
+struct Datagram_IO::Socket_Batch
+{
+};
+#endif
+
+//Defined here, where Socket_Batch is complete.
+Datagram_IO::Datagram_IO() = default;
+
+/*
+	\brief
+	Closes the epoll instance, the socket itself is closed by its owner.
+*/
+Datagram_IO::~Datagram_IO()
+{
+#ifdef __linux__
+	if (epoll_fd != -1) close(epoll_fd);
+#endif
+}
+
+/*
+	\brief
+	Sets the socket to read and write, registering it with epoll on Linux.
+*/
+void Datagram_IO::Attach(SOCKET socket_to_use)
+{
+	udp_socket = socket_to_use;
+#ifdef __linux__
+	if (!batch)
+	{
+		batch = std::make_unique<Socket_Batch>();
+		//Each receive header always reads into the same buffer, only the lengths are reset before every recvmmsg().
+		for (size_t i = 0; i < SOCKET_BATCH_SIZE; i++)
+		{
+			batch->receive_vectors[i].iov_base = batch->buffers[i];
+			batch->receive_vectors[i].iov_len = MAX_BUFFER_SIZE;
+			batch->receive_headers[i].msg_hdr = msghdr{};
+			batch->receive_headers[i].msg_hdr.msg_name = &batch->addrs[i];
+			batch->receive_headers[i].msg_hdr.msg_iov = &batch->receive_vectors[i];
+			batch->receive_headers[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+	if (epoll_fd != -1) close(epoll_fd);
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) return;
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.fd = udp_socket;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, udp_socket, &event) == -1)
+	{
+		//Falls back to poll.
+		close(epoll_fd);
+		epoll_fd = -1;
+	}
+#endif
+}
+
+/*
+	\brief
+	Sleeps in epoll_wait() (Linux) or poll() until the socket is readable.
+	The timeout is rounded up to a whole millisecond, so a short timeout doesn't turn into a spin.
+*/
+bool Datagram_IO::WaitUntilReadable(double timeout)
+{
+	int timeout_ms = static_cast<int>(std::ceil((std::max)(timeout, 0.0) * 1000));
+#ifdef __linux__
+	if (epoll_fd != -1)
+	{
+		epoll_event event{};
+		return epoll_wait(epoll_fd, &event, 1, timeout_ms) > 0;
+	}
+#endif
+	return PollReadable(udp_socket, timeout_ms);
+}
+
+/*
+	\brief
+	Waits for the socket to be readable, then reads until the non-blocking socket has nothing left.
+	On Linux, reads with recvmmsg() into the preallocated slab; a batch that comes back short means the socket is drained.
+*/
+size_t Datagram_IO::ReceiveDatagrams(double timeout)
+{
+	if (!WaitUntilReadable(timeout)) return 0;
+
+	size_t datagrams_received = 0;
+#ifdef __linux__
+	while (true)
+	{
+		for (mmsghdr& header : batch->receive_headers) header.msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+		int count = recvmmsg(udp_socket, batch->receive_headers, SOCKET_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+		if (count == SOCKET_ERROR)
+		{
+			//Nothing left to read.
+			if (IsWouldBlockError(GetLastSocketError())) break;
+			//Other errors (e.g. ICMP port unreachable from a closed player) only affect that datagram.
+			continue;
+		}
+		size_t pushed = 0;
+		for (int i = 0; i < count; i++)
+		{
+			int bytes_read = static_cast<int>(batch->receive_headers[i].msg_len);
+			//Do not accept any message that doesn't have a full header, since the game always uses RDT protocol for all messages.
+			if (bytes_read < DATAGRAM_HEADER_SIZE) continue;
+			if (received.Push(batch->addrs[i], batch->buffers[i], bytes_read, false)) pushed++;
+		}
+		//Wakes the handling thread once per batch, so it works on this batch while the next one is read.
+		if (pushed > 0) received.Notify();
+		datagrams_received += pushed;
+		if (count < static_cast<int>(SOCKET_BATCH_SIZE)) break;
+	}
+#else
+	char buffer[MAX_BUFFER_SIZE];
+	while (true)
+	{
+		sockaddr_storage sender_addr{};
+		Socket_Length size_sockaddr = sizeof(sender_addr);
+		int bytes_read = static_cast<int>(recvfrom(udp_socket, buffer, MAX_BUFFER_SIZE, 0, (sockaddr*)&sender_addr, &size_sockaddr));
+		if (bytes_read == SOCKET_ERROR)
+		{
+			//Nothing left to read.
+			if (IsWouldBlockError(GetLastSocketError())) break;
+			//Other errors (e.g. ICMP port unreachable from a closed player) only affect that datagram.
+			continue;
+		}
+		//Do not accept any message that doesn't have a full header, since the game always uses RDT protocol for all messages.
+		if (bytes_read < DATAGRAM_HEADER_SIZE) continue;
+		if (received.Push(sender_addr, buffer, bytes_read)) datagrams_received++;
+	}
+#endif
+	return datagrams_received;
+}
+
+/*
+	\brief
+	Queues the datagram for the sending thread.
+*/
+bool Datagram_IO::QueueSend(const sockaddr_storage& addr_dest, const char* data, size_t length, bool wake_sender)
+{
+	return to_send.Push(addr_dest, data, static_cast<int>(length), wake_sender);
+}
+
+/*
+	\brief
+	Sleeps until a datagram is queued, WakeSender() is called, or the timeout runs out.
+*/
+bool Datagram_IO::WaitForQueuedSends(double timeout)
+{
+	return to_send.WaitForDatagrams(timeout);
+}
+
+/*
+	\brief
+	Wakes the sending thread if it's asleep in WaitForQueuedSends().
+*/
+void Datagram_IO::WakeSender()
+{
+	to_send.Notify();
+}
+
+/*
+	\brief
+	Writes the queued datagrams in batches, freeing their slots after each batch.
+	On Linux, each batch is written from the ring slots in place with sendmmsg().
+*/
+size_t Datagram_IO::FlushSends()
+{
+	static_assert(PACKET_BATCH_SIZE <= SOCKET_BATCH_SIZE, "A batch from the ring must fit in one sendmmsg() batch.");
+	size_t datagrams_sent = 0;
+	Queued_Datagram* datagrams[PACKET_BATCH_SIZE]{};
+	while (size_t count = to_send.PeekBatch(datagrams, PACKET_BATCH_SIZE))
+	{
+#ifdef __linux__
+		for (size_t i = 0; i < count; i++)
+		{
+			SetSendHeader(batch->send_headers[i], batch->send_vectors[i], datagrams[i]->addr, datagrams[i]->data, datagrams[i]->length);
+		}
+		WriteBatch(count);
+#else
+		for (size_t i = 0; i < count; i++)
+		{
+			WriteToSocket(udp_socket, datagrams[i]->addr, datagrams[i]->data, datagrams[i]->length);
+		}
+#endif
+		to_send.PopBatch(count);
+		datagrams_sent += count;
+	}
+	return datagrams_sent;
+}
+
+/*
+	\brief
+	Writes the datagram to the socket.
+*/
+int Datagram_IO::Send(sockaddr_storage& addr_dest, char* data, size_t length)
+{
+	return WriteToSocket(udp_socket, addr_dest, data, length);
+}
+
+/*
+	\brief
+	Writes the datagrams SOCKET_BATCH_SIZE at a time with sendmmsg() on Linux, or one at a time elsewhere.
+*/
+size_t Datagram_IO::SendBatch(std::vector<Outgoing_Datagram>& datagrams)
+{
+	size_t datagrams_sent = 0;
+#ifdef __linux__
+	for (size_t first = 0; first < datagrams.size(); first += SOCKET_BATCH_SIZE)
+	{
+		size_t count = (std::min)(datagrams.size() - first, SOCKET_BATCH_SIZE);
+		for (size_t i = 0; i < count; i++)
+		{
+			Outgoing_Datagram& datagram = datagrams[first + i];
+			SetSendHeader(batch->send_headers[i], batch->send_vectors[i], datagram.addrDest, datagram.data.data(), datagram.data.size());
+		}
+		datagrams_sent += WriteBatch(count);
+	}
+#else
+	for (Outgoing_Datagram& datagram : datagrams)
+	{
+		if (WriteToSocket(udp_socket, datagram.addrDest, datagram.data.data(), datagram.data.size()) > 0) datagrams_sent++;
+	}
+#endif
+	return datagrams_sent;
+}
+
+#ifdef __linux__
+/*
+	\brief
+	Calls sendmmsg() until every datagram has been written or dropped.
+	Like WriteToSocket(), retries while the send buffer is full, and drops a datagram that fails for any other reason.
+*/
+size_t Datagram_IO::WriteBatch(size_t count)
+{
+	size_t next = 0;
+	size_t datagrams_sent = 0;
+	while (next < count)
+	{
+		int sent = sendmmsg(udp_socket, batch->send_headers + next, static_cast<unsigned int>(count - next), 0);
+		if (sent == SOCKET_ERROR)
+		{
+			//Blocking, just try again.
+			if (IsWouldBlockError(GetLastSocketError())) continue;
+			//The first datagram left failed (e.g. unreachable destination), drop it like a lost packet and send the rest.
+			next++;
+			continue;
+		}
+		next += sent;
+		datagrams_sent += sent;
+	}
+	return datagrams_sent;
+}
+#endif
+
+/*
+	\brief
+	Packs the IPv4 address and port into one key, so comparing entries is a single integer compare.
+*/
+uint64_t Address_Index::MakeKey(const sockaddr_storage& addr)
+{
+	const sockaddr_in& ipv4 = reinterpret_cast<const sockaddr_in&>(addr);
+	return (static_cast<uint64_t>(ipv4.sin_addr.s_addr) << 16) | ipv4.sin_port;
+}
+
+/*
+	\brief
+	Fibonacci hashing: multiplying by 2^64 / golden ratio spreads nearby addresses and ports across the table, taking the top bits.
+*/
+size_t Address_Index::HomeSlot(uint64_t key) const
+{
+	return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - slot_bits));
+}
+
+/*
+	\brief
+	Probes from the home slot until the key or an empty entry is found.
+*/
+int Address_Index::Find(const sockaddr_storage& addr) const
+{
+	if (count == 0) return -1;
+	uint64_t key = MakeKey(addr);
+	size_t mask = entries.size() - 1;
+	for (size_t slot = HomeSlot(key); ; slot = (slot + 1) & mask)
+	{
+		const Entry& entry = entries[slot];
+		if (entry.value == -1) return -1;
+		if (entry.key == key) return entry.value;
+	}
+}
+
+/*
+	\brief
+	Probes from the home slot, replacing the key's value if found, otherwise taking the first empty entry.
+*/
+void Address_Index::Insert(const sockaddr_storage& addr, int value)
+{
+	if ((count + 1) * 2 > entries.size()) Grow();
+	uint64_t key = MakeKey(addr);
+	size_t mask = entries.size() - 1;
+	for (size_t slot = HomeSlot(key); ; slot = (slot + 1) & mask)
+	{
+		Entry& entry = entries[slot];
+		if (entry.value == -1)
+		{
+			entry.key = key;
+			entry.value = value;
+			count++;
+			return;
+		}
+		if (entry.key == key)
+		{
+			entry.value = value;
+			return;
+		}
+	}
+}
+
+/*
+	\brief
+	Empties the key's entry, then moves back every entry after it (up to the next empty one) that would no longer be reachable from its home slot.
+*/
+void Address_Index::Erase(const sockaddr_storage& addr)
+{
+	if (count == 0) return;
+	uint64_t key = MakeKey(addr);
+	size_t mask = entries.size() - 1;
+	size_t hole = HomeSlot(key);
+	while (true)
+	{
+		if (entries[hole].value == -1) return; //Not stored.
+		if (entries[hole].key == key) break;
+		hole = (hole + 1) & mask;
+	}
+	entries[hole].value = -1;
+	count--;
+	for (size_t slot = (hole + 1) & mask; entries[slot].value != -1; slot = (slot + 1) & mask)
+	{
+		//Distance probed from the home slot to reach the entry, and from the home slot to reach the hole.
+		size_t home = HomeSlot(entries[slot].key);
+		if (((slot - home) & mask) < ((hole - home) & mask)) continue; //The hole isn't on the entry's probe path.
+		entries[hole] = entries[slot];
+		entries[slot].value = -1;
+		hole = slot;
+	}
+}
+
+/*
+	\brief
+	Rehashes every entry into a table twice the size.
+*/
+void Address_Index::Grow()
+{
+	std::vector<Entry> old_entries{};
+	old_entries.swap(entries);
+	slot_bits = (std::max)(slot_bits + 1, 4);
+	entries.assign(size_t{ 1 } << slot_bits, Entry{});
+	size_t mask = entries.size() - 1;
+	for (const Entry& old_entry : old_entries)
+	{
+		if (old_entry.value == -1) continue;
+		size_t slot = HomeSlot(old_entry.key);
+		while (entries[slot].value != -1) slot = (slot + 1) & mask;
+		entries[slot] = old_entry;
+	}
+}
+
+Timer_Wheel::Timer_Wheel(Ticks start_time)
+	: current_tick{ static_cast<uint64_t>((std::max)(start_time, Ticks{ 0 }) / TIMER_WHEEL_TICK) }
+{
+}
+
+/*
+	\brief
+	Rounds the deadline up to a tick, no earlier than the next tick and no later than the end of the top level.
+*/
+void Timer_Wheel::Schedule(Ticks deadline, int id)
+{
+	const uint64_t last_tick = current_tick + (uint64_t{ 1 } << (SLOT_BITS * LEVEL_COUNT)) - 1;
+	uint64_t tick{};
+	if (deadline <= static_cast<Ticks>(current_tick) * TIMER_WHEEL_TICK) tick = current_tick + 1; //Already passed.
+	else tick = (std::min)(static_cast<uint64_t>((deadline - 1) / TIMER_WHEEL_TICK) + 1, last_tick); //Clamped to the range (e.g. TICKS_NEVER).
+	Place(Entry{ tick, Timer{ deadline, id } });
+	count++;
+}
+
+/*
+	\brief
+	Level L covers the next 64^(L+1) ticks, each slot covering 64^L ticks.
+	A timer on the current tick (only while cascading) goes in the level 0 slot about to be fired.
+*/
+void Timer_Wheel::Place(const Entry& entry)
+{
+	uint64_t ticks_left = entry.tick - current_tick;
+	int level = 0;
+	while (level < LEVEL_COUNT - 1 && ticks_left >= (SLOT_COUNT << (SLOT_BITS * level))) level++;
+	slots[level][(entry.tick >> (SLOT_BITS * level)) & SLOT_MASK].push_back(entry);
+}
+
+/*
+	\brief
+	Called on the first tick of a slot of the level, cascading the level above first if its slot starts on the same tick.
+*/
+void Timer_Wheel::Cascade(int level)
+{
+	if (level >= LEVEL_COUNT) return;
+	uint64_t index = (current_tick >> (SLOT_BITS * level)) & SLOT_MASK;
+	if (index == 0) Cascade(level + 1);
+	cascading.swap(slots[level][index]);
+	for (const Entry& entry : cascading) Place(entry);
+	cascading.clear();
+}
+
+/*
+	\brief
+	For each level, finds the nearest slot with timers and the tick the wheel reaches it on:
+	the tick itself for level 0, the first tick of the slot for the levels above (when its timers are cascaded).
+*/
+uint64_t Timer_Wheel::NextEventTick() const
+{
+	uint64_t next_tick = UINT64_MAX;
+	if (count == 0) return next_tick;
+	for (int level = 0; level < LEVEL_COUNT; level++)
+	{
+		uint64_t slot_number = current_tick >> (SLOT_BITS * level);
+		for (uint64_t distance = 1; distance <= SLOT_COUNT; distance++)
+		{
+			if (slots[level][(slot_number + distance) & SLOT_MASK].empty()) continue;
+			next_tick = (std::min)(next_tick, (slot_number + distance) << (SLOT_BITS * level));
+			break;
+		}
+	}
+	return next_tick;
+}
+
+/*
+	\brief
+	Jumps from one tick with something to do to the next, cascading the levels on the first tick of their slots
+	and firing the level 0 slot of the tick.
+*/
+void Timer_Wheel::Advance(Ticks current_time, std::vector<Timer>& expired)
+{
+	uint64_t target_tick = static_cast<uint64_t>((std::max)(current_time, Ticks{ 0 }) / TIMER_WHEEL_TICK);
+	while (current_tick < target_tick)
+	{
+		uint64_t next_tick = NextEventTick();
+		if (next_tick > target_tick)
+		{
+			current_tick = target_tick;
+			break;
+		}
+		current_tick = next_tick;
+		if ((current_tick & SLOT_MASK) == 0) Cascade(1);
+		std::vector<Entry>& slot = slots[0][current_tick & SLOT_MASK];
+		for (const Entry& entry : slot) expired.push_back(entry.timer);
+		count -= slot.size();
+		slot.clear();
+	}
+}
+
+Ticks Timer_Wheel::GetNextDeadline() const
+{
+	uint64_t next_tick = NextEventTick();
+	if (next_tick == UINT64_MAX) return TICKS_NEVER;
+	return static_cast<Ticks>(next_tick) * TIMER_WHEEL_TICK;
+}
+
+Tick_Scheduler::Tick_Scheduler(int ticks_per_second)
+	: interval{ TICKS_PER_SECOND / (std::max)(ticks_per_second, 1) }, next_deadline{ GetMonotonicTime() }
+{
+}
+
+/*
+	\brief
+	Records the work of the tick that is ending, then sleeps until the next deadline, unless it has already passed.
+*/
+Ticks Tick_Scheduler::WaitForNextTick()
+{
+	Ticks current_time = GetMonotonicTime();
+	if (is_tick_running)
+	{
+		Ticks work = current_time - time_tick_started;
+		stats.total_work += work;
+		stats.max_work = (std::max)(stats.max_work, work);
+		if (current_time > next_deadline)
+		{
+			stats.overrun_count++;
+			//Start late on the deadline just passed, skipping any before it.
+			Ticks skipped = (current_time - next_deadline) / interval;
+			stats.skipped_count += static_cast<size_t>(skipped);
+			next_deadline += skipped * interval;
+		}
+	}
+	if (current_time < next_deadline)
+	{
+		//Same clock as GetMonotonicTime().
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point{
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds{ next_deadline }) });
+		current_time = GetMonotonicTime();
+		stats.max_lateness = (std::max)(stats.max_lateness, current_time - next_deadline);
+	}
+	time_tick_started = current_time;
+	is_tick_running = true;
+	stats.tick_count++;
+	Ticks deadline = next_deadline;
+	next_deadline += interval;
+	return deadline;
+}
+
+/*
+	\brief
+	Keeps the sample in the window and picks the one with the smallest delay.
+	Once that is at least CLOCK_DRIFT_MIN_SPAN after the drift reference, the drift is updated from the two.
+*/
+void Clock_Sync::AddSample(Ticks t0, double t1, double t2, Ticks t3)
+{
+	double local_send = TicksToSeconds(t0);
+	double local_receive = TicksToSeconds(t3);
+	Sample sample{};
+	sample.local_time = (local_send + local_receive) / 2;
+	sample.offset = ((t1 - local_send) + (t2 - local_receive)) / 2;
+	//Time spent answering (t2 - t1) isn't part of the delay, but a negative delay can only come from a bad sample.
+	sample.delay = (std::max)((local_receive - local_send) - (t2 - t1), 0.0);
+
+	//Each offset is within half its delay of the true one, so a larger difference means the other clock has jumped.
+	if (sample_count > 0 &&
+		std::abs(sample.offset - GetOffset(sample.local_time)) > (sample.delay + best.delay) / 2 + CLOCK_STEP_TOLERANCE)
+	{
+		sample_count = 0;
+		drift = 0;
+		has_drift = false;
+		has_drift_reference = false;
+	}
+	if (sample_count == 0)
+	{
+		samples.fill(sample);
+		best = sample;
+		sample_count = 1;
+		return;
+	}
+	samples[sample_count % CLOCK_SYNC_WINDOW] = sample;
+	sample_count++;
+
+	const Sample* new_best = &samples[0];
+	for (const Sample& window_sample : samples)
+	{
+		if (window_sample.delay < new_best->delay) new_best = &window_sample;
+	}
+	best = *new_best;
+	//The drift is only measured between filtered samples, so wait for a full window before taking the first.
+	if (sample_count < CLOCK_SYNC_WINDOW) return;
+	if (!has_drift_reference)
+	{
+		drift_reference = best;
+		has_drift_reference = true;
+		return;
+	}
+	double span = best.local_time - drift_reference.local_time;
+	if (span < CLOCK_DRIFT_MIN_SPAN) return;
+	double measured_drift = (best.offset - drift_reference.offset) / span;
+	//Smoothed, since each measurement still carries the error of two offsets.
+	drift = has_drift ? 0.75 * drift + 0.25 * measured_drift : measured_drift;
+	has_drift = true;
+	drift = (std::max)((std::min)(drift, MAX_CLOCK_DRIFT), -MAX_CLOCK_DRIFT);
+	drift_reference = best;
+}
+
+double Clock_Sync::GetOffset(double local_time) const
+{
+	return best.offset + drift * (local_time - best.local_time);
+}
+
+/*
+	\brief
+	Solves local_time = remote_time - GetOffset(local_time).
+*/
+double Clock_Sync::ToLocalTime(double remote_time) const
+{
+	if (sample_count == 0) return remote_time;
+	return (remote_time - best.offset + drift * best.local_time) / (1 + drift);
+}
+
+/*
+	\brief
+	Splits the message into fragments of up to FRAGMENT_DATA_SIZE, slicing the message by offset so each byte is only copied once.
+*/
+void FragmentMessage(const std::string& message, const std::string& prefix, uint16_t message_id, std::queue<std::string>& messages_to_send)
+{
+	if (message.empty()) return;
+	size_t fragment_count = (message.size() + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+	uint16_t network_message_id = htons(message_id);
+	uint16_t network_fragment_count = htons(static_cast<uint16_t>(fragment_count));
+	for (size_t index = 0; index < fragment_count; index++)
+	{
+		size_t offset = index * FRAGMENT_DATA_SIZE;
+		size_t fragment_size = (std::min)(message.size() - offset, static_cast<size_t>(FRAGMENT_DATA_SIZE));
+		uint16_t network_fragment_index = htons(static_cast<uint16_t>(index));
+		char fragment_header[FRAGMENT_HEADER_SIZE]{};
+		memcpy_s(fragment_header, 2, &network_message_id, 2);
+		memcpy_s(fragment_header + 2, 2, &network_fragment_index, 2);
+		memcpy_s(fragment_header + 4, 2, &network_fragment_count, 2);
+
+		std::string fragment{};
+		fragment.reserve(1 + prefix.size() + FRAGMENT_HEADER_SIZE + fragment_size);
+		//COMMAND_COMPLETE on the last fragment, to show that there are no more packets on the way.
+		fragment.push_back((char)((index + 1 == fragment_count) ? COMMAND_COMPLETE : COMMAND_INCOMPLETE));
+		fragment.append(prefix);
+		fragment.append(fragment_header, FRAGMENT_HEADER_SIZE);
+		fragment.append(message, offset, fragment_size);
+		messages_to_send.push(std::move(fragment));
+	}
+}
+
+/*
+	\brief
+	Picks the first mode in INTEGRITY_MODE_PREFERENCE that the other side supports.
+*/
+IntegrityMode ChooseIntegrityMode(uint8_t supported_modes)
+{
+	//Only pick modes this side supports as well.
+	supported_modes &= SUPPORTED_INTEGRITY_MODES;
+	for (IntegrityMode mode : INTEGRITY_MODE_PREFERENCE)
+	{
+		if (supported_modes & (1u << mode)) return mode;
+	}
+	return INTEGRITY_SUM16;
 }
 
 /*
@@ -104,18 +1341,44 @@ std::array<unsigned char, 4> GetIPAddressBytes(std::string ip_addr)
 	return byte_arr;
 }
 
+namespace {
+	//Each thread's clock reading from its last UpdateCachedTime(), 0 if it has never been updated.
+	thread_local Ticks cached_time{ 0 };
+}
+
 /*
 	\brief
-	Returns current time in double since epoch.
+	steady_clock is monotonic (CLOCK_MONOTONIC on Linux, QueryPerformanceCounter on Windows).
 */
-double GetTime()
+Ticks GetMonotonicTime()
 {
-	// Get the current time since epoch
-	auto now = std::chrono::system_clock::now();
-	auto duration = now.time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Ticks UpdateCachedTime()
+{
+	cached_time = GetMonotonicTime();
+	return cached_time;
+}
 
-	// Convert to seconds and return.
-	return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() / 1000.0;
+Ticks GetCachedTime()
+{
+	if (cached_time == 0) return UpdateCachedTime();
+	return cached_time;
+}
+
+double TicksToSeconds(Ticks ticks)
+{
+	return static_cast<double>(ticks) / TICKS_PER_SECOND;
+}
+
+/*
+	\brief
+	Returns the monotonic time in seconds.
+*/
+double GetTime()
+{
+	return TicksToSeconds(GetMonotonicTime());
 }
 
 // Function to compare two sockaddr structures
@@ -17,48 +17,809 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 #ifndef UTILITY_HPP
 #define UTILITY_HPP
 #include "Checksum.hpp"
+#include "BitStream.hpp"
 #include <chrono>
-#include "winsock2.h"
+#include <array>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <queue>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "Platform.hpp"
 
 /*
 	Defines used for the client and server program.
 */
 //Max size of udp packet
 constexpr int MAX_PACKET_SIZE = 1000;
-//Max size of payload, excluding [Checksum][Sequence Number]
-constexpr int MAX_PAYLOAD_SIZE = MAX_PACKET_SIZE - 6;
+//Size of the header in front of every datagram, [Integrity Mode, 1][Integrity Value, 4][ACK, 4][ACK Bits, 4]
+constexpr int DATAGRAM_HEADER_SIZE = 13;
+//Offset of the part of the datagram covered by the integrity value, everything after [Integrity Mode, 1][Integrity Value, 4].
+constexpr int INTEGRITY_COVERAGE_OFFSET = 5;
+/*
+	Integrity modes the server picks from when a client joins, best first.
+	CRC32C catches all burst errors up to 32 bits (the 16 bit sum misses swapped words), and is the fastest with SSE4.2.
+*/
+constexpr IntegrityMode INTEGRITY_MODE_PREFERENCE[] = { INTEGRITY_CRC32C, INTEGRITY_HASH64, INTEGRITY_SUM16 };
+//Size of the header in front of every message packed in a datagram, [Length, 2][Sequence Number, 4]
+constexpr int FRAME_HEADER_SIZE = 6;
+//Max size of payload (one message), excluding the headers. A message of this size fills a datagram on its own.
+constexpr int MAX_PAYLOAD_SIZE = MAX_PACKET_SIZE - DATAGRAM_HEADER_SIZE - FRAME_HEADER_SIZE;
 //Max buffer size when receiving.
 constexpr int MAX_BUFFER_SIZE = 2000;
-//Time before packet should be resent again, if no correct ACK is received.
-constexpr float TIMEOUT_TIMER = 0.5f;
+/*
+	Time in nanoseconds on the monotonic clock (see GetMonotonicTime()), or a duration in nanoseconds.
+	Kept as an integer so deadlines add up exactly, and signed so the difference of two times can be negative.
+*/
+typedef int64_t Ticks;
+constexpr Ticks TICKS_PER_SECOND = 1000000000;
+constexpr Ticks TICKS_PER_MILLISECOND = 1000000;
+//Deadline of something that isn't waiting to happen, later than any time the clock reaches.
+constexpr Ticks TICKS_NEVER = INT64_MAX;
+//Time before packet should be resent again if no correct ACK is received, used until the first RTT sample is measured.
+constexpr Ticks INITIAL_TIMEOUT_TIMER = 500 * TICKS_PER_MILLISECOND;
+//Lower bound of the timeout, so that jitter on a fast link doesn't cause packets to be resent too early.
+constexpr Ticks MIN_TIMEOUT_TIMER = 50 * TICKS_PER_MILLISECOND;
+//Upper bound of the timeout, after backing off from repeated timeouts.
+constexpr Ticks MAX_TIMEOUT_TIMER = 2 * TICKS_PER_SECOND;
+//Resolution the sending threads wake up at (a Timer_Wheel tick), used as the smallest RTT variance when calculating the timeout.
+constexpr Ticks CLOCK_GRANULARITY = TICKS_PER_MILLISECOND;
+//Max number of packets that can be sent but not yet ACK'd, per session.
+constexpr int SEND_WINDOW_SIZE = 32;
+//Max number of packets past the next expected packet that will be buffered by the receiver.
+constexpr int RECV_WINDOW_SIZE = SEND_WINDOW_SIZE;
+//Max time a received packet waits for outgoing data to carry its ACK, before a standalone ACK is sent instead.
+constexpr Ticks ACK_DELAY = 20 * TICKS_PER_MILLISECOND;
+//Size of [COMMAND_SEQUENCED, 1][Sequence Number, 4] in front of every sequenced message.
+constexpr int SEQUENCED_MESSAGE_HEADER_SIZE = 5;
+//Size of [Message ID, 2][Fragment Index, 2][Fragment Count, 2] in front of the data of every fragment of a long message.
+constexpr int FRAGMENT_HEADER_SIZE = 6;
+/*
+	Size of the data in every fragment except the last, leaving room for [GeneralCommandID, 1][Player ID, 2] and the fragment header.
+	Same on both sides, so the receiver can place a fragment at (index * FRAGMENT_DATA_SIZE) without waiting for the ones in front.
+*/
+constexpr int FRAGMENT_DATA_SIZE = MAX_PAYLOAD_SIZE - 3 - FRAGMENT_HEADER_SIZE;
+/*
+	Largest message sent in fragments: one tick's bullets, new asteroids and destructions (see WriteBullet() and the others in server.cpp),
+	for no more than the client's 2048 game objects (GAME_OBJ_INST_NUM_MAX), each written in under 20 bytes.
+*/
+constexpr int MAX_FRAGMENTED_MESSAGE_SIZE = 2048 * 20;
+//Most fragments a message can have. Fragments claiming more are dropped, so one fragment can't make the receiver allocate more than this.
+constexpr int MAX_FRAGMENT_COUNT = (MAX_FRAGMENTED_MESSAGE_SIZE + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+//Most messages that can be partly received at once, per session. Fragments are delivered in order, so there's normally only one.
+constexpr size_t MAX_PARTIAL_MESSAGES = 4;
+//Partly received messages more than this many message IDs behind the newest are dropped, along with any fragments of theirs that come later.
+constexpr uint16_t MESSAGE_ID_WINDOW = 16;
+//Number of datagrams that can wait to be handled (or sent), must be a power of 2. Datagrams pushed when it's full are dropped.
+constexpr size_t PACKET_RING_CAPACITY = 256;
+//Max number of datagrams the handling thread takes from the ring at a time.
+constexpr size_t PACKET_BATCH_SIZE = 32;
+//Max number of datagrams read or written by one recvmmsg()/sendmmsg() call on Linux. Other platforms make one call per datagram.
+constexpr size_t SOCKET_BATCH_SIZE = 64;
+//Length of one tick of a Timer_Wheel. Timers fire on the first tick at or after their deadline.
+constexpr Ticks TIMER_WHEEL_TICK = TICKS_PER_MILLISECOND;
+//Time between clock synchronization pings to each player, once CLOCK_SYNC_WINDOW samples have been measured.
+constexpr Ticks CLOCK_SYNC_INTERVAL = TICKS_PER_SECOND;
+//Time between clock synchronization pings until then, so the first estimate is ready soon after joining.
+constexpr Ticks CLOCK_SYNC_FAST_INTERVAL = 100 * TICKS_PER_MILLISECOND;
+//Number of recent samples the clock offset is picked from, the one with the smallest round trip delay being the most accurate.
+constexpr size_t CLOCK_SYNC_WINDOW = 8;
+//Min time in seconds between the two offsets the clock drift is measured from, so that noise in the offsets doesn't swamp it.
+constexpr double CLOCK_DRIFT_MIN_SPAN = 60.0;
+//Largest clock drift accepted, in seconds per second (500 ppm, the limit NTP assumes of a working clock).
+constexpr double MAX_CLOCK_DRIFT = 0.0005;
+//Error in seconds allowed on top of the round trip delays, before a sample is taken to mean the other clock has jumped (e.g. restarted).
+constexpr double CLOCK_STEP_TOLERANCE = 0.02;
+//Max time a network thread sleeps with nothing to do (no datagram, no timer due), before checking if the game has ended.
+constexpr double IDLE_WAIT_INTERVAL = 0.1;
+
+/*
+	Header in front of every datagram: [Integrity Mode, 1][Integrity Value, 4][ACK, 4][ACK Bits, 4].
+	Every datagram carries the ACKs of the packets its sender has received, so most ACKs don't need their own datagram.
+*/
+struct Packet_Header
+{
+	//Latest packet received by the sender of this datagram, -1 if nothing has been received yet.
+	int ack_number{ -1 };
+	//If bit i is set, packet (ack_number - 1 - i) has been received as well.
+	uint32_t ack_bits{};
+	//How the datagram was checked, so the receiver can reject one that doesn't match what was negotiated.
+	IntegrityMode integrity_mode{ INTEGRITY_SUM16 };
+};
+
+/*
+	A message packed in a datagram: [Length, 2][Sequence Number, 4][message].
+	Several messages can share one datagram (and its checksum and ACKs), up to MAX_PACKET_SIZE.
+*/
+struct Frame
+{
+	//-1 if the message doesn't need to be ACK'd (e.g. ACK, JOIN_RESPONSE).
+	int sequence_number{ -1 };
+	//[GeneralCommandID]...
+	std::string message{};
+};
+
+/*
+	A frame encoded once in its final form, so sending it again doesn't need it to be encoded or summed again.
+*/
+struct Encoded_Frame
+{
+	/*
+		Datagram with only this frame: [Integrity Mode, 1][Integrity Value, 4][ACK, 4][ACK Bits, 4][Length, 2][Sequence Number, 4][message].
+		Space for the datagram header is reserved in front, so it can be sent on its own after updating the ACKs (and checksum) in place.
+	*/
+	std::string datagram{};
+	//One's complement sum of the frame (excluding the datagram header), for packing it with other frames without summing it again.
+	uint16_t frame_sum{};
+};
+
+/*
+	A packet that has been given a sequence number, and stays in the send window until it is ACK'd.
+*/
+struct Packet_In_Flight
+{
+	int sequence_number{};
+	//[GeneralCommandID]..., encoded when the packet enters the window.
+	Encoded_Frame encoded{};
+	//Each packet has its own timeout, so only the packets that were lost get resent.
+	Ticks time_last_sent{};
+	//Number of times the packet has been sent. Only packets sent once are used to measure RTT (Karn's rule).
+	int times_sent{ 0 };
+	//Set to true to send packet on the next pass (e.g. it has just entered the window).
+	bool toSend{ true };
+	bool is_acked{ false };
+};
 
 /*
 	Contains data required to manage reliable data transfer to and from clients (or server).
+	Uses selective repeat, so up to SEND_WINDOW_SIZE packets can be in flight at once.
 */
 struct Reliable_Transfer
 {
 	/*
 		Reliable Send
 	*/
-	//Represents the current packet to send/resend. 
-	int current_sequence_number{ 0 };
-	//Timeout, when timer completes then packet is to be resent. Set to max since no packet sent yet.
-	double time_last_packet_sent{ 20000000000000 };
-	//Controls if the packet should be sent. Set to true to send packet immediately.
-	bool toSend{ true };
+	//Sequence number to give the next packet that enters the send window.
+	int next_sequence_number{ 0 };
+	/*
+		Packets that have been sent (or are about to be) but not all ACK'd yet, in order of sequence number.
+		The front is always the oldest packet not ACK'd yet (the base of the window), so sequence numbers are contiguous.
+	*/
+	std::deque<Packet_In_Flight> send_window{};
 	/*
 		Reliable Recv
 	*/
-	//Represents the last packet successfully received.
+	//Represents the last packet successfully received in order. Every packet up till this one has been delivered.
 	int ack_last_packet_received{ -1 };
+	//Packets that arrived before the ones in front of them, held until the gap is filled.
+	std::map<int, std::string> out_of_order_packets{};
+	//Latest packet received (in order or not), sent back as the ACK number.
+	int highest_sequence_received{ -1 };
+	//Set when a packet is received, and cleared when a packet carrying its ACK is sent.
+	bool is_ack_pending{ false };
+	Ticks time_ack_pending{};
+	/*
+		Round trip time estimates (RFC 6298), in ticks.
+	*/
+	//Smoothed RTT, -1 until the first sample is measured.
+	Ticks smoothed_rtt{ -1 };
+	Ticks rtt_variance{ 0 };
+	//Time before an unACK'd packet is resent, derived from the RTT estimates and doubled on every timeout.
+	Ticks retransmission_timeout{ INITIAL_TIMEOUT_TIMER };
+	//Integrity check written into every datagram sent, negotiated when joining.
+	IntegrityMode integrity_mode{ INTEGRITY_SUM16 };
+
+	/*
+		\brief
+		Moves messages from the queue into the send window, giving each one a sequence number.
+		Stops when the window is full.
+		\param window_size
+		Max number of packets in flight, e.g. 1 when the packets behind need to wait for the front packet.
+	*/
+	void FillSendWindow(std::queue<std::string>& messages_to_send, int window_size = SEND_WINDOW_SIZE);
+
+	/*
+		\brief
+		Adds every packet in the window that is new or has timed out to frames, and resets their timeout.
+		If any packet timed out, the retransmission timeout is doubled (exponential backoff).
+		The frames point into the window, so they should be assembled before the window changes.
+	*/
+	void GetFramesToSend(Ticks current_time, std::vector<Encoded_Frame*>& frames);
+
+	/*
+		\brief
+		Marks the packet with the ACK number as received, then slides the window past every ACK'd packet in front.
+		If the packet was only sent once, its round trip time is used to update the RTT estimates and timeout.
+		Returns false if no packet in the window has this ACK number (e.g. duplicate ACK).
+	*/
+	bool ReceiveAck(int ack_number, Ticks current_time);
+
+	/*
+		\brief
+		Marks every packet ACK'd by a received header (the ACK number and the ACK bits) as received.
+	*/
+	void ReceiveAckBits(int ack_number, uint32_t ack_bits, Ticks current_time);
+
+	/*
+		\brief
+		Updates the smoothed RTT and RTT variance with a new sample, then recalculates the timeout.
+	*/
+	void AddRTTSample(Ticks rtt_sample);
+
+	/*
+		\brief
+		Buffers a received packet, and moves every packet that is now in order into packets_in_order.
+		Duplicates are ignored, but still set the ACK to be sent since the previous ACK might have been lost.
+		\return
+		false if the packet is too far ahead of the window, in which case it should be dropped without an ACK.
+	*/
+	bool ReceivePacket(int sequence_number, const std::string& data, std::vector<std::string>& packets_in_order, Ticks current_time);
+
+	/*
+		\brief
+		Returns true if a received packet has waited ACK_DELAY without any outgoing packet to carry its ACK.
+		A standalone ACK should then be sent.
+	*/
+	bool IsStandaloneAckDue(Ticks current_time) const;
+
+	/*
+		\brief
+		Returns the earliest time something in the window has to be sent: a packet not sent yet (due now),
+		the retransmission timeout of an unACK'd packet, or the standalone ACK of a received packet.
+		0 (already passed) if a packet is due now. TICKS_NEVER if nothing is waiting,
+		in which case only new messages or received packets can give it something to send.
+	*/
+	Ticks GetNextSendTime() const;
+
+	/*
+		\brief
+		Packs the frames in order into as few datagrams as possible (each up to MAX_PACKET_SIZE),
+		with the ACKs of every packet received so far in each header.
+		A frame sent on its own reuses its encoded datagram, only updating the ACKs and integrity value.
+		Clears the pending ACK if any datagram is returned, since it carries the ACKs.
+	*/
+	std::vector<std::string> AssembleDatagrams(const std::vector<Encoded_Frame*>& frames);
+};
+
+/*
+	Contains data required to manage sequenced (but unreliable) data transfer to and from clients (or server).
+	Used for state where only the latest copy matters (e.g. player transforms), so nothing is ACK'd or resent,
+	and packets older than the latest one received are dropped.
+	Has its own sequence numbers, separate from Reliable_Transfer.
+*/
+struct Sequenced_Transfer
+{
+	//Sequence number to give the next message sent.
+	int next_sequence_number{ 0 };
+	//Latest message received, -1 if nothing has been received yet.
+	int last_sequence_received{ -1 };
+	//Data of the latest message received, excluding the sequence number.
+	std::string latest_message{};
+	//Set when a newer message is received, and cleared when it is taken.
+	bool is_latest_message_new{ false };
+
+	/*
+		\brief
+		Returns the message with the next sequence number in front, [Sequence Number, 4][message].
+	*/
+	std::string EncodeMessage(const std::string& message);
+
+	/*
+		\brief
+		Reads a received [Sequence Number, 4][message], keeping the message if it is newer than the latest one.
+		\return
+		false if the message is too short, a duplicate, or older than the latest message received.
+	*/
+	bool ReceiveMessage(const char* data, size_t length_of_data);
+
+	/*
+		\brief
+		Returns the latest message received if it hasn't been taken yet, otherwise an empty string.
+	*/
+	std::string TakeLatestMessage();
+};
+
+/*
+	A long message being put back together from its fragments.
+*/
+struct Partial_Message
+{
+	//Preallocated to fit every fragment, then shrunk to the real size once the last fragment is received.
+	std::string data{};
+	std::vector<bool> is_fragment_received{};
+	int fragments_received{ 0 };
+	//Only known once the last fragment is received.
+	size_t size{ 0 };
+};
+
+/*
+	Puts long messages back together from their fragments ([Message ID, 2][Fragment Index, 2][Fragment Count, 2][data]).
+	Fragments may arrive in any order, and fragments of different messages may be mixed.
+	Duplicates of a completed message aren't detected, so fragments should come from Reliable_Transfer (which drops duplicates).
+	What a peer can make it hold is bounded: MAX_FRAGMENT_COUNT per message, MAX_PARTIAL_MESSAGES messages,
+	and none more than MESSAGE_ID_WINDOW behind the newest message ID.
+*/
+struct Message_Reassembler
+{
+	//Messages that still have fragments missing, by message ID.
+	std::map<uint16_t, Partial_Message> partial_messages{};
+	//One after the newest message ID a fragment has been received for (IDs wrap around).
+	uint16_t next_message_id{ 0 };
+
+	/*
+		\brief
+		Copies the fragment into its message at (index * FRAGMENT_DATA_SIZE).
+		\param data
+		The fragment, starting from the fragment header.
+		\return
+		true if every fragment of the message has been received, in which case the message is moved into complete_message.
+		false if the message is still incomplete, or the fragment is invalid, a duplicate, or of a message too far behind the newest.
+	*/
+	bool ReceiveFragment(const char* data, size_t length_of_data, std::string& complete_message);
+};
+
+/*
+	A whole datagram waiting in a Packet_Ring, either read from the socket (before its integrity is checked and it is split into frames),
+	or waiting to be written to the socket.
+*/
+struct Queued_Datagram
+{
+	//Sender's address if received, destination's address if being sent.
+	sockaddr_storage addr{};
+	int length{};
+	char data[MAX_BUFFER_SIZE]{};
+};
+
+/*
+	Bounded lock-free queue of datagrams, from any number of producing threads to a single consuming (e.g. handling) thread.
+	Every slot is allocated up front, so pushing a datagram only copies it into a free slot (no heap allocation, no lock).
+	The handling thread takes datagrams in batches, reading them in place, and sleeps while the queue is empty.
+	Receiving threads only wake it (through the condition variable) if it is actually asleep.
+*/
+class Packet_Ring
+{
+public:
+	Packet_Ring();
+
+	/*
+		\brief
+		Copies the datagram into the next free slot. Can be called by multiple threads at the same time.
+		\param wake_consumer
+		false when pushing several datagrams in a row, so the consumer isn't woken for each one. Notify() should be called after the last.
+		\return
+		false if the ring is full (or the datagram is too long), in which case the datagram is dropped like a lost packet.
+	*/
+	bool Push(const sockaddr_storage& addr, const char* data, int length, bool wake_consumer = true);
+
+	/*
+		\brief
+		Points datagrams to the oldest datagrams in the ring, up to max_count, without removing them.
+		Only called by the handling thread, which should call PopBatch() once it is done with them.
+		\return
+		Number of datagrams, 0 if the ring is empty.
+	*/
+	size_t PeekBatch(Queued_Datagram** datagrams, size_t max_count);
+
+	/*
+		\brief
+		Frees the oldest count slots (from PeekBatch()) for the receiving threads to reuse.
+	*/
+	void PopBatch(size_t count);
+
+	/*
+		\brief
+		Sleeps until there is a datagram in the ring, or the timeout (in seconds) runs out.
+		\return
+		true if there is a datagram to handle.
+	*/
+	bool WaitForDatagrams(double timeout);
+
+	/*
+		\brief
+		Wakes the consuming thread from WaitForDatagrams() without pushing a datagram, e.g. when it has new work of another kind.
+		Can be called by any thread.
+	*/
+	void Notify();
+
+private:
+	struct Slot
+	{
+		/*
+			Position of the slot in the ring when it's free to be pushed to, and (position + 1) once it holds a datagram.
+			After being popped, it moves to (position + PACKET_RING_CAPACITY), its position in the next lap.
+		*/
+		std::atomic<size_t> sequence{};
+		Queued_Datagram datagram{};
+	};
+
+	bool IsDatagramReady() const;
+
+	std::unique_ptr<Slot[]> slots{};
+	//On separate cache lines, since they are written by different threads.
+	alignas(64) std::atomic<size_t> push_position{ 0 };
+	alignas(64) size_t pop_position{ 0 };
+	std::atomic<bool> is_handler_waiting{ false };
+	std::atomic<bool> is_notified{ false };
+	std::mutex wait_lock{};
+	std::condition_variable wait_condition{};
+};
+
+/*
+	A datagram assembled by the sending thread under the session lock, written to the socket after the lock is released.
+*/
+struct Outgoing_Datagram
+{
+	sockaddr_storage addrDest{};
+	std::string data{};
 };
 
+/*
+	Reads and writes a UDP socket from two dedicated threads, so reading and writing never wait on each other
+	(a UDP socket can have one thread reading while another writes).
+	- Receiving thread: sleeps until the socket is readable (epoll on Linux, poll elsewhere), then reads every datagram waiting into received, without any lock.
+	- Sending thread: the only thread that writes to the socket. Other threads queue their datagrams for it, without any lock.
+	On Linux, datagrams are read and written SOCKET_BATCH_SIZE at a time (recvmmsg/sendmmsg), so the syscall rate doesn't grow with the player count.
+*/
+class Datagram_IO
+{
+public:
+	//Datagrams read from the socket, waiting for the handling thread.
+	Packet_Ring received{};
+
+	Datagram_IO();
+	~Datagram_IO();
+	Datagram_IO(const Datagram_IO&) = delete;
+	Datagram_IO& operator=(const Datagram_IO&) = delete;
+
+	/*
+		\brief
+		Sets the socket to read and write, before the receiving and sending threads start.
+		On Linux, also registers it with epoll (falling back to poll if that fails).
+	*/
+	void Attach(SOCKET udp_socket);
+
+	/*
+		\brief
+		Sleeps up to timeout (in seconds) until the socket is readable, then reads every datagram waiting into received.
+		On Linux, each recvmmsg() reads up to SOCKET_BATCH_SIZE datagrams into a preallocated slab, and the handling thread is woken once per batch.
+		Datagrams too short to have a header are dropped. Only called by the receiving thread.
+		\return
+		Number of datagrams added to received.
+	*/
+	size_t ReceiveDatagrams(double timeout);
+
+	/*
+		\brief
+		Queues the datagram for the sending thread to write. Can be called by any thread.
+		\param wake_sender
+		false when queueing several datagrams in a row, with WakeSender() called after the last.
+		\return
+		false if the queue is full, in which case the datagram is dropped like a lost packet.
+	*/
+	bool QueueSend(const sockaddr_storage& addr_dest, const char* data, size_t length, bool wake_sender = true);
+
+	/*
+		\brief
+		Sleeps until a datagram is queued, WakeSender() is called, or the timeout (in seconds) runs out.
+		Only called by the sending thread, with the timeout up to its next retransmission or ACK deadline.
+	*/
+	bool WaitForQueuedSends(double timeout);
+
+	/*
+		\brief
+		Wakes the sending thread because there is something new to send (e.g. a message was added, or an ACK opened up the window).
+		Can be called by any thread.
+	*/
+	void WakeSender();
+
+	/*
+		\brief
+		Writes every queued datagram to the socket. Only called by the sending thread.
+		\return
+		Number of datagrams written.
+	*/
+	size_t FlushSends();
+
+	/*
+		\brief
+		Writes the datagram to the socket straight away. Only called by the sending thread.
+	*/
+	int Send(sockaddr_storage& addr_dest, char* data, size_t length);
+
+	/*
+		\brief
+		Writes every datagram to the socket straight away, in sendmmsg() calls of up to SOCKET_BATCH_SIZE on Linux.
+		Used for the datagrams of every session assembled in one pass of the sending thread. Only called by the sending thread.
+		\return
+		Number of datagrams written.
+	*/
+	size_t SendBatch(std::vector<Outgoing_Datagram>& datagrams);
+
+private:
+	//Message headers and receive buffers for recvmmsg()/sendmmsg(), defined in Utility.cpp.
+	struct Socket_Batch;
+
+	/*
+		\brief
+		Sleeps up to timeout (in seconds) until the socket is readable.
+	*/
+	bool WaitUntilReadable(double timeout);
+
+#ifdef __linux__
+	/*
+		\brief
+		Writes the first count datagrams set up in batch->send_headers, in as few sendmmsg() calls as possible.
+		\return
+		Number of datagrams written.
+	*/
+	size_t WriteBatch(size_t count);
+#endif
+
+	SOCKET udp_socket{ INVALID_SOCKET };
+	//epoll instance watching udp_socket, -1 if poll is used instead.
+	int epoll_fd{ -1 };
+	//Datagrams queued by other threads, waiting for the sending thread.
+	Packet_Ring to_send{};
+	//Allocated once in Attach(), so batching never allocates.
+	std::unique_ptr<Socket_Batch> batch{};
+};
+
+/*
+	Open addressing hash table from a player's address (IPv4 address and port, like Compare_SockAddr()) to a value, e.g. their player ID.
+	Linear probing over one flat array, so a lookup is usually a single cache line instead of a scan over every session.
+	Erasing shifts the entries after it back, so there are no tombstones and lookups stay short after players leave.
+	Not thread-safe, guard it with the lock of whatever it indexes.
+*/
+class Address_Index
+{
+public:
+	/*
+		\brief
+		Returns the value stored for the address, -1 if there is none.
+	*/
+	int Find(const sockaddr_storage& addr) const;
+
+	/*
+		\brief
+		Stores the value (0 or more) for the address, replacing any value already stored for it.
+	*/
+	void Insert(const sockaddr_storage& addr, int value);
+
+	/*
+		\brief
+		Removes the address, if it's stored.
+	*/
+	void Erase(const sockaddr_storage& addr);
+
+	size_t Size() const { return count; }
+
+private:
+	struct Entry
+	{
+		uint64_t key{};
+		//-1 if the entry is empty.
+		int value{ -1 };
+	};
+
+	static uint64_t MakeKey(const sockaddr_storage& addr);
+	//Slot the key starts probing from.
+	size_t HomeSlot(uint64_t key) const;
+	//Doubles the table (at least 16 slots), so it's never more than half full.
+	void Grow();
+
+	std::vector<Entry> entries{};
+	size_t count{ 0 };
+	//Number of bits of the hash used to pick the home slot, log2 of the table size.
+	int slot_bits{ 0 };
+};
+
+/*
+	Hierarchical timing wheel holding deadlines (e.g. retransmission and disconnection) for any number of sessions, by ID.
+	Level 0 has one slot per TIMER_WHEEL_TICK for the next 64 ticks, each level above has slots 64 times as long.
+	A timer sits in the finest level that can hold it, and moves down a level each time the wheel reaches its slot,
+	so advancing the wheel costs about the same however many timers are waiting, plus one step per timer that expires.
+	Deadlines past the range of the top level (about 4.6 hours) fire at the end of the range instead.
+
+	Timers can't be cancelled. An owner that moves a deadline schedules a new timer, and ignores the old one when it fires
+	(e.g. by keeping the deadline it's waiting for and comparing it with the timer's).
+	Not thread-safe, guard it with the lock of whatever it times.
+*/
+class Timer_Wheel
+{
+public:
+	struct Timer
+	{
+		Ticks deadline{};
+		int id{};
+	};
+
+	/*
+		\brief
+		Starts the wheel at start_time, the earliest time it can be advanced to.
+	*/
+	explicit Timer_Wheel(Ticks start_time);
+
+	/*
+		\brief
+		Adds a timer for id, firing at the first tick at or after deadline (or the next tick if the deadline has already passed).
+	*/
+	void Schedule(Ticks deadline, int id);
+
+	/*
+		\brief
+		Moves the wheel forward to current_time, appending every timer whose deadline has passed to expired.
+		Skips straight over ticks with nothing to do.
+	*/
+	void Advance(Ticks current_time, std::vector<Timer>& expired);
+
+	/*
+		\brief
+		Returns the earliest time Advance() has something to do (a timer to fire or to move down a level), TICKS_NEVER if there are no timers.
+		No timer fires before this time, so a thread can sleep until then.
+	*/
+	Ticks GetNextDeadline() const;
+
+	size_t Size() const { return count; }
+
+private:
+	static constexpr int LEVEL_COUNT = 4;
+	static constexpr int SLOT_BITS = 6;
+	static constexpr uint64_t SLOT_COUNT = uint64_t{ 1 } << SLOT_BITS;
+	static constexpr uint64_t SLOT_MASK = SLOT_COUNT - 1;
+
+	struct Entry
+	{
+		//Tick the timer fires on, its deadline rounded up (and clamped to the range of the wheel).
+		uint64_t tick{};
+		Timer timer{};
+	};
+
+	//Puts the entry in the finest level whose range reaches its tick.
+	void Place(const Entry& entry);
+	//Moves the timers in the current slot of the level (and the levels above, if their slots are also starting) down a level.
+	void Cascade(int level);
+	//Earliest tick after current_tick on which a slot with timers is reached, UINT64_MAX if there are no timers.
+	uint64_t NextEventTick() const;
+
+	std::vector<Entry> slots[LEVEL_COUNT][SLOT_COUNT]{};
+	//Reused when cascading, so moving timers down doesn't allocate.
+	std::vector<Entry> cascading{};
+	//Last tick the wheel was advanced to, every timer on it or before has fired.
+	uint64_t current_tick{};
+	size_t count{ 0 };
+};
+
+/*
+	Counts of how a Tick_Scheduler's ticks ran, since it started or its stats were last reset.
+*/
+struct Tick_Stats
+{
+	size_t tick_count{ 0 };
+	//Ticks whose work ran past the next tick's deadline.
+	size_t overrun_count{ 0 };
+	//Deadlines passed over entirely because of overruns.
+	size_t skipped_count{ 0 };
+	//Time from the start of each tick to the call for the next one.
+	Ticks total_work{ 0 };
+	Ticks max_work{ 0 };
+	//Longest time a sleeping loop woke up after its deadline.
+	Ticks max_lateness{ 0 };
+};
+
+/*
+	Paces a loop at a fixed rate, sleeping until each tick's deadline, and keeps statistics of how the ticks ran.
+	Deadlines are on a fixed grid (start + n * interval), so waking up late doesn't push back the ticks after.
+	When a tick overruns, the next one starts straight away, and deadlines that have already passed entirely are skipped
+	rather than run back to back.
+*/
+class Tick_Scheduler
+{
+public:
+	explicit Tick_Scheduler(int ticks_per_second);
+
+	/*
+		\brief
+		Ends the current tick (if any) and sleeps until the next one is due.
+		\return
+		Deadline of the tick that is starting.
+	*/
+	Ticks WaitForNextTick();
+
+	Ticks GetInterval() const { return interval; }
+	const Tick_Stats& GetStats() const { return stats; }
+	void ResetStats() { stats = Tick_Stats{}; }
+
+private:
+	Ticks interval{};
+	Ticks next_deadline{};
+	Ticks time_tick_started{};
+	bool is_tick_running{ false };
+	Tick_Stats stats{};
+};
+
+/*
+	Estimates the offset and drift of another machine's clock from this one, so its timestamps can be converted to this clock.
+	Each sample is an NTP-style ping: sent at t0 (this clock), received at t1 and answered at t2 (other clock), answer received at t3.
+	The offset is ((t1 - t0) + (t2 - t3)) / 2, off by at most half the round trip delay (t3 - t0) - (t2 - t1),
+	so the sample with the smallest delay of the last CLOCK_SYNC_WINDOW is used, and queueing delays are filtered out.
+	The drift is measured from how that offset changes over time, so the estimate stays good between samples.
+	Times are in seconds, on this side's monotonic clock (see GetTime()) and on whatever clock the other side reports.
+*/
+class Clock_Sync
+{
+public:
+	/*
+		\brief
+		Adds the sample of one ping. If the other clock has clearly jumped since the last samples, they are discarded.
+	*/
+	void AddSample(Ticks t0, double t1, double t2, Ticks t3);
+
+	/*
+		\brief
+		Converts a time on the other clock to this clock. Returned unchanged if no sample has been measured yet.
+	*/
+	double ToLocalTime(double remote_time) const;
+
+	/*
+		\brief
+		Returns the estimated offset of the other clock (other clock - this clock) at local_time.
+	*/
+	double GetOffset(double local_time) const;
+
+	double GetDrift() const { return drift; }
+	bool HasEstimate() const { return sample_count > 0; }
+	size_t SampleCount() const { return sample_count; }
+
+private:
+	struct Sample
+	{
+		//Midpoint of the ping on this clock.
+		double local_time{};
+		double offset{};
+		double delay{};
+	};
+
+	//Last CLOCK_SYNC_WINDOW samples, oldest overwritten first.
+	std::array<Sample, CLOCK_SYNC_WINDOW> samples{};
+	//Number of samples measured since the estimate was last reset.
+	size_t sample_count{ 0 };
+	//Sample with the smallest delay in the window, which the offset is extrapolated from.
+	Sample best{};
+	//Earlier best sample the drift is measured against, replaced once the drift is updated.
+	Sample drift_reference{};
+	bool has_drift_reference{ false };
+	//Seconds gained by the other clock per second of this clock.
+	double drift{ 0 };
+	//Set once the drift has been measured, until then it's assumed to be 0.
+	bool has_drift{ false };
+};
+
+/*
+	Fixed point formats of the float fields of the game messages, shared so the server and client write and read them the same way.
+	Each range is picked so its step is a power of 2 and 0 is exact (min = -step * 2^(bits - 1)), so e.g. a ship at rest stays at rest.
+	Changing any of them changes the message format, so the server and client must be built with the same ones.
+	Timestamps are still sent as whole floats, since they count up for as long as the program runs.
+*/
+//The 800x600 window (centred on the origin) and the margin objects wrap in, in steps of 1/64.
+constexpr Quantization POSITION_QUANTIZATION{ -512.0f, 511.984375f, 16 };
+//Up to past the bullet speed (400), in steps of 1/4.
+constexpr Quantization VELOCITY_QUANTIZATION{ -512.0f, 511.75f, 12 };
+//The ship's change in velocity over a frame, which the client sends as its acceleration, in steps of 1/128.
+constexpr Quantization ACCELERATION_QUANTIZATION{ -16.0f, 15.9921875f, 12 };
+//Whole units from 0 to 63, for asteroid sizes (10 to 60).
+constexpr Quantization SCALE_QUANTIZATION{ 0.0f, 63.0f, 6 };
+//Rotations, in steps of 1/1024 of a turn.
+constexpr int ANGLE_BITS = 10;
 
 enum CommandID
 {
 	CLIENT_PLAYER_TRANSFORM = 0x1,
 	CLIENT_BULLET_CREATION = 0x2,
-	CLIENT_COLLISION = 0x3,
+	CLIENT_COLLISION_RETIRED = 0x3, //Retired, as the server decides collisions. Neither sent nor read, kept so 0x3 isn't reused.
 	SERVER_PLAYER_TRANSFORM = 0x4,
 	SERVER_BULLET_CREATION = 0x5, //Not actually creating one, it's just a collection of newly created bullet data.
 	SERVER_ASTEROID_CREATION = 0x6,
@@ -74,25 +835,54 @@ enum GeneralCommandID
 {
 	COMMAND_COMPLETE = 0x0,
 	COMMAND_INCOMPLETE = 0x1,
+	COMMAND_SEQUENCED = 0x2, //Unreliable, only the latest is kept. Not ACK'd or resent.
 	JOIN_REQUEST = 0x20,
 	JOIN_RESPONSE = 0x21,
-	ACK = 0x30
+	ACK = 0x30,
+	//Clock synchronization ping from the server, [CLOCK_SYNC_REQUEST][Server Send Time, 8]. Not ACK'd or resent.
+	CLOCK_SYNC_REQUEST = 0x40,
+	//[CLOCK_SYNC_RESPONSE][Player ID, 2][Server Send Time, 8 (echoed)][Client Receive Time, 4][Client Send Time, 4], float seconds.
+	CLOCK_SYNC_RESPONSE = 0x41
 };
 
 
 /*
 	\brief
-	Checks and returns if packet checksum is valid, and the sequence number of the packet.
-	Returns -1 if checksum is invalid, sequence number if it is valid.
-
-	Do not pass in if data is < 6 bytes.
+	Checks if the datagram's integrity value is valid (with the mode in its header), then reads the header and splits the datagram into its frames.
+	Returns false if the integrity mode is unknown, the integrity value is invalid, the datagram is too short to have a header, or a frame runs past the end.
 
 	\param data
-	The entire data inclusive of checksum.
+	The entire data inclusive of header.
 	\param length_of_data
-	The length of the entire data inclusive of checksum
+	The length of the entire data inclusive of header.
+*/
+bool ReadDatagram(char* data, size_t length_of_data, Packet_Header& header, std::vector<Frame>& frames);
+
+/*
+	\brief
+	Encodes the message as a frame, in a datagram of its own with space reserved for the datagram header.
+	Format: [Integrity Mode, 1][Integrity Value, 4][ACK, 4][ACK Bits, 4][Length, 2][Sequence Number, 4][message]
+	\param sequence_number
+	-1 if the message doesn't need to be ACK'd (e.g. ACK, JOIN_RESPONSE).
+*/
+Encoded_Frame EncodeFrame(int sequence_number, const std::string& message);
+
+/*
+	\brief
+	Splits the message into fragments of up to FRAGMENT_DATA_SIZE, adding each to messages_to_send.
+	Format: [COMMAND_INCOMPLETE or COMMAND_COMPLETE (last fragment)][prefix][Message ID, 2][Fragment Index, 2][Fragment Count, 2][data]
+	\param prefix
+	Bytes after the GeneralCommandID of every fragment (e.g. player ID), up to 2 bytes.
+*/
+void FragmentMessage(const std::string& message, const std::string& prefix, uint16_t message_id, std::queue<std::string>& messages_to_send);
+
+/*
+	\brief
+	Picks the first mode in INTEGRITY_MODE_PREFERENCE that the other side supports.
+	\param supported_modes
+	Bit (1 << mode) is set for every mode supported, INTEGRITY_SUM16 is always supported.
 */
-int ReadChecksumAndNumber(char* data, size_t length_of_data_with_checksum);
+IntegrityMode ChooseIntegrityMode(uint8_t supported_modes);
 
 /*
 	\brief
@@ -102,7 +892,34 @@ std::array<unsigned char, 4> GetIPAddressBytes(std::string ip_addr);
 
 /*
 	\brief
-	Returns current time in double since epoch.
+	Returns the time of a monotonic clock in nanoseconds, counted from an arbitrary point (e.g. boot).
+	Unlike the system time, it never goes backwards (e.g. when the system time is corrected),
+	so only the difference between two readings means anything.
+*/
+Ticks GetMonotonicTime();
+
+/*
+	\brief
+	Reads the clock into the calling thread's cached time, and returns it.
+	Called once at the start of each pass of a hot loop, so everything done in the pass shares one reading.
+*/
+Ticks UpdateCachedTime();
+
+/*
+	\brief
+	Returns the calling thread's cached time from its last UpdateCachedTime(), reading the clock if it has never been updated.
+*/
+Ticks GetCachedTime();
+
+/*
+	\brief
+	Converts ticks to seconds, e.g. for waits and for timing game logic.
+*/
+double TicksToSeconds(Ticks ticks);
+
+/*
+	\brief
+	Returns the monotonic time in seconds. Networking code keeps its times in ticks instead.
 */
 double GetTime();
 